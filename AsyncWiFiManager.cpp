@@ -1,89 +1,450 @@
 #include "AsyncWiFiManager.h"
+#ifndef ASYNC_WIFI_DISABLE_CONFIG_PORTAL
 #include "html/HtmlResource.h"
+#endif
+#ifndef ASYNC_WIFI_DISABLE_HEALTH
+#include <lwip/tcp.h>
+#include <lwip/dns.h>
+#ifndef ESP8266
+#include <lwip/tcpip.h>
+#endif
+#endif
 
 #define FS LittleFS
 #define FORMAT_FS_IF_FAILED true
 
 #define CONNECT_WIFI_TIMEOUT 30000UL   // (ms)
 #define CONFIG_PORTAL_TIMEOUT 120000UL // (ms)
+#define FAST_CONNECT_TIMEOUT 5000UL    // (ms) Time to join the cached access point before a normal connection is used
+#define CONNECT_ATTEMPT_TIMEOUT 15000UL // (ms) Time to associate with the access point in one attempt
+#define DHCP_TIMEOUT 10000UL           // (ms) Time to get an IP address after association
+#define RECONNECT_MAX_DELAY 300000UL   // (ms)
+#define RECONNECT_JITTER_PERCENT 50
+#define SCAN_INTERVAL 30000UL          // (ms) Interval of background scans in config portal mode
+#define SCAN_REQUEST_QUIET_TIME 2000UL // (ms) Background scans wait until no request has been received for this time
+#define SCAN_DWELL_TIME 300            // (ms) Default of the core
+#define SCAN_SLICE_INTERVAL 200UL      // (ms) Pause between the channels of a scan while the AP is running, to serve its clients
+#define SCAN_ALL_CHANNELS 0x3FFE       // Channels 1 to 13
+#define HOT_APPLY_TIMEOUT 20000UL      // (ms) Time to connect with new settings before the config portal is used again
+#define HOT_APPLY_CLOSE_DELAY 5000UL   // (ms) Time the config portal stays up after new settings work, so the browser can show it
+#define NETWORK_RECENCY_BONUS 5        // (dB) Added to the signal of a saved network for each saved network used less recently
+#define ROAM_SAMPLE_INTERVAL 1000UL    // (ms) Interval of the signal samples used for roaming
+#define ROAM_RSSI_SMOOTHING 4          // A new signal sample has a weight of 1/ROAM_RSSI_SMOOTHING
+#define ROAM_RSSI_THRESHOLD -75        // (dBm)
+#define ROAM_HYSTERESIS 8              // (dB)
+#define ROAM_SCAN_INTERVAL 30000UL     // (ms)
+#define ROAM_MIN_INTERVAL 60000UL      // (ms)
+#define ROAM_SCAN_CHANNEL_TIME 100UL   // (ms) Scan time per channel on ESP32, short to limit the time away from the access point
+#define UPDATE_IDLE_TIMEOUT 10000UL    // (ms) A firmware upload that receives no data for this time is dropped
+#ifndef ASYNC_WIFI_DISABLE_HEALTH
+#define HEALTH_PROBE_INTERVAL 10000UL  // (ms)
+#define HEALTH_PROBE_TIMEOUT 2000UL    // (ms)
+#define HEALTH_GATEWAY_PORT 53         // DNS over TCP, served by most routers
+#define HEALTH_DEGRADED_FAILURES 2
+#define HEALTH_RECONNECT_FAILURES 5
+#define HEALTH_SMOOTHING 8             // A new probe has a weight of 1/HEALTH_SMOOTHING in the latency and loss
+
+#define HEALTH_PROBE_NONE 0
+#define HEALTH_PROBE_GATEWAY 1
+#define HEALTH_PROBE_ENDPOINT 2
+#define PROBE_PENDING 0
+#define PROBE_SUCCEEDED 1
+#define PROBE_FAILED 2
+#endif
+
+#define TASK_LOOP_INTERVAL 10 // (ms) The task also wakes up for each WiFi event
+
+#define NOTIFY_STATE_CHANGED 0
+#define NOTIFY_WIFI_INFORMATION_CHANGED 1
+#define NOTIFY_PARAMETERS_CHANGED 2
+
+#define SETTINGS_FILE "/wifi.dat"
+#define SETTINGS_TEMP_FILE "/wifi.tmp"
+#define SETTINGS_MAGIC 0x49464957UL // "WIFI"
+#define SETTINGS_VERSION 3
+#define LEGACY_SSID_FILE "/ssid.txt"
+#define LEGACY_PASSWORD_FILE "/pass.txt"
+#define RTC_CACHE_MAGIC 0x43545257UL // "WRTC"
+#define PARAMETERS_FILE "/params.dat"
+#define PARAMETERS_TEMP_FILE "/params.tmp"
+#define PARAMETERS_MAGIC 0x4D524150UL // "PARM"
+#define PARAMETERS_VERSION 1
+// Each parameter is stored as id length, id, type, value length and value
+#define PARAMETER_RECORD_MAX_SIZE (3 + PARAMETER_ID_MAX_LENGTH + UINT8_MAX)
+
+#ifdef ESP8266
+#define REASON_ASSOC_LEAVE WIFI_DISCONNECT_REASON_ASSOC_LEAVE
+#define REASON_4WAY_HANDSHAKE_TIMEOUT WIFI_DISCONNECT_REASON_4WAY_HANDSHAKE_TIMEOUT
+#define REASON_NO_AP_FOUND WIFI_DISCONNECT_REASON_NO_AP_FOUND
+#define REASON_AUTH_FAIL WIFI_DISCONNECT_REASON_AUTH_FAIL
+#define REASON_HANDSHAKE_TIMEOUT WIFI_DISCONNECT_REASON_HANDSHAKE_TIMEOUT
+#else
+#define REASON_ASSOC_LEAVE WIFI_REASON_ASSOC_LEAVE
+#define REASON_4WAY_HANDSHAKE_TIMEOUT WIFI_REASON_4WAY_HANDSHAKE_TIMEOUT
+#define REASON_NO_AP_FOUND WIFI_REASON_NO_AP_FOUND
+#define REASON_AUTH_FAIL WIFI_REASON_AUTH_FAIL
+#define REASON_HANDSHAKE_TIMEOUT WIFI_REASON_HANDSHAKE_TIMEOUT
+#endif
 
 #define AP_SSID_DEFAULT "ESP AP"
 #define AP_PASSWORD_DEFAULT "12345678"
+#define AP_CHANNEL_DEFAULT 1
 #define AP_IP_ADDR IPAddress(192, 168, 4, 1)
+#define AP_URL "http://192.168.4.1/"
+#define DNS_PORT 53
 
 unsigned long AsyncWiFiManager::mConnectWifiTimeout = CONNECT_WIFI_TIMEOUT;
-unsigned long AsyncWiFiManager::mConfigPortalTimeout = CONFIG_PORTAL_TIMEOUT;
-String AsyncWiFiManager::mSavedSSID = "";
-String AsyncWiFiManager::mSavedPassword = "";
-String AsyncWiFiManager::mAPSSID = "";
-String AsyncWiFiManager::mAPPassword = "";
+char AsyncWiFiManager::mSavedSSID[WIFI_SSID_MAX_LENGTH + 1] = "";
+char AsyncWiFiManager::mSavedPassword[WIFI_PASSWORD_MAX_LENGTH + 1] = "";
+AsyncWiFiManager::SavedNetwork AsyncWiFiManager::mNetworks[WIFI_NETWORK_STORE_SIZE];
+uint8_t AsyncWiFiManager::mNetworkCount = 0;
+AsyncWiFiManager::NetworkCandidate AsyncWiFiManager::mCandidates[WIFI_NETWORK_STORE_SIZE];
+uint8_t AsyncWiFiManager::mCandidateCount = 0;
+uint8_t AsyncWiFiManager::mCandidateIndex = 0;
+unsigned long AsyncWiFiManager::mSelectionTime = 0;
+AsyncWiFiManager::CustomParameter AsyncWiFiManager::mParameters[PARAMETER_MAX_COUNT];
+uint8_t AsyncWiFiManager::mParameterCount = 0;
 int AsyncWiFiManager::mState = ASYNC_WIFI_STATE_NONE;
+#ifndef ASYNC_WIFI_DISABLE_CONFIG_PORTAL
+unsigned long AsyncWiFiManager::mConfigPortalTimeout = CONFIG_PORTAL_TIMEOUT;
+char AsyncWiFiManager::mAPSSID[WIFI_SSID_MAX_LENGTH + 1] = "";
+char AsyncWiFiManager::mAPPassword[WIFI_PASSWORD_MAX_LENGTH + 1] = "";
+uint8_t AsyncWiFiManager::mAPChannel = AP_CHANNEL_DEFAULT;
 WebServerClass *AsyncWiFiManager::mServer = nullptr;
-bool AsyncWiFiManager::mStartedmDNS = false;
+#ifdef ASYNC_WIFI_USE_ASYNC_WEBSERVER
+AsyncWebServerRequest *AsyncWiFiManager::mRequest = nullptr;
+AsyncResponseStream *AsyncWiFiManager::mResponseStream = nullptr;
+#else
+const char *HTTP_HEADER_KEYS[] = {"If-None-Match"};
+#endif
+DNSServer *AsyncWiFiManager::mCaptiveDnsServer = nullptr;
 bool AsyncWiFiManager::mIsAutoConfigPortalEnable = false;
-String AsyncWiFiManager::mMDnsServerName = "";
+bool AsyncWiFiManager::mIsHotApplyEnable = false;
+uint8_t AsyncWiFiManager::mApplyStatus = ASYNC_WIFI_APPLY_IDLE;
+uint8_t AsyncWiFiManager::mApplyFailure = 0;
+unsigned long AsyncWiFiManager::mApplyTime = 0;
+unsigned long AsyncWiFiManager::mLastRequestTime = 0;
+std::atomic<bool> AsyncWiFiManager::mIsSavePending(false);
+char AsyncWiFiManager::mPendingSSID[WIFI_SSID_MAX_LENGTH + 1] = "";
+char AsyncWiFiManager::mPendingPassword[WIFI_PASSWORD_MAX_LENGTH + 1] = "";
+uint8_t *AsyncWiFiManager::mPendingParameters = nullptr;
+#ifdef ASYNC_WIFI_PORTAL_LOCK
+SemaphoreHandle_t AsyncWiFiManager::mPortalLock = nullptr;
+#endif
+#ifdef ASYNC_WIFI_ENABLE_OTA
+void (*AsyncWiFiManager::mOnUpdateProgress)(size_t written, size_t total) = nullptr;
+AsyncWiFiUpdateStats AsyncWiFiManager::mUpdateStats = {};
+size_t AsyncWiFiManager::mUpdateTotal = 0;
+unsigned long AsyncWiFiManager::mUpdateStartTime = 0;
+unsigned long AsyncWiFiManager::mUpdateChunkTime = 0;
+bool AsyncWiFiManager::mIsUpdateSha256 = false;
+char AsyncWiFiManager::mUpdateUser[UPDATE_CREDENTIAL_MAX_LENGTH + 1] = "";
+char AsyncWiFiManager::mUpdatePassword[UPDATE_CREDENTIAL_MAX_LENGTH + 1] = "";
+uint8_t AsyncWiFiManager::mUpdateSha256[32];
+#ifdef ESP8266
+br_sha256_context AsyncWiFiManager::mUpdateSha256Context;
+#else
+mbedtls_sha256_context AsyncWiFiManager::mUpdateSha256Context;
+#endif
+volatile bool AsyncWiFiManager::mIsRestartPending = false;
+#endif
+#endif
+#ifndef ASYNC_WIFI_DISABLE_SCAN
+bool AsyncWiFiManager::mIsScanning = false;
+bool AsyncWiFiManager::mIsScanSlicePending = false;
+AsyncWiFiScanOptions AsyncWiFiManager::mScanOptions = {0, false, SCAN_DWELL_TIME, ""};
+uint8_t AsyncWiFiManager::mScanChannel = 0;
+unsigned long AsyncWiFiManager::mScanSliceTime = 0;
+bool AsyncWiFiManager::mIsSelectingNetwork = false;
+bool AsyncWiFiManager::mIsRoamingEnable = false;
+bool AsyncWiFiManager::mIsRoamScan = false;
+bool AsyncWiFiManager::mIsRoaming = false;
+AsyncWiFiRoamingPolicy AsyncWiFiManager::mRoamingPolicy = {
+    ROAM_RSSI_THRESHOLD,
+    ROAM_HYSTERESIS,
+    ROAM_SCAN_INTERVAL,
+    ROAM_MIN_INTERVAL};
+AsyncWiFiRoamingStats AsyncWiFiManager::mRoamingStats = {};
+int16_t AsyncWiFiManager::mRoamRssi = 0;
+unsigned long AsyncWiFiManager::mRoamSampleTime = 0;
+unsigned long AsyncWiFiManager::mRoamScanTime = 0;
+unsigned long AsyncWiFiManager::mRoamTime = 0;
+uint16_t AsyncWiFiManager::mRoamChannels = 0;
+uint8_t AsyncWiFiManager::mRoamScanChannel = 0;
+AsyncWiFiManager::NetworkCandidate AsyncWiFiManager::mRoamTarget;
+AsyncWiFiScanResult AsyncWiFiManager::mScanResults[WIFI_SCAN_CACHE_SIZE];
+uint8_t AsyncWiFiManager::mScanResultCount = 0;
+unsigned long AsyncWiFiManager::mScanInterval = SCAN_INTERVAL;
+unsigned long AsyncWiFiManager::mLastScanTime = 0;
+#endif
+#ifndef ASYNC_WIFI_DISABLE_MDNS
+bool AsyncWiFiManager::mStartedmDNS = false;
+char AsyncWiFiManager::mMDnsServerName[MDNS_NAME_MAX_LENGTH + 1] = "";
+#endif
+#ifndef ASYNC_WIFI_DISABLE_PERSISTENCE
+uint32_t AsyncWiFiManager::mSavedSettingsCrc = 0;
+uint32_t AsyncWiFiManager::mSavedParametersCrc = 0;
+bool AsyncWiFiManager::mIsSettingsLoaded = false;
+#ifndef ESP8266
+RTC_DATA_ATTR AsyncWiFiManager::RtcCache AsyncWiFiManager::mRtcCache;
+#endif
+#endif
+uint8_t AsyncWiFiManager::mSavedBSSID[6] = {0};
+uint8_t AsyncWiFiManager::mSavedChannel = 0;
+bool AsyncWiFiManager::mIsFastConnect = false;
+unsigned long AsyncWiFiManager::mConnectStartTime = 0;
+AsyncWiFiConnectStats AsyncWiFiManager::mConnectStats = {};
+unsigned long AsyncWiFiManager::mStateTime = 0;
+AsyncWiFiReconnectPolicy AsyncWiFiManager::mReconnectPolicy = {
+    {30000UL, 5000UL, 2000UL, 2000UL, 1000UL}, // Wrong password, AP not found, association, DHCP, connection lost
+    RECONNECT_MAX_DELAY,
+    RECONNECT_JITTER_PERCENT,
+    CONNECT_ATTEMPT_TIMEOUT,
+    DHCP_TIMEOUT};
+uint8_t AsyncWiFiManager::mFailureCount[ASYNC_WIFI_FAILURE_COUNT] = {0};
+#ifndef ASYNC_WIFI_DISABLE_HEALTH
+bool AsyncWiFiManager::mIsHealthMonitorEnable = false;
+AsyncWiFiHealthPolicy AsyncWiFiManager::mHealthPolicy = {
+    HEALTH_PROBE_INTERVAL,
+    HEALTH_PROBE_TIMEOUT,
+    HEALTH_GATEWAY_PORT,
+    HEALTH_DEGRADED_FAILURES,
+    HEALTH_RECONNECT_FAILURES};
+AsyncWiFiHealthStats AsyncWiFiManager::mHealthStats = {};
+char AsyncWiFiManager::mHealthHost[HEALTH_HOST_MAX_LENGTH + 1] = "";
+char AsyncWiFiManager::mHealthPath[HEALTH_PATH_MAX_LENGTH + 1] = "/";
+uint16_t AsyncWiFiManager::mHealthPort = 80;
+unsigned long AsyncWiFiManager::mHealthProbeTime = 0;
+uint32_t AsyncWiFiManager::mHealthLatency = 0;
+uint16_t AsyncWiFiManager::mHealthLoss = 0;
+unsigned long AsyncWiFiManager::mProbeStartTime = 0;
+uint32_t AsyncWiFiManager::mProbeGateway = 0;
+std::atomic<uint8_t> AsyncWiFiManager::mHealthProbe(HEALTH_PROBE_NONE);
+std::atomic<uint16_t> AsyncWiFiManager::mProbeSequence(0);
+std::atomic<uint32_t> AsyncWiFiManager::mProbeResult(0);
+std::atomic<unsigned long> AsyncWiFiManager::mProbeEndTime(0);
+#endif
+bool AsyncWiFiManager::mIsAttemptActive = false;
+bool AsyncWiFiManager::mIsAssociated = false;
+bool AsyncWiFiManager::mIsReconnectScheduled = false;
+unsigned long AsyncWiFiManager::mAttemptTime = 0;
+unsigned long AsyncWiFiManager::mAssociatedTime = 0;
+unsigned long AsyncWiFiManager::mReconnectTime = 0;
+AsyncWiFiReconnectAttempt AsyncWiFiManager::mReconnectHistory[RECONNECT_HISTORY_SIZE];
+uint8_t AsyncWiFiManager::mReconnectHistoryHead = 0;
+uint8_t AsyncWiFiManager::mReconnectHistoryCount = 0;
+unsigned long AsyncWiFiManager::mStateTimeout = 0;
+AsyncWiFiManager::QueuedEvent AsyncWiFiManager::mEventQueue[EVENT_QUEUE_SIZE];
+std::atomic<uint8_t> AsyncWiFiManager::mEventHead(0);
+std::atomic<uint8_t> AsyncWiFiManager::mEventTail(0);
+std::atomic<uint16_t> AsyncWiFiManager::mOverflowEvent(0);
+std::atomic<bool> AsyncWiFiManager::mIsOverflowScanDone(false);
+std::atomic<uint32_t> AsyncWiFiManager::mEventDropCount(0);
+uint32_t AsyncWiFiManager::mEventReportedDropCount = 0;
+AsyncWiFiSnapshot AsyncWiFiManager::mSnapshot = {};
+std::atomic<uint32_t> AsyncWiFiManager::mSnapshotSequence(0);
+#ifdef ASYNC_WIFI_ENABLE_TASK
+TaskHandle_t AsyncWiFiManager::mTaskHandle = nullptr;
+AsyncWiFiManager::Notification AsyncWiFiManager::mNotificationQueue[NOTIFICATION_QUEUE_SIZE];
+std::atomic<uint8_t> AsyncWiFiManager::mNotificationHead(0);
+std::atomic<uint8_t> AsyncWiFiManager::mNotificationTail(0);
+uint32_t AsyncWiFiManager::mNotificationDropCount = 0;
+#endif
+#ifdef ESP8266
+WiFiEventHandler AsyncWiFiManager::mConnectedHandler;
+WiFiEventHandler AsyncWiFiManager::mGotIPHandler;
+WiFiEventHandler AsyncWiFiManager::mDisconnectedHandler;
+#endif
 void (*AsyncWiFiManager::onStateChanged)(AsyncWiFiState state) = nullptr;
 void (*AsyncWiFiManager::mOnWiFiInformationChanged)() = nullptr;
+void (*AsyncWiFiManager::mOnParametersChanged)() = nullptr;
+
+// State changes driven by WiFi events, events without an entry are ignored in that state
+const AsyncWiFiManager::StateTransition AsyncWiFiManager::TRANSITIONS[] = {
+    {ASYNC_WIFI_STATE_CONNECTING, ASYNC_WIFI_EVENT_GOT_IP, ASYNC_WIFI_STATE_CONNECTED},
+    {ASYNC_WIFI_STATE_CONNECTED, ASYNC_WIFI_EVENT_DISCONNECTED, ASYNC_WIFI_STATE_CONNECTING},
+    {ASYNC_WIFI_STATE_CONNECTED, ASYNC_WIFI_EVENT_LOST_IP, ASYNC_WIFI_STATE_CONNECTING},
+    {ASYNC_WIFI_STATE_DEGRADED, ASYNC_WIFI_EVENT_DISCONNECTED, ASYNC_WIFI_STATE_CONNECTING},
+    {ASYNC_WIFI_STATE_DEGRADED, ASYNC_WIFI_EVENT_LOST_IP, ASYNC_WIFI_STATE_CONNECTING},
+};
 
-const char HTML_WIFI_ITEM1[] PROGMEM = "<div><a href='#p' onclick='c(this)'>";
-const char HTML_WIFI_ITEM2[] PROGMEM = "</a><div class='q q-";
-const char HTML_WIFI_LOCK[] PROGMEM = " l";
-const char HTML_WIFI_ITEM3[] PROGMEM = "'></div></div>";
-const char HTML_WIFI_LIST[] PROGMEM = "<!-- HTML_WIFI_LIST -->";
+#ifndef ASYNC_WIFI_DISABLE_CONFIG_PORTAL
+#define SEND_BUFFER_SIZE 256 // (bytes) Buffer used to group small HTML fragments into one chunk
+
+const char HTML_WIFI_ITEM[] PROGMEM = "<div><a href='#p' onclick='c(this)'%s>";
+const char HTML_WIFI_ITEM_END[] PROGMEM = "</a><div class='q q-%d%s'></div></div>\n";
+const char JSON_WIFI_ITEM[] PROGMEM = "%s{\"s\":\"";
+const char JSON_WIFI_ITEM_END[] PROGMEM = "\",\"r\":%d,\"q\":%d,\"l\":%d,\"c\":%d,\"k\":%d}";
+const char JSON_APPLY_STATUS[] PROGMEM = "{\"s\":\"%s\",\"n\":\"";
+const char JSON_APPLY_STATUS_END[] PROGMEM = "\",\"i\":\"%s\",\"e\":\"%s\",\"m\":\"%s\"}";
 const char HTML_NO_NETWORKS_FOUND[] PROGMEM = "<label>No networks found</label><br>";
+const char HTML_PARAMETER_STRING[] PROGMEM = "<label for='%s'>%s</label><input id='%s' name='%s' maxlength='%u' value='";
+const char HTML_PARAMETER_STRING_END[] PROGMEM = "'><br>";
+const char HTML_PARAMETER_INT[] PROGMEM = "<label for='%s'>%s</label><input id='%s' name='%s' type='number' min='%ld' max='%ld' value='%ld'><br>";
+const char HTML_PARAMETER_BOOL[] PROGMEM = "<input id='%s' name='%s' type='checkbox' value='1'%s><label for='%s'>%s</label><br>";
+
+// Connectivity check URLs of Android, Apple, Windows and Firefox. Redirecting them opens the config page on the client
+const char *const CAPTIVE_PORTAL_URLS[] = {"/generate_204", "/gen_204", "/hotspot-detect.html", "/library/test/success.html",
+                                           "/connecttest.txt", "/ncsi.txt", "/redirect", "/fwlink", "/success.txt", "/canonical.html"};
+
+// Static resources are revalidated on every use, an unchanged resource costs only a 304 response
+const char HTTP_CACHE_CONTROL[] PROGMEM = "no-cache";
+#endif
 
-#define DEBUG_ENABLE_LOG
 // #define DEBUG_HTTP_ARGUMENTS
 
-#ifdef DEBUG_ENABLE_LOG
 #define TAG "WIFI"
-#define LOG(...)                       \
-    {                                  \
-        Serial.print(F("[" TAG "] ")); \
-        Serial.printf(__VA_ARGS__);    \
-        Serial.println();              \
-    }
-#define LOGE(...)               \
-    {                           \
-        Serial.print(F("[E]")); \
-        LOG(__VA_ARGS__);       \
-    }
+
+// Messages are formatted into a buffer and written to the sink from loop(), logging never waits for the serial port
+#if ASYNC_WIFI_LOG_LEVEL >= ASYNC_WIFI_LOG_LEVEL_ERROR
+#define LOGE(format, ...) logMessage(ASYNC_WIFI_LOG_LEVEL_ERROR, PSTR(format), ##__VA_ARGS__)
 #else
-#define LOG(...)
 #define LOGE(...)
 #endif
+#if ASYNC_WIFI_LOG_LEVEL >= ASYNC_WIFI_LOG_LEVEL_INFO
+#define LOG(format, ...) logMessage(ASYNC_WIFI_LOG_LEVEL_INFO, PSTR(format), ##__VA_ARGS__)
+#else
+#define LOG(...)
+#endif
+#if ASYNC_WIFI_LOG_LEVEL >= ASYNC_WIFI_LOG_LEVEL_DEBUG
+#define LOGD(format, ...) logMessage(ASYNC_WIFI_LOG_LEVEL_DEBUG, PSTR(format), ##__VA_ARGS__)
+#else
+#define LOGD(...)
+#endif
 
-bool AsyncWiFiManager::mIsScanning = false;
+#if ASYNC_WIFI_LOG_LEVEL > ASYNC_WIFI_LOG_LEVEL_NONE
+AsyncWiFiManager::LogEntry AsyncWiFiManager::mLogQueue[LOG_QUEUE_SIZE];
+std::atomic<uint8_t> AsyncWiFiManager::mLogHead(0);
+std::atomic<uint8_t> AsyncWiFiManager::mLogTail(0);
+std::atomic<uint32_t> AsyncWiFiManager::mLogDroppedCount(0);
+uint32_t AsyncWiFiManager::mLogReportedDroppedCount = 0;
+void (*AsyncWiFiManager::mLogSink)(uint8_t level, const char *message) = AsyncWiFiManager::serialLogSink;
+#endif
+
+#ifdef ASYNC_WIFI_ENABLE_METRICS
+#define METRICS(...) __VA_ARGS__
+#define METRICS_REQUEST_BEGIN() unsigned long requestStartTime = millis()
+#define METRICS_REQUEST_END(handler) recordRequest(mMetrics.handler, millis() - requestStartTime)
+
+// Upper bounds (ms) of the request latency histogram, the last bucket counts everything slower
+const unsigned long METRICS_LATENCY_BOUNDS[METRICS_LATENCY_BUCKET_COUNT - 1] = {5, 10, 25, 50, 100, 250, 500, 1000};
+
+AsyncWiFiMetrics AsyncWiFiManager::mMetrics = {};
+#else
+#define METRICS(...)
+#define METRICS_REQUEST_BEGIN()
+#define METRICS_REQUEST_END(handler)
+#endif
+
+// The work of loop() and the handlers of the async server exclude each other, so the handlers see the same state
+// as with the server of the core. On ESP8266 they already run between two calls of loop()
+#ifdef ASYNC_WIFI_PORTAL_LOCK
+#define PORTAL_LOCK() xSemaphoreTake(mPortalLock, portMAX_DELAY)
+#define PORTAL_UNLOCK() xSemaphoreGive(mPortalLock)
+#else
+#define PORTAL_LOCK()
+#define PORTAL_UNLOCK()
+#endif
 
 void AsyncWiFiManager::begin()
 {
-    initFS();
+#ifdef ASYNC_WIFI_PORTAL_LOCK
+    if (!mPortalLock)
+    {
+        mPortalLock = xSemaphoreCreateMutex();
+    }
+#endif
+    PORTAL_LOCK();
+#ifndef ASYNC_WIFI_DISABLE_PERSISTENCE
+    if (mParameterCount > 0)
+    {
+        loadParameters();
+    }
+#endif
+    registerWiFiEvents();
     setState(ASYNC_WIFI_STATE_NONE);
     readSavedSettings();
     if (!isValidWifiSettings())
     {
+#ifndef ASYNC_WIFI_DISABLE_CONFIG_PORTAL
         LOG("No saved WiFi");
         startConfigPortal();
+#else
+        LOGE("No saved WiFi");
+#endif
     }
     else
     {
         startConnectToSavedWifi();
     }
+    PORTAL_UNLOCK();
 }
 
 void AsyncWiFiManager::loop()
 {
+#ifdef ASYNC_WIFI_ENABLE_TASK
+    if (mTaskHandle)
+    {
+        processNotifications();
+        return;
+    }
+#endif
+    runLoop();
+}
+
+#ifdef ASYNC_WIFI_ENABLE_TASK
+bool AsyncWiFiManager::startTask(UBaseType_t priority, uint32_t stackSize, BaseType_t core)
+{
+    if (mTaskHandle)
+    {
+        return true;
+    }
+    if (xTaskCreatePinnedToCore(taskHandler, "AsyncWiFi", stackSize, nullptr, priority, &mTaskHandle, core) != pdPASS)
+    {
+        mTaskHandle = nullptr;
+        LOGE("Can't start the task");
+        return false;
+    }
+    return true;
+}
+
+void AsyncWiFiManager::taskHandler(void *arg)
+{
+    for (;;)
+    {
+        runLoop();
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(TASK_LOOP_INTERVAL));
+    }
+}
+#endif
+
+void AsyncWiFiManager::runLoop()
+{
+    PORTAL_LOCK();
+#if ASYNC_WIFI_LOG_LEVEL > ASYNC_WIFI_LOG_LEVEL_NONE
+    flushLog();
+#endif
+#ifndef ASYNC_WIFI_DISABLE_CONFIG_PORTAL
+    if (mCaptiveDnsServer)
+    {
+        mCaptiveDnsServer->processNextRequest();
+    }
+#ifndef ASYNC_WIFI_USE_ASYNC_WEBSERVER
     if (mServer)
     {
         mServer->handleClient();
     }
-#ifdef ESP8266
+#endif
+#endif
+#if defined(ESP8266) && !defined(ASYNC_WIFI_DISABLE_MDNS)
     if (mStartedmDNS)
     {
         MDNS.update();
     }
 #endif
+    processEvents();
     processHandler();
+    PORTAL_UNLOCK();
 }
 
 void AsyncWiFiManager::resetSettings()
@@ -97,25 +458,126 @@ void AsyncWiFiManager::turnOff()
 {
     LOG("Stop all");
     stopConnectToSavedWifi();
+#ifndef ASYNC_WIFI_DISABLE_CONFIG_PORTAL
     stopConfigPortal();
     stopServer();
+#endif
+#ifndef ASYNC_WIFI_DISABLE_MDNS
     stopMDNS();
+#endif
     setState(ASYNC_WIFI_STATE_NONE);
     WiFi.mode(WIFI_OFF);
 }
 
 // This function should not be used unless debugging. The device needs to restart after using it.
-void AsyncWiFiManager::setWifiInformation(String ssid, String password)
+// Replaces all saved networks, an empty SSID removes them
+void AsyncWiFiManager::setWifiInformation(const char *ssid, const char *password)
 {
-    mSavedSSID = ssid;
-    mSavedPassword = password;
+#ifndef ASYNC_WIFI_DISABLE_PERSISTENCE
+    loadSettings();
+#endif
+    mNetworkCount = 0;
+    strlcpy(mSavedSSID, ssid, sizeof(mSavedSSID));
+    strlcpy(mSavedPassword, password, sizeof(mSavedPassword));
+    mSavedChannel = 0;
     saveSettings();
 }
 
-void AsyncWiFiManager::setAPInformation(String ssid, String password)
+void AsyncWiFiManager::setWifiInformation(const String &ssid, const String &password)
+{
+    setWifiInformation(ssid.c_str(), password.c_str());
+}
+
+// The network is kept until the store is full and it is the least recently used one.
+// Adding a network that is already saved with the same password does nothing, so it can be called at every boot
+void AsyncWiFiManager::addWifiInformation(const char *ssid, const char *password)
+{
+#ifndef ASYNC_WIFI_DISABLE_PERSISTENCE
+    loadSettings();
+#endif
+    int index = findNetwork(ssid);
+    if (ssid[0] == '\0' || (index >= 0 && strncmp(mNetworks[index].password, password, WIFI_PASSWORD_MAX_LENGTH) == 0))
+    {
+        return;
+    }
+    storeNetwork(ssid, password, nullptr, 0);
+#ifndef ASYNC_WIFI_DISABLE_PERSISTENCE
+    if (!writeSettingsFile())
+    {
+        LOGE("Failed to save settings");
+        return;
+    }
+#endif
+    LOG("Saved WiFi: %s", ssid);
+}
+
+void AsyncWiFiManager::addWifiInformation(const String &ssid, const String &password)
+{
+    addWifiInformation(ssid.c_str(), password.c_str());
+}
+
+uint8_t AsyncWiFiManager::getSavedNetworkCount()
+{
+#ifndef ASYNC_WIFI_DISABLE_PERSISTENCE
+    loadSettings();
+#endif
+    return mNetworkCount;
+}
+
+// value is a buffer of maxLength + 1 characters
+bool AsyncWiFiManager::addParameter(const char *id, const char *label, char *value, uint8_t maxLength)
+{
+    if (!addParameter(id, label, ASYNC_WIFI_PARAMETER_STRING, value))
+    {
+        return false;
+    }
+    mParameters[mParameterCount - 1].maxLength = maxLength;
+    return true;
+}
+
+bool AsyncWiFiManager::addParameter(const char *id, const char *label, int32_t *value, int32_t min, int32_t max)
+{
+    if (!addParameter(id, label, ASYNC_WIFI_PARAMETER_INT, value))
+    {
+        return false;
+    }
+    mParameters[mParameterCount - 1].min = min;
+    mParameters[mParameterCount - 1].max = max;
+    return true;
+}
+
+bool AsyncWiFiManager::addParameter(const char *id, const char *label, bool *value)
+{
+    return addParameter(id, label, ASYNC_WIFI_PARAMETER_BOOL, value);
+}
+
+bool AsyncWiFiManager::addParameter(const char *id, const char *label, uint8_t type, void *value)
+{
+    if (mParameterCount >= PARAMETER_MAX_COUNT || strlen(id) > PARAMETER_ID_MAX_LENGTH)
+    {
+        LOGE("Cannot add parameter %s", id);
+        return false;
+    }
+    CustomParameter &parameter = mParameters[mParameterCount++];
+    memset(&parameter, 0, sizeof(parameter));
+    parameter.id = id;
+    parameter.label = label;
+    parameter.type = type;
+    parameter.value = value;
+    return true;
+}
+
+#ifndef ASYNC_WIFI_DISABLE_CONFIG_PORTAL
+// Longer names are truncated to 32 bytes for the SSID and 64 bytes for the password
+void AsyncWiFiManager::setAPInformation(const char *ssid, const char *password)
+{
+    strlcpy(mAPSSID, ssid, sizeof(mAPSSID));
+    strlcpy(mAPPassword, password, sizeof(mAPPassword));
+}
+
+void AsyncWiFiManager::setAPInformation(const String &ssid, const String &password)
 {
-    mAPSSID = ssid;
-    mAPPassword = password;
+    setAPInformation(ssid.c_str(), password.c_str());
 }
 
 // Automatically switch to config portal mode when unable to connect to saved WiFi (default: false)
@@ -124,10 +586,25 @@ void AsyncWiFiManager::setAutoConfigPortalEnable(bool enabled)
     mIsAutoConfigPortalEnable = enabled;
 }
 
-void AsyncWiFiManager::setMDnsServerName(String serverName)
+// Try new settings saved in the config portal without restarting, the portal is kept up until they work (default: false).
+// Not used when a callback is set with setOnWiFiInformationChanged()
+void AsyncWiFiManager::setHotApplyEnable(bool enabled)
+{
+    mIsHotApplyEnable = enabled;
+}
+#endif
+
+#ifndef ASYNC_WIFI_DISABLE_MDNS
+void AsyncWiFiManager::setMDnsServerName(const char *serverName)
+{
+    strlcpy(mMDnsServerName, serverName, sizeof(mMDnsServerName));
+}
+
+void AsyncWiFiManager::setMDnsServerName(const String &serverName)
 {
-    mMDnsServerName = serverName;
+    setMDnsServerName(serverName.c_str());
 }
+#endif
 
 void AsyncWiFiManager::setConnectWifiTimeout(unsigned int timeout)
 {
@@ -137,6 +614,7 @@ void AsyncWiFiManager::setConnectWifiTimeout(unsigned int timeout)
     }
 }
 
+#ifndef ASYNC_WIFI_DISABLE_CONFIG_PORTAL
 void AsyncWiFiManager::setConfigPortalTimeout(unsigned int timeout)
 {
     if (timeout > 0)
@@ -144,541 +622,3542 @@ void AsyncWiFiManager::setConfigPortalTimeout(unsigned int timeout)
         mConfigPortalTimeout = timeout;
     }
 }
+#endif
 
-void AsyncWiFiManager::setOnStateChanged(void (*callback)(AsyncWiFiState state))
+#if !defined(ASYNC_WIFI_DISABLE_CONFIG_PORTAL) && !defined(ASYNC_WIFI_DISABLE_SCAN)
+// Interval of background scans while the config portal is running, 0 to scan only once
+void AsyncWiFiManager::setScanInterval(unsigned long interval)
 {
-    onStateChanged = callback;
+    mScanInterval = interval;
 }
+#endif
 
-void AsyncWiFiManager::setOnWiFiInformationChanged(void (*callback)())
+void AsyncWiFiManager::setReconnectPolicy(const AsyncWiFiReconnectPolicy &policy)
 {
-    mOnWiFiInformationChanged = callback;
+    mReconnectPolicy = policy;
 }
 
-int AsyncWiFiManager::getState()
+#ifndef ASYNC_WIFI_DISABLE_HEALTH
+// Probe the connection while connected and report ASYNC_WIFI_STATE_DEGRADED when it fails (default: false)
+void AsyncWiFiManager::setHealthMonitorEnable(bool enabled)
 {
-    return mState;
+    mIsHealthMonitorEnable = enabled;
 }
 
-String AsyncWiFiManager::getStateStr()
+void AsyncWiFiManager::setHealthPolicy(const AsyncWiFiHealthPolicy &policy)
 {
-    switch (mState)
-    {
-    case ASYNC_WIFI_STATE_NONE:
-        return "NONE";
-    case ASYNC_WIFI_STATE_CONNECTING:
-        return "CONNECTING";
-    case ASYNC_WIFI_STATE_CONFIG_PORTAL:
-        return "CONFIG_PORTAL";
-    case ASYNC_WIFI_STATE_CONNECTED:
-        return "CONNECTED";
-    case ASYNC_WIFI_STATE_DISCONNECTED:
-        return "DISCONNECTED";
-    default:
-        return "UNKNOWN";
-    }
+    mHealthPolicy = policy;
 }
 
-void AsyncWiFiManager::setState(int state)
+void AsyncWiFiManager::setHealthEndpoint(const char *host, uint16_t port, const char *path)
 {
-    if (mState != state)
-    {
-        mState = state;
-        LOG("State changed to %s", getStateStr().c_str());
-        if (onStateChanged)
-        {
-            onStateChanged((AsyncWiFiState)state);
-        }
-    }
+    strlcpy(mHealthHost, host, sizeof(mHealthHost));
+    strlcpy(mHealthPath, path, sizeof(mHealthPath));
+    mHealthPort = port;
 }
+#endif
 
-void AsyncWiFiManager::startScanNetworks()
+#ifndef ASYNC_WIFI_DISABLE_SCAN
+// Used by the next scan
+void AsyncWiFiManager::setScanOptions(const AsyncWiFiScanOptions &options)
 {
-    if (!mIsScanning)
-    {
-        LOG("Start scan networks");
-        mIsScanning = true;
-        if (WiFi.status() == WL_CONNECTED)
-        {
-            LOG("Disconnecting networks");
-            WiFi.disconnect();
-        }
-        if (WiFi.getMode() == WIFI_AP)
-        {
-            WiFi.mode(WIFI_AP_STA);
-        }
-        else
-        {
-            WiFi.mode(WIFI_STA);
-        }
-        WiFi.scanNetworks(true);
-    }
+    mScanOptions = options;
 }
 
-void AsyncWiFiManager::stopScanNetworks()
+// Join a stronger access point of the same network when the signal is low (default: false)
+void AsyncWiFiManager::setRoamingEnable(bool enabled)
 {
-    if (mIsScanning)
-    {
-        LOG("Stop scan networks");
-        WiFi.scanDelete();
-        mIsScanning = false;
-    }
+    mIsRoamingEnable = enabled;
+}
+
+void AsyncWiFiManager::setRoamingPolicy(const AsyncWiFiRoamingPolicy &policy)
+{
+    mRoamingPolicy = policy;
+}
+#endif
+
+#ifdef ASYNC_WIFI_ENABLE_METRICS
+// The time of the current state is included up to now
+AsyncWiFiMetrics AsyncWiFiManager::getMetrics()
+{
+    AsyncWiFiMetrics metrics = mMetrics;
+    metrics.stateTime[mState] += millis() - mStateTime;
+    return metrics;
 }
 
-String AsyncWiFiManager::getEncryptionTypeStr(uint8_t encType)
+// Free heap and largest free block, tracked as low watermarks
+void AsyncWiFiManager::sampleHeap()
 {
+    uint32_t freeHeap = ESP.getFreeHeap();
 #ifdef ESP8266
-    switch (encType)
+    uint32_t maxFreeBlock = ESP.getMaxFreeBlockSize();
+#else
+    uint32_t maxFreeBlock = ESP.getMaxAllocHeap();
+#endif
+    if (mMetrics.minFreeHeap == 0 || freeHeap < mMetrics.minFreeHeap)
     {
-    case AUTH_OPEN:
-        return "open";
-    case AUTH_WEP:
-        return "WEP";
-    case AUTH_WPA_PSK:
-        return "WPA";
-    case AUTH_WPA2_PSK:
-        return "WPA2";
-    case AUTH_WPA_WPA2_PSK:
-        return "WPA+WPA2";
-    default:
-        return "unknown";
+        mMetrics.minFreeHeap = freeHeap;
     }
-#else
-    switch (encType)
+    if (mMetrics.minMaxFreeBlock == 0 || maxFreeBlock < mMetrics.minMaxFreeBlock)
     {
-    case WIFI_AUTH_OPEN:
-        return "open";
-    case WIFI_AUTH_WEP:
-        return "WEP";
-    case WIFI_AUTH_WPA_PSK:
-        return "WPA";
-    case WIFI_AUTH_WPA2_PSK:
-        return "WPA2";
-    case WIFI_AUTH_WPA_WPA2_PSK:
-        return "WPA+WPA2";
-    case WIFI_AUTH_WPA2_ENTERPRISE:
-        return "WPA2-EAP";
-    case WIFI_AUTH_WPA3_PSK:
-        return "WPA3";
-    case WIFI_AUTH_WPA2_WPA3_PSK:
-        return "WPA2+WPA3";
-    case WIFI_AUTH_WAPI_PSK:
-        return "WAPI";
-    default:
-        return "unknown";
+        mMetrics.minMaxFreeBlock = maxFreeBlock;
     }
-#endif
 }
+#endif
+
+const AsyncWiFiReconnectPolicy &AsyncWiFiManager::getReconnectPolicy()
+{
+    return mReconnectPolicy;
+}
+
+#ifndef ASYNC_WIFI_DISABLE_HEALTH
+const AsyncWiFiHealthPolicy &AsyncWiFiManager::getHealthPolicy()
+{
+    return mHealthPolicy;
+}
+
+const AsyncWiFiHealthStats &AsyncWiFiManager::getHealthStats()
+{
+    return mHealthStats;
+}
+#endif
+
+#ifndef ASYNC_WIFI_DISABLE_SCAN
+const AsyncWiFiScanOptions &AsyncWiFiManager::getScanOptions()
+{
+    return mScanOptions;
+}
+
+const AsyncWiFiRoamingPolicy &AsyncWiFiManager::getRoamingPolicy()
+{
+    return mRoamingPolicy;
+}
+
+const AsyncWiFiRoamingStats &AsyncWiFiManager::getRoamingStats()
+{
+    return mRoamingStats;
+}
+#endif
+
+// Copy the most recent failed attempts to attempts, oldest first. Return the number of attempts copied
+uint8_t AsyncWiFiManager::getReconnectHistory(AsyncWiFiReconnectAttempt *attempts, uint8_t size)
+{
+    uint8_t count = min(size, mReconnectHistoryCount);
+    for (uint8_t i = 0; i < count; i++)
+    {
+        uint8_t index = (mReconnectHistoryHead + RECONNECT_HISTORY_SIZE - count + i) % RECONNECT_HISTORY_SIZE;
+        attempts[i] = mReconnectHistory[index];
+    }
+    return count;
+}
+
+const char *AsyncWiFiManager::getFailureStr(uint8_t failure)
+{
+    switch (failure)
+    {
+    case ASYNC_WIFI_FAILURE_WRONG_PASSWORD:
+        return "wrong password";
+    case ASYNC_WIFI_FAILURE_AP_NOT_FOUND:
+        return "AP not found";
+    case ASYNC_WIFI_FAILURE_ASSOCIATION:
+        return "association failed";
+    case ASYNC_WIFI_FAILURE_DHCP_TIMEOUT:
+        return "DHCP timeout";
+    case ASYNC_WIFI_FAILURE_CONNECTION_LOST:
+        return "connection lost";
+    default:
+        return "unknown";
+    }
+}
+
+void AsyncWiFiManager::setOnStateChanged(void (*callback)(AsyncWiFiState state))
+{
+    onStateChanged = callback;
+}
+
+void AsyncWiFiManager::setOnWiFiInformationChanged(void (*callback)())
+{
+    mOnWiFiInformationChanged = callback;
+}
+
+void AsyncWiFiManager::setOnParametersChanged(void (*callback)())
+{
+    mOnParametersChanged = callback;
+}
+
+#if ASYNC_WIFI_LOG_LEVEL > ASYNC_WIFI_LOG_LEVEL_NONE
+void AsyncWiFiManager::setLogSink(void (*sink)(uint8_t level, const char *message))
+{
+    mLogSink = sink ? sink : serialLogSink;
+}
+
+// Single consumer. Stops at a message that is still being formatted, it is written by the next call
+void AsyncWiFiManager::flushLog()
+{
+    uint8_t tail = mLogTail.load(std::memory_order_relaxed);
+    while (tail != mLogHead.load(std::memory_order_acquire))
+    {
+        LogEntry &entry = mLogQueue[tail];
+        if (!entry.ready.load(std::memory_order_acquire))
+        {
+            break;
+        }
+        mLogSink(entry.level, entry.message);
+        entry.ready.store(false, std::memory_order_relaxed);
+        tail = (tail + 1) % LOG_QUEUE_SIZE;
+        mLogTail.store(tail, std::memory_order_release);
+    }
+
+    uint32_t droppedCount = mLogDroppedCount.load(std::memory_order_relaxed);
+    if (droppedCount != mLogReportedDroppedCount)
+    {
+        char message[LOG_MESSAGE_SIZE];
+        snprintf_P(message, sizeof(message), PSTR("%lu log messages dropped"), (unsigned long)(droppedCount - mLogReportedDroppedCount));
+        mLogReportedDroppedCount = droppedCount;
+        mLogSink(ASYNC_WIFI_LOG_LEVEL_ERROR, message);
+    }
+}
+
+uint32_t AsyncWiFiManager::getLogDroppedCount()
+{
+    return mLogDroppedCount.load(std::memory_order_relaxed);
+}
+
+// Can be called from any task. A slot is reserved first, then marked ready once the message is formatted
+void AsyncWiFiManager::logMessage(uint8_t level, PGM_P format, ...)
+{
+    uint8_t head = mLogHead.load(std::memory_order_relaxed);
+    uint8_t next;
+    do
+    {
+        next = (head + 1) % LOG_QUEUE_SIZE;
+        if (next == mLogTail.load(std::memory_order_acquire))
+        {
+            mLogDroppedCount.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+    } while (!mLogHead.compare_exchange_weak(head, next, std::memory_order_acq_rel, std::memory_order_relaxed));
+
+    LogEntry &entry = mLogQueue[head];
+    va_list args;
+    va_start(args, format);
+    vsnprintf_P(entry.message, sizeof(entry.message), format, args);
+    va_end(args);
+    entry.level = level;
+    entry.ready.store(true, std::memory_order_release);
+}
+
+void AsyncWiFiManager::serialLogSink(uint8_t level, const char *message)
+{
+    if (level == ASYNC_WIFI_LOG_LEVEL_ERROR)
+    {
+        Serial.print(F("[E]"));
+    }
+    Serial.print(F("[" TAG "] "));
+    Serial.println(message);
+}
+#endif
+
+const AsyncWiFiConnectStats &AsyncWiFiManager::getConnectStats()
+{
+    return mConnectStats;
+}
+
+int AsyncWiFiManager::getState()
+{
+    return mState;
+}
+
+AsyncWiFiSnapshot AsyncWiFiManager::getSnapshot()
+{
+    AsyncWiFiSnapshot snapshot;
+    uint32_t sequence;
+    do
+    {
+        sequence = mSnapshotSequence.load(std::memory_order_acquire);
+        memcpy(&snapshot, &mSnapshot, sizeof(snapshot));
+        std::atomic_thread_fence(std::memory_order_acquire);
+    } while ((sequence & 1) || sequence != mSnapshotSequence.load(std::memory_order_relaxed));
+    return snapshot;
+}
+
+uint32_t AsyncWiFiManager::getEventDropCount()
+{
+    return mEventDropCount.load(std::memory_order_relaxed);
+}
+
+const char *AsyncWiFiManager::getStateStr()
+{
+    return getStateName(mState);
+}
+
+#ifndef ASYNC_WIFI_DISABLE_CONFIG_PORTAL
+AsyncWiFiApplyStatus AsyncWiFiManager::getApplyStatus()
+{
+    return (AsyncWiFiApplyStatus)mApplyStatus;
+}
+#endif
+
+#ifdef ASYNC_WIFI_ENABLE_OTA
+// Longer values are truncated to 32 bytes
+void AsyncWiFiManager::setUpdateCredentials(const char *user, const char *password)
+{
+    strlcpy(mUpdateUser, user, sizeof(mUpdateUser));
+    strlcpy(mUpdatePassword, password, sizeof(mUpdatePassword));
+}
+
+void AsyncWiFiManager::setOnUpdateProgress(void (*callback)(size_t written, size_t total))
+{
+    mOnUpdateProgress = callback;
+}
+
+const AsyncWiFiUpdateStats &AsyncWiFiManager::getUpdateStats()
+{
+    return mUpdateStats;
+}
+#endif
+
+const char *AsyncWiFiManager::getStateName(int state)
+{
+    switch (state)
+    {
+    case ASYNC_WIFI_STATE_NONE:
+        return "NONE";
+    case ASYNC_WIFI_STATE_CONNECTING:
+        return "CONNECTING";
+    case ASYNC_WIFI_STATE_CONFIG_PORTAL:
+        return "CONFIG_PORTAL";
+    case ASYNC_WIFI_STATE_CONNECTED:
+        return "CONNECTED";
+    case ASYNC_WIFI_STATE_DISCONNECTED:
+        return "DISCONNECTED";
+    case ASYNC_WIFI_STATE_DEGRADED:
+        return "DEGRADED";
+    default:
+        return "UNKNOWN";
+    }
+}
+
+void AsyncWiFiManager::setState(int state)
+{
+    if (mState != state)
+    {
+#ifdef ASYNC_WIFI_ENABLE_METRICS
+        mMetrics.stateTime[mState] += millis() - mStateTime;
+        sampleHeap();
+#endif
+        mState = state;
+        mStateTime = millis();
+        mStateTimeout = getStateTimeout(state);
+        LOG("State changed to %s", getStateStr());
+        updateSnapshot();
+        notify(NOTIFY_STATE_CHANGED, state);
+    }
+}
+
+// Single writer, readers retry while the sequence number is odd or has changed
+void AsyncWiFiManager::updateSnapshot()
+{
+    bool isConnected = mState == ASYNC_WIFI_STATE_CONNECTED || mState == ASYNC_WIFI_STATE_DEGRADED;
+    uint32_t sequence = mSnapshotSequence.load(std::memory_order_relaxed);
+    mSnapshotSequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    mSnapshot.state = (AsyncWiFiState)mState;
+    mSnapshot.stateTime = mStateTime;
+    mSnapshot.localIP = isConnected ? (uint32_t)WiFi.localIP() : 0;
+    strlcpy(mSnapshot.ssid, isConnected ? mSavedSSID : "", sizeof(mSnapshot.ssid));
+#ifdef ASYNC_WIFI_ENABLE_TASK
+    mSnapshot.notificationDropCount = mNotificationDropCount;
+#endif
+    mSnapshotSequence.store(sequence + 2, std::memory_order_release);
+}
+
+// The callbacks are called at once, or from loop() when the task runs
+void AsyncWiFiManager::notify(uint8_t type, uint8_t state)
+{
+#ifdef ASYNC_WIFI_ENABLE_TASK
+    if (mTaskHandle)
+    {
+        // Single producer (task), single consumer (loop). Notifications are dropped when the queue is full
+        uint8_t head = mNotificationHead.load(std::memory_order_relaxed);
+        uint8_t next = (head + 1) % NOTIFICATION_QUEUE_SIZE;
+        if (next == mNotificationTail.load(std::memory_order_acquire))
+        {
+            LOGE("Notification queue full");
+            mNotificationDropCount++;
+            updateSnapshot();
+            return;
+        }
+        mNotificationQueue[head].type = type;
+        mNotificationQueue[head].state = state;
+        mNotificationHead.store(next, std::memory_order_release);
+        return;
+    }
+#endif
+    dispatchNotification(type, state);
+}
+
+void AsyncWiFiManager::dispatchNotification(uint8_t type, uint8_t state)
+{
+    switch (type)
+    {
+    case NOTIFY_STATE_CHANGED:
+        if (onStateChanged)
+        {
+            onStateChanged((AsyncWiFiState)state);
+        }
+        break;
+    case NOTIFY_WIFI_INFORMATION_CHANGED:
+        if (mOnWiFiInformationChanged)
+        {
+            mOnWiFiInformationChanged();
+        }
+        break;
+    case NOTIFY_PARAMETERS_CHANGED:
+        if (mOnParametersChanged)
+        {
+            mOnParametersChanged();
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+#ifdef ASYNC_WIFI_ENABLE_TASK
+void AsyncWiFiManager::processNotifications()
+{
+    uint8_t tail = mNotificationTail.load(std::memory_order_relaxed);
+    while (tail != mNotificationHead.load(std::memory_order_acquire))
+    {
+        Notification notification = mNotificationQueue[tail];
+        tail = (tail + 1) % NOTIFICATION_QUEUE_SIZE;
+        mNotificationTail.store(tail, std::memory_order_release);
+        dispatchNotification(notification.type, notification.state);
+    }
+}
+#endif
+
+#ifndef ASYNC_WIFI_DISABLE_SCAN
+void AsyncWiFiManager::startScanNetworks()
+{
+    if (!mIsScanning)
+    {
+        LOG("Start scan networks");
+        mIsScanning = true;
+        mLastScanTime = millis();
+        if (WiFi.status() == WL_CONNECTED)
+        {
+            LOG("Disconnecting networks");
+            WiFi.disconnect();
+        }
+        // Keep the config portal AP running while scanning
+        bool isSliced = mScanOptions.channelMask != 0;
+        if (WiFi.getMode() & WIFI_AP)
+        {
+            WiFi.mode(WIFI_AP_STA);
+            isSliced = true;
+        }
+        else
+        {
+            WiFi.mode(WIFI_STA);
+        }
+        // The results of the previous scan are kept until this one completes
+        for (uint8_t i = 0; i < mScanResultCount; i++)
+        {
+            mScanResults[i].seen = false;
+        }
+        startScanSlice(isSliced ? getNextScanChannel(0) : 0);
+    }
+}
+
+void AsyncWiFiManager::stopScanNetworks()
+{
+    if (mIsScanning)
+    {
+        LOG("Stop scan networks");
+        WiFi.scanDelete();
+        mIsScanning = false;
+        mIsScanSlicePending = false;
+        mIsRoamScan = false;
+    }
+}
+
+// Scan one channel, or all channels if channel is 0. Completion is reported by an event
+void AsyncWiFiManager::startScanSlice(uint8_t channel)
+{
+    const char *ssid = mScanOptions.ssid[0] != '\0' ? mScanOptions.ssid : nullptr;
+    mScanChannel = channel;
+#ifdef ESP8266
+    int8_t result = WiFi.scanNetworks(true, false, channel, (uint8_t *)ssid);
+#else
+    int16_t result = WiFi.scanNetworks(true, false, mScanOptions.passive, mScanOptions.dwellTime, channel, ssid);
+#endif
+    if (result == WIFI_SCAN_FAILED)
+    {
+        LOGE("WiFi scan failed");
+        pushEvent(ASYNC_WIFI_EVENT_SCAN_DONE, 0);
+    }
+}
+
+// Next channel to scan after the given one, 0 when there is none
+uint8_t AsyncWiFiManager::getNextScanChannel(uint8_t channel)
+{
+    uint16_t mask = mScanOptions.channelMask ? mScanOptions.channelMask : SCAN_ALL_CHANNELS;
+    while (++channel <= 14)
+    {
+        if (mask & (1 << channel))
+        {
+            return channel;
+        }
+    }
+    return 0;
+}
+
+const char *AsyncWiFiManager::getEncryptionTypeStr(uint8_t encType)
+{
+#ifdef ESP8266
+    switch (encType)
+    {
+    case AUTH_OPEN:
+        return "open";
+    case AUTH_WEP:
+        return "WEP";
+    case AUTH_WPA_PSK:
+        return "WPA";
+    case AUTH_WPA2_PSK:
+        return "WPA2";
+    case AUTH_WPA_WPA2_PSK:
+        return "WPA+WPA2";
+    default:
+        return "unknown";
+    }
+#else
+    switch (encType)
+    {
+    case WIFI_AUTH_OPEN:
+        return "open";
+    case WIFI_AUTH_WEP:
+        return "WEP";
+    case WIFI_AUTH_WPA_PSK:
+        return "WPA";
+    case WIFI_AUTH_WPA2_PSK:
+        return "WPA2";
+    case WIFI_AUTH_WPA_WPA2_PSK:
+        return "WPA+WPA2";
+    case WIFI_AUTH_WPA2_ENTERPRISE:
+        return "WPA2-EAP";
+    case WIFI_AUTH_WPA3_PSK:
+        return "WPA3";
+    case WIFI_AUTH_WPA2_WPA3_PSK:
+        return "WPA2+WPA3";
+    case WIFI_AUTH_WAPI_PSK:
+        return "WAPI";
+    default:
+        return "unknown";
+    }
+#endif
+}
+
+void AsyncWiFiManager::printScannedNetWorks()
+{
+    for (uint8_t i = 0; i < mScanResultCount; i++)
+    {
+        [[maybe_unused]] const AsyncWiFiScanResult &network = mScanResults[i];
+        LOG("%2d. %-24s %4ddBm | ch %2d | %s", i + 1, network.ssid, network.rssi, network.channel, getEncryptionTypeStr(network.encType));
+    }
+}
+
+// Merge the driver scan results into the cache, keeping only the strongest access point of each SSID, sorted by signal
+void AsyncWiFiManager::updateScanResults(int count)
+{
+    String ssid;
+    uint8_t encType;
+    int32_t rssi;
+    uint8_t *bssid;
+    int32_t channel;
+    bool hidden = false;
+
+    for (int i = 0; i < count; i++)
+    {
+#ifdef ESP8266
+        if (!WiFi.getNetworkInfo(i, ssid, encType, rssi, bssid, channel, hidden))
+#else
+        if (!WiFi.getNetworkInfo(i, ssid, encType, rssi, bssid, channel))
+#endif
+        {
+            continue;
+        }
+        if (hidden || ssid.length() == 0)
+        {
+            continue;
+        }
+
+        uint8_t pos = 0;
+        while (pos < mScanResultCount && strncmp(mScanResults[pos].ssid, ssid.c_str(), WIFI_SSID_MAX_LENGTH) != 0)
+        {
+            pos++;
+        }
+        if (pos < mScanResultCount)
+        {
+            if (mScanResults[pos].seen && mScanResults[pos].rssi >= rssi)
+            {
+                continue;
+            }
+            // Remove the weaker access point, or the result of the previous scan, with the same SSID
+            memmove(&mScanResults[pos], &mScanResults[pos + 1], (mScanResultCount - pos - 1) * sizeof(AsyncWiFiScanResult));
+            mScanResultCount--;
+        }
+
+        pos = 0;
+        while (pos < mScanResultCount && mScanResults[pos].rssi >= rssi)
+        {
+            pos++;
+        }
+        if (pos >= WIFI_SCAN_CACHE_SIZE)
+        {
+            continue;
+        }
+        if (mScanResultCount == WIFI_SCAN_CACHE_SIZE)
+        {
+            mScanResultCount--;
+        }
+        memmove(&mScanResults[pos + 1], &mScanResults[pos], (mScanResultCount - pos) * sizeof(AsyncWiFiScanResult));
+        mScanResultCount++;
+
+        AsyncWiFiScanResult &network = mScanResults[pos];
+        strncpy(network.ssid, ssid.c_str(), WIFI_SSID_MAX_LENGTH);
+        network.ssid[WIFI_SSID_MAX_LENGTH] = '\0';
+        network.rssi = rssi;
+        network.channel = channel;
+        network.encType = encType;
+        memcpy(network.bssid, bssid, sizeof(network.bssid));
+        network.seen = true;
+    }
+}
+#endif
+
+#ifndef ASYNC_WIFI_DISABLE_CONFIG_PORTAL
+bool AsyncWiFiManager::sendScannedWifiList()
+{
+#ifndef ASYNC_WIFI_DISABLE_SCAN
+    char buffer[SEND_BUFFER_SIZE];
+    char item[SEND_BUFFER_SIZE];
+    size_t length = 0;
+
+    for (uint8_t i = 0; i < mScanResultCount; i++)
+    {
+        const AsyncWiFiScanResult &network = mScanResults[i];
+        // Saved networks are marked. The SSID comes from any nearby AP, so it is escaped like a parameter value
+        int itemLength = snprintf_P(item, sizeof(item), HTML_WIFI_ITEM, findNetwork(network.ssid) >= 0 ? " class='s'" : "");
+        sendChunked(buffer, length, item, min(itemLength, (int)sizeof(item) - 1));
+        sendEscapedHtml(buffer, length, network.ssid);
+        itemLength = snprintf_P(item, sizeof(item), HTML_WIFI_ITEM_END, getRssiLevel(network.rssi), isLockedNetwork(network) ? " l" : "");
+        sendChunked(buffer, length, item, min(itemLength, (int)sizeof(item) - 1));
+    }
+    if (length > 0)
+    {
+        sendContent(buffer, length);
+    }
+    // The buffer may be empty after a full chunk was sent, so the result is not taken from it
+    return mScanResultCount > 0;
+#else
+    return false;
+#endif
+}
+
+void AsyncWiFiManager::sendScannedWifiJson()
+{
+    char buffer[SEND_BUFFER_SIZE];
+    size_t length = 0;
+
+    sendChunked(buffer, length, "[", 1);
+#ifndef ASYNC_WIFI_DISABLE_SCAN
+    char item[SEND_BUFFER_SIZE];
+    for (uint8_t i = 0; i < mScanResultCount; i++)
+    {
+        const AsyncWiFiScanResult &network = mScanResults[i];
+        // Streamed around the SSID, which is up to 6 times longer once escaped
+        int itemLength = snprintf_P(item, sizeof(item), JSON_WIFI_ITEM, i > 0 ? "," : "");
+        sendChunked(buffer, length, item, min(itemLength, (int)sizeof(item) - 1));
+        sendEscapedJson(buffer, length, network.ssid);
+        itemLength = snprintf_P(item, sizeof(item), JSON_WIFI_ITEM_END, network.rssi, getRssiLevel(network.rssi),
+                                isLockedNetwork(network), network.channel, findNetwork(network.ssid) >= 0);
+        sendChunked(buffer, length, item, min(itemLength, (int)sizeof(item) - 1));
+    }
+#endif
+    sendChunked(buffer, length, "]", 1);
+    sendContent(buffer, length);
+}
+
+// Render the custom parameters into the config portal form
+void AsyncWiFiManager::sendParameters()
+{
+    char buffer[SEND_BUFFER_SIZE];
+    char item[SEND_BUFFER_SIZE];
+    size_t length = 0;
+    int itemLength = 0;
+
+    for (uint8_t i = 0; i < mParameterCount; i++)
+    {
+        const CustomParameter &parameter = mParameters[i];
+        switch (parameter.type)
+        {
+        case ASYNC_WIFI_PARAMETER_STRING:
+            itemLength = snprintf_P(item, sizeof(item), HTML_PARAMETER_STRING, parameter.id, parameter.label, parameter.id,
+                                    parameter.id, parameter.maxLength);
+            sendChunked(buffer, length, item, min(itemLength, (int)sizeof(item) - 1));
+            sendEscapedHtml(buffer, length, (const char *)parameter.value);
+            itemLength = snprintf_P(item, sizeof(item), HTML_PARAMETER_STRING_END);
+            break;
+        case ASYNC_WIFI_PARAMETER_INT:
+            itemLength = snprintf_P(item, sizeof(item), HTML_PARAMETER_INT, parameter.id, parameter.label, parameter.id,
+                                    parameter.id, (long)parameter.min, (long)parameter.max, (long)*(int32_t *)parameter.value);
+            break;
+        case ASYNC_WIFI_PARAMETER_BOOL:
+            itemLength = snprintf_P(item, sizeof(item), HTML_PARAMETER_BOOL, parameter.id, parameter.id,
+                                    *(bool *)parameter.value ? " checked" : "", parameter.id, parameter.label);
+            break;
+        }
+        sendChunked(buffer, length, item, min(itemLength, (int)sizeof(item) - 1));
+    }
+    if (length > 0)
+    {
+        sendContent(buffer, length);
+    }
+}
+
+// Append text to the chunk buffer with the characters that are special in HTML replaced by references
+void AsyncWiFiManager::sendEscapedHtml(char *buffer, size_t &length, const char *text)
+{
+    char reference[8]; // "&#255;"
+    while (*text)
+    {
+        size_t count = strcspn(text, "&<>'\"");
+        sendChunked(buffer, length, text, count);
+        text += count;
+        if (*text)
+        {
+            int referenceLength = snprintf(reference, sizeof(reference), "&#%u;", (unsigned char)*text++);
+            sendChunked(buffer, length, reference, referenceLength);
+        }
+    }
+}
+
+// Append text to the chunk buffer as the content of a JSON string
+void AsyncWiFiManager::sendEscapedJson(char *buffer, size_t &length, const char *text)
+{
+    char escape[8]; // "\u001f"
+    while (*text)
+    {
+        size_t count = 0;
+        while (text[count] && text[count] != '"' && text[count] != '\\' && (uint8_t)text[count] >= 0x20)
+        {
+            count++;
+        }
+        sendChunked(buffer, length, text, count);
+        text += count;
+        if (*text)
+        {
+            uint8_t c = *text++;
+            int escapeLength = c < 0x20 ? snprintf(escape, sizeof(escape), "\\u%04x", c) : snprintf(escape, sizeof(escape), "\\%c", c);
+            sendChunked(buffer, length, escape, escapeLength);
+        }
+    }
+}
+
+// Space taken by the value of a parameter in the pending values
+size_t AsyncWiFiManager::getParameterSize(const CustomParameter &parameter)
+{
+    switch (parameter.type)
+    {
+    case ASYNC_WIFI_PARAMETER_STRING:
+        return parameter.maxLength + 1;
+    case ASYNC_WIFI_PARAMETER_INT:
+        return sizeof(int32_t);
+    default:
+        return sizeof(bool);
+    }
+}
+
+// Check the submitted parameters and copy them to values when it is not null, one after the other.
+// Returns false if a value is invalid
+bool AsyncWiFiManager::parseParameters(uint8_t *values)
+{
+    char number[12];
+    for (uint8_t i = 0; i < mParameterCount; i++)
+    {
+        const CustomParameter &parameter = mParameters[i];
+        uint8_t *pending = values;
+        if (values)
+        {
+            values += getParameterSize(parameter);
+        }
+        if (parameter.type == ASYNC_WIFI_PARAMETER_BOOL)
+        {
+            // An unchecked box is not submitted
+            if (pending)
+            {
+                *(bool *)pending = hasArg(parameter.id);
+            }
+            continue;
+        }
+        if (parameter.type == ASYNC_WIFI_PARAMETER_STRING)
+        {
+            int length = readArg(parameter.id, (char *)pending, pending ? parameter.maxLength + 1 : 0);
+            if (length > parameter.maxLength)
+            {
+                LOGE("Invalid parameter %s", parameter.id);
+                return false;
+            }
+            if (length < 0 && pending)
+            {
+                // A missing field keeps the current value
+                memcpy(pending, parameter.value, parameter.maxLength + 1);
+            }
+            continue;
+        }
+        int length = readArg(parameter.id, number, sizeof(number));
+        char *end;
+        long value = strtol(number, &end, 10);
+        if (length <= 0 || length >= (int)sizeof(number) || *end != '\0' || value < parameter.min || value > parameter.max)
+        {
+            LOGE("Invalid parameter %s", parameter.id);
+            return false;
+        }
+        if (pending)
+        {
+            // The values are not aligned
+            int32_t result = value;
+            memcpy(pending, &result, sizeof(result));
+        }
+    }
+    return true;
+}
+
+// Called from loop() with the values checked by parseParameters()
+void AsyncWiFiManager::applyParameters(const uint8_t *values)
+{
+    for (uint8_t i = 0; i < mParameterCount; i++)
+    {
+        const CustomParameter &parameter = mParameters[i];
+        size_t size = getParameterSize(parameter);
+        memcpy(parameter.value, values, size);
+        values += size;
+    }
+}
+
+// Append data to the chunk buffer, the buffer is sent to the client each time it is full
+void AsyncWiFiManager::sendChunked(char *buffer, size_t &length, const char *data, int size)
+{
+    while (size > 0)
+    {
+        size_t count = min((size_t)size, SEND_BUFFER_SIZE - length);
+        memcpy(buffer + length, data, count);
+        length += count;
+        data += count;
+        size -= count;
+        if (length == SEND_BUFFER_SIZE)
+        {
+            sendContent(buffer, length);
+            length = 0;
+        }
+    }
+}
+#endif
+
+#ifndef ASYNC_WIFI_DISABLE_SCAN
+bool AsyncWiFiManager::isLockedNetwork(const AsyncWiFiScanResult &network)
+{
+#ifdef ESP8266
+    return network.encType != AUTH_OPEN;
+#else
+    return network.encType != WIFI_AUTH_OPEN;
+#endif
+}
+#endif
+
+bool AsyncWiFiManager::isValidWifiSettings()
+{
+    return mSavedSSID[0] != '\0' && mSavedPassword[0] != '\0';
+}
+
+// Start with the most recently used network. After a deep sleep it comes from the RTC cache and the saved networks
+// are only read when needed. Without persistence they are the ones set with setWifiInformation() and addWifiInformation()
+void AsyncWiFiManager::readSavedSettings()
+{
+#ifndef ASYNC_WIFI_DISABLE_PERSISTENCE
+    SavedNetwork network;
+    if (readRtcCache(network))
+    {
+        LOG("Warm boot, use cached WiFi");
+        strlcpy(mSavedSSID, network.ssid, sizeof(mSavedSSID));
+        strlcpy(mSavedPassword, network.password, sizeof(mSavedPassword));
+        memcpy(mSavedBSSID, network.bssid, sizeof(mSavedBSSID));
+        mSavedChannel = network.channel;
+        mConnectStats.warmBoot = true;
+        return;
+    }
+    loadSettings();
+#endif
+    int recent = -1;
+    for (uint8_t i = 0; i < mNetworkCount; i++)
+    {
+        if (recent < 0 || mNetworks[i].lastUsed > mNetworks[recent].lastUsed)
+        {
+            recent = i;
+        }
+    }
+    if (recent >= 0)
+    {
+        useNetwork(recent);
+    }
+}
+
+// Store the network of the current connection as the most recently used one, then write the saved networks
+bool AsyncWiFiManager::saveSettings()
+{
+#ifndef ASYNC_WIFI_DISABLE_PERSISTENCE
+    loadSettings();
+#endif
+    storeNetwork(mSavedSSID, mSavedPassword, mSavedBSSID, mSavedChannel);
+#ifndef ASYNC_WIFI_DISABLE_PERSISTENCE
+    if (!writeSettingsFile())
+    {
+        LOGE("Failed to save settings");
+        return false;
+    }
+    if (mSavedSSID[0] != '\0')
+    {
+        LOG("Saved WiFi: %s", mSavedSSID);
+    }
+#endif
+    return true;
+}
+
+int AsyncWiFiManager::findNetwork(const char *ssid)
+{
+    for (uint8_t i = 0; i < mNetworkCount; i++)
+    {
+        if (strncmp(mNetworks[i].ssid, ssid, WIFI_SSID_MAX_LENGTH) == 0)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Add or update a saved network and make it the most recently used one. Returns true if the saved networks changed
+bool AsyncWiFiManager::storeNetwork(const char *ssid, const char *password, const uint8_t *bssid, uint8_t channel)
+{
+    if (ssid[0] == '\0')
+    {
+        return false;
+    }
+
+    int index = findNetwork(ssid);
+    uint32_t lastUsed = 0;
+    uint8_t oldest = 0;
+    for (uint8_t i = 0; i < mNetworkCount; i++)
+    {
+        lastUsed = max(lastUsed, mNetworks[i].lastUsed);
+        if (mNetworks[i].lastUsed < mNetworks[oldest].lastUsed)
+        {
+            oldest = i;
+        }
+    }
+    if (index < 0)
+    {
+        if (mNetworkCount < WIFI_NETWORK_STORE_SIZE)
+        {
+            index = mNetworkCount++;
+        }
+        else
+        {
+            LOG("Replace saved WiFi: %s", mNetworks[oldest].ssid);
+            index = oldest;
+        }
+        // Zero the unused bytes, the saved networks are compared by their CRC
+        memset(&mNetworks[index], 0, sizeof(SavedNetwork));
+        strncpy(mNetworks[index].ssid, ssid, WIFI_SSID_MAX_LENGTH);
+    }
+
+    SavedNetwork &network = mNetworks[index];
+    bool changed = false;
+    if (network.lastUsed == 0 || network.lastUsed < lastUsed)
+    {
+        network.lastUsed = lastUsed + 1;
+        changed = true;
+    }
+    if (strncmp(network.password, password, WIFI_PASSWORD_MAX_LENGTH) != 0)
+    {
+        memset(network.password, 0, sizeof(network.password));
+        strncpy(network.password, password, WIFI_PASSWORD_MAX_LENGTH);
+        changed = true;
+    }
+    if (channel == 0)
+    {
+        bssid = nullptr;
+    }
+    if (network.channel != channel || (bssid && memcmp(network.bssid, bssid, sizeof(network.bssid)) != 0))
+    {
+        memset(network.bssid, 0, sizeof(network.bssid));
+        if (bssid)
+        {
+            memcpy(network.bssid, bssid, sizeof(network.bssid));
+        }
+        network.channel = channel;
+        changed = true;
+    }
+    return changed;
+}
+
+void AsyncWiFiManager::useNetwork(uint8_t index)
+{
+    const SavedNetwork &network = mNetworks[index];
+    strlcpy(mSavedSSID, network.ssid, sizeof(mSavedSSID));
+    strlcpy(mSavedPassword, network.password, sizeof(mSavedPassword));
+    memcpy(mSavedBSSID, network.bssid, sizeof(mSavedBSSID));
+    mSavedChannel = network.channel;
+}
+
+#ifndef ASYNC_WIFI_DISABLE_PERSISTENCE
+// Mount the file system and read the saved networks, once
+void AsyncWiFiManager::loadSettings()
+{
+    char ssid[WIFI_SSID_MAX_LENGTH + 1];
+    char password[WIFI_PASSWORD_MAX_LENGTH + 1];
+
+    if (mIsSettingsLoaded)
+    {
+        return;
+    }
+    mIsSettingsLoaded = true;
+    initFS();
+    if (readSettingsFile())
+    {
+        return;
+    }
+    // Settings saved by older versions are stored in two text files
+    if (FS.exists(LEGACY_SSID_FILE) && readFile(LEGACY_SSID_FILE, ssid, sizeof(ssid)) &&
+        readFile(LEGACY_PASSWORD_FILE, password, sizeof(password)))
+    {
+        LOG("Migrate saved WiFi settings");
+        storeNetwork(ssid, password, nullptr, 0);
+        if (writeSettingsFile())
+        {
+            FS.remove(LEGACY_SSID_FILE);
+            FS.remove(LEGACY_PASSWORD_FILE);
+        }
+        return;
+    }
+    LOGE("Failed to read settings");
+}
+
+bool AsyncWiFiManager::readSettingsFile()
+{
+    SettingsHeader header;
+    mNetworkCount = 0;
+    if (!FS.exists(SETTINGS_FILE))
+    {
+        return false;
+    }
+    fs::File file = FS.open(SETTINGS_FILE, "r");
+    if (!file || file.isDirectory())
+    {
+        LOGE("Failed to open file %s for reading", SETTINGS_FILE);
+        return false;
+    }
+    bool ret = file.read((uint8_t *)&header, sizeof(header)) == sizeof(header) && header.magic == SETTINGS_MAGIC;
+    if (ret && header.version < 3)
+    {
+        // Older versions store fewer fields, the missing ones are left zeroed
+        SettingsData data;
+        memset(&data, 0, sizeof(data));
+        ret = header.size <= sizeof(data) && file.read((uint8_t *)&data, header.size) == header.size &&
+              crc32(&data, header.size) == header.crc;
+        if (ret && data.ssid[0] != '\0')
+        {
+            SavedNetwork &network = mNetworks[mNetworkCount++];
+            memset(&network, 0, sizeof(network));
+            memcpy(network.ssid, data.ssid, sizeof(network.ssid) - 1);
+            memcpy(network.password, data.password, sizeof(network.password) - 1);
+            memcpy(network.bssid, data.bssid, sizeof(network.bssid));
+            network.channel = data.channel;
+        }
+    }
+    else if (ret)
+    {
+        ret = header.size <= sizeof(mNetworks) && header.size % sizeof(SavedNetwork) == 0 &&
+              file.read((uint8_t *)mNetworks, header.size) == header.size && crc32(mNetworks, header.size) == header.crc;
+        if (ret)
+        {
+            mNetworkCount = header.size / sizeof(SavedNetwork);
+        }
+    }
+    file.close();
+    if (!ret)
+    {
+        LOGE("Invalid settings file");
+        mNetworkCount = 0;
+        return false;
+    }
+    for (uint8_t i = 0; i < mNetworkCount; i++)
+    {
+        mNetworks[i].ssid[sizeof(mNetworks[i].ssid) - 1] = '\0';
+        mNetworks[i].password[sizeof(mNetworks[i].password) - 1] = '\0';
+    }
+    mSavedSettingsCrc = header.crc;
+    return true;
+}
+
+// Write the saved networks to a temporary file then rename it, so a power loss never leaves a partial file
+bool AsyncWiFiManager::writeSettingsFile()
+{
+    SettingsHeader header;
+    header.magic = SETTINGS_MAGIC;
+    header.version = SETTINGS_VERSION;
+    header.size = mNetworkCount * sizeof(SavedNetwork);
+    header.crc = crc32(mNetworks, header.size);
+    if (header.crc == mSavedSettingsCrc)
+    {
+        // Unchanged, save a flash write
+        return true;
+    }
+
+    fs::File file = FS.open(SETTINGS_TEMP_FILE, "w");
+    if (!file)
+    {
+        LOGE("Failed to open file %s for writing", SETTINGS_TEMP_FILE);
+        return false;
+    }
+    bool ret = file.write((const uint8_t *)&header, sizeof(header)) == sizeof(header) &&
+               file.write((const uint8_t *)mNetworks, header.size) == header.size;
+    file.close();
+    if (!ret || !FS.rename(SETTINGS_TEMP_FILE, SETTINGS_FILE))
+    {
+        FS.remove(SETTINGS_TEMP_FILE);
+        return false;
+    }
+    mSavedSettingsCrc = header.crc;
+    updateRtcCache();
+    return true;
+}
+
+// Set the registered parameters from the parameters file. Unknown keys and invalid values are ignored
+void AsyncWiFiManager::loadParameters()
+{
+    SettingsHeader header;
+    uint8_t record[PARAMETER_RECORD_MAX_SIZE];
+
+    initFS();
+    if (!FS.exists(PARAMETERS_FILE))
+    {
+        return;
+    }
+    fs::File file = FS.open(PARAMETERS_FILE, "r");
+    if (!file || file.isDirectory())
+    {
+        LOGE("Failed to open file %s for reading", PARAMETERS_FILE);
+        return;
+    }
+    // Check the whole file before any value is set
+    bool ret = file.read((uint8_t *)&header, sizeof(header)) == sizeof(header) && header.magic == PARAMETERS_MAGIC &&
+               header.version == PARAMETERS_VERSION && file.size() == sizeof(header) + header.size;
+    uint32_t crc = 0;
+    for (size_t remaining = header.size; ret && remaining > 0;)
+    {
+        size_t count = min(remaining, sizeof(record));
+        ret = file.read(record, count) == count;
+        crc = crc32(record, count, crc);
+        remaining -= count;
+    }
+    if (!ret || crc != header.crc || !file.seek(sizeof(header)))
+    {
+        LOGE("Invalid parameters file");
+        file.close();
+        return;
+    }
+
+    uint8_t idLength;
+    uint8_t valueLength;
+    char id[PARAMETER_ID_MAX_LENGTH + 1];
+    while (file.available())
+    {
+        if (file.read(&idLength, 1) != 1 || idLength > PARAMETER_ID_MAX_LENGTH || file.read((uint8_t *)id, idLength) != idLength ||
+            file.read(record, 2) != 2)
+        {
+            break;
+        }
+        id[idLength] = '\0';
+        valueLength = record[1];
+        if (file.read(record + 2, valueLength) != valueLength)
+        {
+            break;
+        }
+        for (uint8_t i = 0; i < mParameterCount; i++)
+        {
+            CustomParameter &parameter = mParameters[i];
+            if (strcmp(parameter.id, id) != 0 || parameter.type != record[0])
+            {
+                continue;
+            }
+            if (parameter.type == ASYNC_WIFI_PARAMETER_STRING && valueLength <= parameter.maxLength)
+            {
+                memcpy(parameter.value, record + 2, valueLength);
+                ((char *)parameter.value)[valueLength] = '\0';
+            }
+            else if (parameter.type == ASYNC_WIFI_PARAMETER_INT && valueLength == sizeof(int32_t))
+            {
+                int32_t value;
+                memcpy(&value, record + 2, sizeof(value));
+                if (value >= parameter.min && value <= parameter.max)
+                {
+                    *(int32_t *)parameter.value = value;
+                }
+            }
+            else if (parameter.type == ASYNC_WIFI_PARAMETER_BOOL && valueLength == 1)
+            {
+                *(bool *)parameter.value = record[2] != 0;
+            }
+        }
+    }
+    file.close();
+    mSavedParametersCrc = header.crc;
+}
+
+// Write all the parameters at once to a temporary file then rename it, like the settings file
+bool AsyncWiFiManager::saveParameters()
+{
+    SettingsHeader header;
+    uint8_t record[PARAMETER_RECORD_MAX_SIZE];
+
+    header.magic = PARAMETERS_MAGIC;
+    header.version = PARAMETERS_VERSION;
+    header.size = 0;
+    header.crc = 0;
+    for (uint8_t i = 0; i < mParameterCount; i++)
+    {
+        size_t length = serializeParameter(mParameters[i], record);
+        header.size += length;
+        header.crc = crc32(record, length, header.crc);
+    }
+    if (header.crc == mSavedParametersCrc)
+    {
+        // Unchanged, save a flash write
+        return true;
+    }
+
+    initFS();
+    fs::File file = FS.open(PARAMETERS_TEMP_FILE, "w");
+    if (!file)
+    {
+        LOGE("Failed to open file %s for writing", PARAMETERS_TEMP_FILE);
+        return false;
+    }
+    bool ret = file.write((const uint8_t *)&header, sizeof(header)) == sizeof(header);
+    for (uint8_t i = 0; ret && i < mParameterCount; i++)
+    {
+        size_t length = serializeParameter(mParameters[i], record);
+        ret = file.write(record, length) == length;
+    }
+    file.close();
+    if (!ret || !FS.rename(PARAMETERS_TEMP_FILE, PARAMETERS_FILE))
+    {
+        FS.remove(PARAMETERS_TEMP_FILE);
+        LOGE("Failed to save parameters");
+        return false;
+    }
+    mSavedParametersCrc = header.crc;
+    LOG("Saved parameters");
+    return true;
+}
+
+size_t AsyncWiFiManager::serializeParameter(const CustomParameter &parameter, uint8_t *record)
+{
+    size_t idLength = strlen(parameter.id);
+    size_t valueLength;
+    switch (parameter.type)
+    {
+    case ASYNC_WIFI_PARAMETER_STRING:
+        valueLength = strnlen((const char *)parameter.value, parameter.maxLength);
+        break;
+    case ASYNC_WIFI_PARAMETER_INT:
+        valueLength = sizeof(int32_t);
+        break;
+    default:
+        valueLength = 1;
+        break;
+    }
+    record[0] = idLength;
+    memcpy(record + 1, parameter.id, idLength);
+    record[idLength + 1] = parameter.type;
+    record[idLength + 2] = valueLength;
+    memcpy(record + idLength + 3, parameter.value, valueLength);
+    return idLength + 3 + valueLength;
+}
+
+bool AsyncWiFiManager::readRtcCache(SavedNetwork &network)
+{
+    RtcCache cache;
+#ifdef ESP8266
+    if (!ESP.rtcUserMemoryRead(RTC_CACHE_OFFSET, (uint32_t *)&cache, sizeof(cache)))
+    {
+        return false;
+    }
+#else
+    cache = mRtcCache;
+#endif
+    // The RTC memory holds random data after a power on
+    if (cache.magic != RTC_CACHE_MAGIC || cache.crc != crc32(&cache.network, sizeof(cache.network)))
+    {
+        return false;
+    }
+    network = cache.network;
+    network.ssid[sizeof(network.ssid) - 1] = '\0';
+    network.password[sizeof(network.password) - 1] = '\0';
+    return network.ssid[0] != '\0';
+}
+
+// Cache the network of the current connection while it is the most recently used saved one,
+// so that a warm boot joins the same network as a cold one
+void AsyncWiFiManager::updateRtcCache()
+{
+    RtcCache cache;
+    memset(&cache, 0, sizeof(cache));
+    int index = findNetwork(mSavedSSID);
+    bool isRecent = index >= 0;
+    for (uint8_t i = 0; isRecent && i < mNetworkCount; i++)
+    {
+        isRecent = mNetworks[i].lastUsed <= mNetworks[index].lastUsed;
+    }
+    if (isRecent)
+    {
+        cache.network = mNetworks[index];
+        memcpy(cache.network.bssid, mSavedBSSID, sizeof(cache.network.bssid));
+        cache.network.channel = mSavedChannel;
+        cache.magic = RTC_CACHE_MAGIC;
+        cache.crc = crc32(&cache.network, sizeof(cache.network));
+    }
+#ifdef ESP8266
+    ESP.rtcUserMemoryWrite(RTC_CACHE_OFFSET, (uint32_t *)&cache, sizeof(cache));
+#else
+    mRtcCache = cache;
+#endif
+}
+#endif
+
+#ifndef ASYNC_WIFI_DISABLE_CONFIG_PORTAL
+void AsyncWiFiManager::startConfigPortal()
+{
+    if (mState != ASYNC_WIFI_STATE_NONE)
+    {
+        LOGE("Cannot start config portal");
+        return;
+    }
+#ifndef ASYNC_WIFI_DISABLE_PERSISTENCE
+    // The portal marks the saved networks
+    loadSettings();
+#endif
+
+    setState(ASYNC_WIFI_STATE_CONFIG_PORTAL);
+    WiFi.mode(WIFI_AP);
+    if (mAPSSID[0] == '\0' || mAPPassword[0] == '\0')
+    {
+        LOG("AP SSID or password has not been set. Use default AP: '%s' '%s'", mAPSSID, mAPPassword);
+        strlcpy(mAPSSID, AP_SSID_DEFAULT, sizeof(mAPSSID));
+        strlcpy(mAPPassword, AP_PASSWORD_DEFAULT, sizeof(mAPPassword));
+    }
+    mAPChannel = getAPChannel();
+    if (!WiFi.softAP(mAPSSID, mAPPassword, mAPChannel))
+    {
+        LOGE("Failed to start AP");
+        setState(ASYNC_WIFI_STATE_NONE);
+        return;
+    }
+    WiFi.softAPConfig(AP_IP_ADDR, IPAddress(0, 0, 0, 0), IPAddress(255, 255, 255, 0));
+    LOG("Start config portal AP: %s (channel %d)", mAPSSID, mAPChannel);
+
+    startCaptiveDnsServer();
+    startServer();
+#ifndef ASYNC_WIFI_DISABLE_MDNS
+    startMDNS();
+#endif
+#ifndef ASYNC_WIFI_DISABLE_SCAN
+    startScanNetworks();
+#endif
+}
+
+void AsyncWiFiManager::stopConfigPortal()
+{
+    if (mState != ASYNC_WIFI_STATE_CONFIG_PORTAL)
+    {
+        return;
+    }
+    LOG("Stop config portal");
+    mApplyStatus = ASYNC_WIFI_APPLY_IDLE;
+    setState(ASYNC_WIFI_STATE_DISCONNECTED);
+    WiFi.softAPdisconnect(true);
+    WiFi.mode(WIFI_OFF);
+    stopCaptiveDnsServer();
+    stopServer();
+    // stopMDNS();
+#ifndef ASYNC_WIFI_DISABLE_SCAN
+    stopScanNetworks();
+#endif
+}
+
+// Run the AP on the channel of the network that will most likely be joined, the strongest saved one in the last scan
+// or the one of the last connection. The radio then does not have to switch channels while the STA connects
+uint8_t AsyncWiFiManager::getAPChannel()
+{
+#ifndef ASYNC_WIFI_DISABLE_SCAN
+    for (uint8_t i = 0; i < mScanResultCount; i++)
+    {
+        if (findNetwork(mScanResults[i].ssid) >= 0)
+        {
+            return mScanResults[i].channel;
+        }
+    }
+#endif
+    return mSavedChannel > 0 ? mSavedChannel : AP_CHANNEL_DEFAULT;
+}
+
+// Restart the AP on another channel. Its clients reconnect, which is faster than waiting for the driver
+// to pull the AP to the channel of the STA connection
+void AsyncWiFiManager::moveAP(uint8_t channel)
+{
+    if (channel == 0 || channel == mAPChannel)
+    {
+        return;
+    }
+    LOG("Move AP to channel %d", channel);
+    mAPChannel = channel;
+    WiFi.softAP(mAPSSID, mAPPassword, mAPChannel);
+}
+
+void AsyncWiFiManager::startServer()
+{
+    if (!mServer)
+    {
+        LOG("Start server");
+        size_t size = 0;
+        for (uint8_t i = 0; i < mParameterCount; i++)
+        {
+            size += getParameterSize(mParameters[i]);
+        }
+        if (size > 0)
+        {
+            mPendingParameters = new uint8_t[size];
+        }
+        mServer = new WebServerClass(80);
+#ifdef ASYNC_WIFI_USE_ASYNC_WEBSERVER
+        mServer->onNotFound([](AsyncWebServerRequest *request)
+                            { handleRequest(request, notFoundHandler); });
+#else
+        mServer->onNotFound(notFoundHandler);
+        mServer->collectHeaders(HTTP_HEADER_KEYS, sizeof(HTTP_HEADER_KEYS) / sizeof(HTTP_HEADER_KEYS[0]));
+#endif
+        addRoute("/", rootHandler);
+        addRoute("/save", saveDataHandler);
+        addRoute("/scan.json", scanHandler);
+        addRoute("/status.json", statusHandler);
+        addRoute("/style.css", styleHandler);
+        addRoute("/script.js", scriptHandler);
+#ifdef ASYNC_WIFI_ENABLE_METRICS
+        addRoute("/metrics", metricsHandler);
+#endif
+#ifdef ASYNC_WIFI_ENABLE_OTA
+        if (mUpdateUser[0] == '\0')
+        {
+            LOG("No update credentials, /update is disabled");
+        }
+        else
+        {
+#ifdef ASYNC_WIFI_USE_ASYNC_WEBSERVER
+            mServer->on("/update", HTTP_POST, [](AsyncWebServerRequest *request)
+                        { handleRequest(request, updateHandler); },
+                        [](AsyncWebServerRequest *request, const String &filename, size_t index, uint8_t *data, size_t length, bool final)
+                        {
+                            PORTAL_LOCK();
+                            mRequest = request;
+                            if (authenticateUpdate())
+                            {
+                                if (index == 0)
+                                {
+                                    beginUpdate(request->contentLength());
+                                }
+                                writeUpdate(data, length);
+                                if (final)
+                                {
+                                    endUpdate(true);
+                                }
+                            }
+                            mRequest = nullptr;
+                            PORTAL_UNLOCK();
+                        });
+#else
+            mServer->on("/update", HTTP_POST, updateHandler, updateUploadHandler);
+#endif
+        }
+#endif
+        for (size_t i = 0; i < sizeof(CAPTIVE_PORTAL_URLS) / sizeof(CAPTIVE_PORTAL_URLS[0]); i++)
+        {
+            addRoute(CAPTIVE_PORTAL_URLS[i], captivePortalHandler);
+        }
+        mServer->begin();
+    }
+}
+
+void AsyncWiFiManager::stopServer()
+{
+    if (mServer)
+    {
+        LOG("Stop server");
+#ifdef ASYNC_WIFI_USE_ASYNC_WEBSERVER
+        mServer->end();
+#else
+        mServer->stop();
+#endif
+        delete mServer;
+        mServer = nullptr;
+        // A save that was not applied yet is dropped with the portal
+        mIsSavePending = false;
+        delete[] mPendingParameters;
+        mPendingParameters = nullptr;
+    }
+}
+
+// Answer every DNS query with the AP address so that clients find the config portal by any host name
+void AsyncWiFiManager::startCaptiveDnsServer()
+{
+    if (!mCaptiveDnsServer)
+    {
+        LOG("Start DNS server");
+        mCaptiveDnsServer = new DNSServer();
+        mCaptiveDnsServer->setErrorReplyCode(DNSReplyCode::NoError);
+        mCaptiveDnsServer->start(DNS_PORT, "*", AP_IP_ADDR);
+    }
+}
+
+void AsyncWiFiManager::stopCaptiveDnsServer()
+{
+    if (mCaptiveDnsServer)
+    {
+        LOG("Stop DNS server");
+        mCaptiveDnsServer->stop();
+        delete mCaptiveDnsServer;
+        mCaptiveDnsServer = nullptr;
+    }
+}
+#endif
+
+#ifndef ASYNC_WIFI_DISABLE_MDNS
+void AsyncWiFiManager::startMDNS()
+{
+    if (!mStartedmDNS && mMDnsServerName[0] != '\0' && MDNS.begin(mMDnsServerName))
+    {
+        mStartedmDNS = true;
+#ifdef ESP8266
+        MDNS.addService("http", "tcp", 80);
+#endif
+        LOG("mDNS responder started at http://%s.local", mMDnsServerName);
+    }
+}
+
+void AsyncWiFiManager::stopMDNS()
+{
+    if (mStartedmDNS)
+    {
+        mStartedmDNS = false;
+        LOG("Stop mDNS responder");
+        MDNS.end();
+    }
+}
+#endif
+
+void AsyncWiFiManager::startConnectToSavedWifi()
+{
+    if (mState != ASYNC_WIFI_STATE_NONE)
+    {
+        LOGE("Cannot connnect to saved wifi");
+        return;
+    }
+    setState(ASYNC_WIFI_STATE_CONNECTING);
+    WiFi.mode(WIFI_STA);
+    // Reconnections are scheduled by the library with a backoff delay
+    WiFi.setAutoReconnect(false);
+    mConnectStartTime = millis();
+    memset(mFailureCount, 0, sizeof(mFailureCount));
+    startNetworkSelection();
+    if (WiFi.isConnected())
+    {
+        // Connected before the events were registered, e.g. by the SDK auto connect
+        pushEvent(ASYNC_WIFI_EVENT_GOT_IP, 0);
+    }
+#ifndef ASYNC_WIFI_DISABLE_MDNS
+    startMDNS();
+#endif
+}
+
+// With several saved networks, scan once then try them from the best candidate down.
+// A single network is joined directly
+void AsyncWiFiManager::startNetworkSelection()
+{
+    mCandidateCount = 0;
+    mIsReconnectScheduled = false;
+    if (mNetworkCount < 2 || WiFi.isConnected())
+    {
+        startConnectAttempt(mSavedChannel > 0);
+        return;
+    }
+    mSelectionTime = millis();
+#ifndef ASYNC_WIFI_DISABLE_SCAN
+    // Continued by onScanDone()
+    mIsSelectingNetwork = true;
+    startScanNetworks();
+    if (mIsScanning)
+    {
+        return;
+    }
+    mIsSelectingNetwork = false;
+#endif
+    connectRankedNetworks();
+}
+
+// Networks seen in the last scan come first, ordered by signal with a bonus for the recently used ones.
+// The others follow by recency, they may be hidden or out of range
+void AsyncWiFiManager::connectRankedNetworks()
+{
+    mCandidateCount = 0;
+    mCandidateIndex = 0;
+    for (uint8_t i = 0; i < mNetworkCount; i++)
+    {
+        const SavedNetwork &network = mNetworks[i];
+        NetworkCandidate candidate;
+        uint8_t recency = 0;
+        for (uint8_t j = 0; j < mNetworkCount; j++)
+        {
+            if (mNetworks[j].lastUsed < network.lastUsed)
+            {
+                recency++;
+            }
+        }
+        candidate.network = i;
+        candidate.score = INT16_MIN + recency;
+        memcpy(candidate.bssid, network.bssid, sizeof(candidate.bssid));
+        candidate.channel = network.channel;
+#ifndef ASYNC_WIFI_DISABLE_SCAN
+        for (uint8_t j = 0; j < mScanResultCount; j++)
+        {
+            const AsyncWiFiScanResult &result = mScanResults[j];
+            if (strcmp(result.ssid, network.ssid) == 0)
+            {
+                // Join the strongest access point of the network without another scan
+                candidate.score = result.rssi + recency * NETWORK_RECENCY_BONUS;
+                memcpy(candidate.bssid, result.bssid, sizeof(candidate.bssid));
+                candidate.channel = result.channel;
+                break;
+            }
+        }
+#endif
+        uint8_t pos = mCandidateCount++;
+        while (pos > 0 && mCandidates[pos - 1].score < candidate.score)
+        {
+            mCandidates[pos] = mCandidates[pos - 1];
+            pos--;
+        }
+        mCandidates[pos] = candidate;
+    }
+    if (!connectNextCandidate())
+    {
+        startConnectAttempt(mSavedChannel > 0);
+    }
+}
+
+// The ranked networks are tried until one works or the connect timeout is over
+bool AsyncWiFiManager::connectNextCandidate()
+{
+    if (mCandidateIndex >= mCandidateCount || (unsigned long)(millis() - mSelectionTime) > mConnectWifiTimeout)
+    {
+        mCandidateCount = 0;
+        return false;
+    }
+    const NetworkCandidate &candidate = mCandidates[mCandidateIndex++];
+    useNetwork(candidate.network);
+    memcpy(mSavedBSSID, candidate.bssid, sizeof(mSavedBSSID));
+    mSavedChannel = candidate.channel;
+    startConnectAttempt(mSavedChannel > 0);
+    return true;
+}
+
+// A fast attempt joins the access point of the last connection directly, skipping the scan of all channels
+void AsyncWiFiManager::startConnectAttempt(bool fast)
+{
+    mIsFastConnect = fast;
+    mIsAttemptActive = true;
+    mIsAssociated = false;
+    mIsReconnectScheduled = false;
+    mAttemptTime = millis();
+    METRICS(mMetrics.connectAttempts++);
+    if (mConnectStats.bootToBeginTime == 0)
+    {
+        mConnectStats.bootToBeginTime = mAttemptTime;
+        LOG("First connection %lums after boot", mAttemptTime);
+    }
+    if (fast)
+    {
+        WiFi.begin(mSavedSSID, mSavedPassword, mSavedChannel, mSavedBSSID);
+        LOG("Connecting to %s (channel %d)", mSavedSSID, mSavedChannel);
+    }
+    else
+    {
+        WiFi.begin(mSavedSSID, mSavedPassword);
+        LOG("Connecting to %s", mSavedSSID);
+    }
+}
+
+void AsyncWiFiManager::onConnectFailed(uint8_t failure, uint8_t reason)
+{
+    METRICS(mMetrics.failures[failure]++);
+    mIsAttemptActive = false;
+#ifndef ASYNC_WIFI_DISABLE_SCAN
+    if (mIsRoaming)
+    {
+        // The stronger access point was not joined, the connection is lost after all
+        mIsRoaming = false;
+#ifdef ASYNC_WIFI_ENABLE_METRICS
+        mMetrics.disconnects++;
+        mMetrics.lastDisconnectReason = reason;
+#endif
+        setState(ASYNC_WIFI_STATE_CONNECTING);
+    }
+#endif
+    WiFi.disconnect();
+#ifndef ASYNC_WIFI_DISABLE_PERSISTENCE
+    // The cached network did not work, the other saved networks may be needed
+    loadSettings();
+#endif
+    if (mCandidateCount > 0)
+    {
+        // Try the next saved network before waiting
+        if (connectNextCandidate())
+        {
+            return;
+        }
+    }
+    else if (mIsFastConnect && failure != ASYNC_WIFI_FAILURE_WRONG_PASSWORD)
+    {
+        // The cached access point did not answer, it may have moved to another channel
+        LOG("Fast connect failed, scanning all channels");
+        mConnectStats.fastConnectFallbackCount++;
+        startConnectAttempt(false);
+        return;
+    }
+    mIsFastConnect = false;
+
+    unsigned long delay = getReconnectDelay(failure);
+    mReconnectTime = millis() + delay;
+    mIsReconnectScheduled = true;
+
+    AsyncWiFiReconnectAttempt &attempt = mReconnectHistory[mReconnectHistoryHead];
+    attempt.time = millis();
+    attempt.failure = failure;
+    attempt.reason = reason;
+    attempt.delay = delay;
+    mReconnectHistoryHead = (mReconnectHistoryHead + 1) % RECONNECT_HISTORY_SIZE;
+    if (mReconnectHistoryCount < RECONNECT_HISTORY_SIZE)
+    {
+        mReconnectHistoryCount++;
+    }
+    LOG("Connect failed: %s, retry in %lums", getFailureStr(failure), delay);
+}
+
+// Exponential backoff per failure class, reduced by a random jitter so that devices do not retry in lockstep
+unsigned long AsyncWiFiManager::getReconnectDelay(uint8_t failure)
+{
+    uint8_t count = mFailureCount[failure];
+    if (count < 255)
+    {
+        mFailureCount[failure]++;
+    }
+    unsigned long delay = mReconnectPolicy.baseDelay[failure];
+    for (uint8_t i = 0; i < count && delay < mReconnectPolicy.maxDelay; i++)
+    {
+        delay *= 2;
+    }
+    delay = min(delay, mReconnectPolicy.maxDelay);
+    return delay - random(delay * mReconnectPolicy.jitterPercent / 100 + 1);
+}
+
+uint8_t AsyncWiFiManager::classifyFailure(uint8_t reason, bool wasConnected)
+{
+    switch (reason)
+    {
+    case REASON_AUTH_FAIL:
+    case REASON_4WAY_HANDSHAKE_TIMEOUT:
+    case REASON_HANDSHAKE_TIMEOUT:
+        return ASYNC_WIFI_FAILURE_WRONG_PASSWORD;
+    case REASON_NO_AP_FOUND:
+        return ASYNC_WIFI_FAILURE_AP_NOT_FOUND;
+    default:
+        return wasConnected ? ASYNC_WIFI_FAILURE_CONNECTION_LOST : ASYNC_WIFI_FAILURE_ASSOCIATION;
+    }
+}
+
+#ifndef ASYNC_WIFI_DISABLE_HEALTH
+// The callbacks of the probes and their connection, declared here with the lwIP types
+struct AsyncWiFiManager::Probe
+{
+    static struct tcp_pcb *mPcb;
+    static uint32_t mTag; // Callback argument of mPcb, sequence number << 1 | HTTP
+
+    static void start(void *arg);
+    static void connect(uint32_t tag, const ip_addr_t *address, uint16_t port);
+    static void abort(void *arg);
+    static void setStatus(uint32_t tag, uint8_t status);
+    static err_t finish(struct tcp_pcb *pcb, uint32_t tag, uint8_t status);
+    static void onResolved(const char *name, const ip_addr_t *address, void *arg);
+    static err_t onConnected(void *arg, struct tcp_pcb *pcb, err_t err);
+    static err_t onReceive(void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t err);
+    static void onError(void *arg, err_t err);
+};
+
+struct tcp_pcb *AsyncWiFiManager::Probe::mPcb = nullptr;
+uint32_t AsyncWiFiManager::Probe::mTag = 0;
+
+// Probe the gateway, then the endpoint, every probeInterval. Nothing blocks, the lwIP callbacks report the results
+void AsyncWiFiManager::processHealth()
+{
+    unsigned long now = millis();
+    if (mHealthProbe == HEALTH_PROBE_NONE)
+    {
+        if ((unsigned long)(now - mHealthProbeTime) >= mHealthPolicy.probeInterval)
+        {
+            mHealthProbeTime = now;
+            startProbe(HEALTH_PROBE_GATEWAY);
+        }
+        return;
+    }
+
+    uint8_t probe = mHealthProbe;
+    uint32_t result = mProbeResult;
+    uint8_t status = (result >> 8) == mProbeSequence ? (result & 0xFF) : PROBE_PENDING;
+    if (status == PROBE_PENDING)
+    {
+        if ((unsigned long)(now - mProbeStartTime) <= mHealthPolicy.probeTimeout)
+        {
+            return;
+        }
+        stopProbe();
+        status = PROBE_FAILED;
+    }
+    mHealthProbe = HEALTH_PROBE_NONE;
+    bool success = status == PROBE_SUCCEEDED;
+    if (probe == HEALTH_PROBE_GATEWAY && success)
+    {
+        // Exponential moving average, in 1/8 ms
+        int32_t latency = (mProbeEndTime - mProbeStartTime) * 8;
+        mHealthLatency = mHealthLatency == 0 ? latency : mHealthLatency + (latency - (int32_t)mHealthLatency) / HEALTH_SMOOTHING;
+        mHealthStats.latency = mHealthLatency / 8;
+        if (mHealthHost[0] != '\0')
+        {
+            startProbe(HEALTH_PROBE_ENDPOINT);
+            return;
+        }
+    }
+    else if (probe == HEALTH_PROBE_ENDPOINT)
+    {
+        mHealthStats.internet = success;
+    }
+    onHealthProbeDone(success);
+}
+
+void AsyncWiFiManager::onHealthProbeDone(bool success)
+{
+    mHealthStats.probeCount++;
+    mHealthLoss += ((success ? 0 : 10000) - (int32_t)mHealthLoss) / HEALTH_SMOOTHING;
+    mHealthStats.loss = mHealthLoss / 100;
+    if (success)
+    {
+        mHealthStats.failureCount = 0;
+        if (mState == ASYNC_WIFI_STATE_DEGRADED)
+        {
+            LOG("Connection recovered");
+            setState(ASYNC_WIFI_STATE_CONNECTED);
+        }
+        return;
+    }
+
+    if (mHealthStats.failureCount < UINT8_MAX)
+    {
+        mHealthStats.failureCount++;
+    }
+    LOGD("Health probe failed (%d)", mHealthStats.failureCount);
+    if (mHealthPolicy.reconnectFailures && mHealthStats.failureCount >= mHealthPolicy.reconnectFailures)
+    {
+        // Handled like a lost connection, with the reconnect policy
+        LOG("Connection not usable, reconnect");
+        mHealthStats.reconnectCount++;
+        mHealthStats.failureCount = 0;
+        WiFi.disconnect();
+    }
+    else if (mState == ASYNC_WIFI_STATE_CONNECTED && mHealthStats.failureCount >= mHealthPolicy.degradedFailures)
+    {
+        LOG("Connection degraded");
+        setState(ASYNC_WIFI_STATE_DEGRADED);
+    }
+}
+
+void AsyncWiFiManager::startProbe(uint8_t probe)
+{
+    mHealthProbe = probe;
+    mProbeSequence++;
+    mProbeStartTime = millis();
+    if (probe == HEALTH_PROBE_GATEWAY)
+    {
+        mProbeGateway = WiFi.gatewayIP();
+    }
+    runInTcpip(Probe::start);
+}
+
+void AsyncWiFiManager::stopProbe()
+{
+    mHealthProbe = HEALTH_PROBE_NONE;
+    runInTcpip(Probe::abort);
+}
+
+// The raw lwIP API is not thread safe, on ESP32 it must be called from the lwIP task
+void AsyncWiFiManager::runInTcpip(void (*function)(void *))
+{
+#ifdef ESP8266
+    function(nullptr);
+#else
+    if (tcpip_callback(function, nullptr) != ERR_OK)
+    {
+        Probe::setStatus(mProbeSequence << 1, PROBE_FAILED);
+    }
+#endif
+}
+
+// The functions below run in the lwIP task on ESP32
+
+void AsyncWiFiManager::Probe::start(void *arg)
+{
+    uint32_t tag = mProbeSequence << 1 | (mHealthProbe == HEALTH_PROBE_ENDPOINT);
+    if (!(tag & 1))
+    {
+        ip_addr_t gateway = IPADDR4_INIT(mProbeGateway);
+        connect(tag, &gateway, mHealthPolicy.gatewayPort);
+        return;
+    }
+    // Answered at once for an IP address or a cached name, otherwise by onResolved()
+    ip_addr_t address;
+    err_t err = dns_gethostbyname(mHealthHost, &address, onResolved, (void *)(uintptr_t)tag);
+    if (err == ERR_OK)
+    {
+        connect(tag, &address, mHealthPort);
+    }
+    else if (err != ERR_INPROGRESS)
+    {
+        setStatus(tag, PROBE_FAILED);
+    }
+}
+
+void AsyncWiFiManager::Probe::onResolved(const char *name, const ip_addr_t *address, void *arg)
+{
+    uint32_t tag = (uintptr_t)arg;
+    if (!address)
+    {
+        setStatus(tag, PROBE_FAILED);
+    }
+    else if ((uint16_t)(tag >> 1) == mProbeSequence)
+    {
+        connect(tag, address, mHealthPort);
+    }
+}
+
+void AsyncWiFiManager::Probe::connect(uint32_t tag, const ip_addr_t *address, uint16_t port)
+{
+    struct tcp_pcb *pcb = tcp_new();
+    if (!pcb)
+    {
+        setStatus(tag, PROBE_FAILED);
+        return;
+    }
+    if (mPcb)
+    {
+        abort(nullptr);
+    }
+    mPcb = pcb;
+    mTag = tag;
+    tcp_arg(pcb, (void *)(uintptr_t)tag);
+    tcp_err(pcb, onError);
+    tcp_recv(pcb, onReceive);
+    if (tcp_connect(pcb, address, port, onConnected) != ERR_OK)
+    {
+        finish(pcb, tag, PROBE_FAILED);
+    }
+}
+
+void AsyncWiFiManager::Probe::abort(void *arg)
+{
+    if (mPcb)
+    {
+        tcp_arg(mPcb, nullptr);
+        tcp_err(mPcb, nullptr);
+        tcp_recv(mPcb, nullptr);
+        tcp_abort(mPcb);
+        mPcb = nullptr;
+    }
+}
+
+void AsyncWiFiManager::Probe::setStatus(uint32_t tag, uint8_t status)
+{
+    mProbeEndTime = millis();
+    mProbeResult = (tag >> 1) << 8 | status;
+}
+
+// Report the result of a probe and close its connection. Returns ERR_ABRT when the connection had to be aborted
+err_t AsyncWiFiManager::Probe::finish(struct tcp_pcb *pcb, uint32_t tag, uint8_t status)
+{
+    setStatus(tag, status);
+    if (pcb == mPcb)
+    {
+        mPcb = nullptr;
+    }
+    tcp_arg(pcb, nullptr);
+    tcp_err(pcb, nullptr);
+    tcp_recv(pcb, nullptr);
+    if (tcp_close(pcb) != ERR_OK)
+    {
+        tcp_abort(pcb);
+        return ERR_ABRT;
+    }
+    return ERR_OK;
+}
+
+err_t AsyncWiFiManager::Probe::onConnected(void *arg, struct tcp_pcb *pcb, err_t err)
+{
+    uint32_t tag = (uintptr_t)arg;
+    if (!(tag & 1))
+    {
+        return finish(pcb, tag, PROBE_SUCCEEDED);
+    }
+    char request[HEALTH_HOST_MAX_LENGTH + HEALTH_PATH_MAX_LENGTH + 48];
+    int length = snprintf(request, sizeof(request), "GET %s HTTP/1.1\r\nHost: %s\r\nConnection: close\r\n\r\n", mHealthPath, mHealthHost);
+    if (tcp_write(pcb, request, length, TCP_WRITE_FLAG_COPY) != ERR_OK || tcp_output(pcb) != ERR_OK)
+    {
+        return finish(pcb, tag, PROBE_FAILED);
+    }
+    return ERR_OK;
+}
+
+// Only the status line of the answer is read
+err_t AsyncWiFiManager::Probe::onReceive(void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t err)
+{
+    uint32_t tag = (uintptr_t)arg;
+    if (!p)
+    {
+        // Closed before an answer
+        return finish(pcb, tag, PROBE_FAILED);
+    }
+    char line[12]; // "HTTP/1.1 204"
+    uint16_t length = pbuf_copy_partial(p, line, sizeof(line), 0);
+    tcp_recved(pcb, p->tot_len);
+    pbuf_free(p);
+    bool success = length == sizeof(line) && strncmp(line, "HTTP/1.", 7) == 0 && (line[9] == '2' || line[9] == '3');
+    return finish(pcb, tag, success ? PROBE_SUCCEEDED : PROBE_FAILED);
+}
+
+// The connection is already freed by lwIP
+void AsyncWiFiManager::Probe::onError(void *arg, err_t err)
+{
+    uint32_t tag = (uintptr_t)arg;
+    if (tag == mTag)
+    {
+        mPcb = nullptr;
+    }
+    // A refused connection also proves that the gateway is reachable
+    setStatus(tag, err == ERR_RST && !(tag & 1) ? PROBE_SUCCEEDED : PROBE_FAILED);
+}
+#endif
+
+
+#ifndef ASYNC_WIFI_DISABLE_CONFIG_PORTAL
+// Connect with the settings saved in the config portal while the AP keeps running, so the result can be shown in the browser
+void AsyncWiFiManager::startHotApply()
+{
+    LOG("Apply WiFi settings: %s", mPendingSSID);
+#ifndef ASYNC_WIFI_DISABLE_SCAN
+    stopScanNetworks();
+#endif
+    mApplyStatus = ASYNC_WIFI_APPLY_CONNECTING;
+    mApplyTime = millis();
+    // The config portal must not time out while the settings are tried
+    mStateTimeout = 0;
+    mIsFastConnect = false;
+    mConnectStartTime = millis();
+    mAttemptTime = millis();
+    METRICS(mMetrics.connectAttempts++);
+    WiFi.mode(WIFI_AP_STA);
+    WiFi.setAutoReconnect(false);
+#ifndef ASYNC_WIFI_DISABLE_SCAN
+    // Join the access point found by the scan directly, with the AP already on its channel
+    for (uint8_t i = 0; i < mScanResultCount; i++)
+    {
+        const AsyncWiFiScanResult &network = mScanResults[i];
+        if (strcmp(network.ssid, mPendingSSID) == 0)
+        {
+            moveAP(network.channel);
+            WiFi.begin(mPendingSSID, mPendingPassword, network.channel, network.bssid);
+            return;
+        }
+    }
+#endif
+    WiFi.begin(mPendingSSID, mPendingPassword);
+}
+
+void AsyncWiFiManager::onHotApplySucceeded()
+{
+    LOG("WiFi settings applied, IP address: %s", WiFi.localIP().toString().c_str());
+    mApplyStatus = ASYNC_WIFI_APPLY_CONNECTED;
+    mApplyTime = millis();
+    usePendingSettings();
+    mIsSavePending = false;
+    // Saves the settings together with the access point
+    onConnected();
+}
+
+// The submitted network becomes the current one
+void AsyncWiFiManager::usePendingSettings()
+{
+    strlcpy(mSavedSSID, mPendingSSID, sizeof(mSavedSSID));
+    strlcpy(mSavedPassword, mPendingPassword, sizeof(mSavedPassword));
+    mSavedChannel = 0;
+}
+
+// The settings are only used once they work, so the previous ones are kept in RAM and in the settings file
+void AsyncWiFiManager::onHotApplyFailed(uint8_t failure)
+{
+    LOG("Failed to apply WiFi settings: %s", getFailureStr(failure));
+    METRICS(mMetrics.failures[failure]++);
+    mApplyStatus = ASYNC_WIFI_APPLY_FAILED;
+    mApplyFailure = failure;
+    mIsSavePending = false;
+    mConnectStartTime = 0;
+    WiFi.disconnect();
+    WiFi.mode(WIFI_AP);
+    mStateTime = millis();
+    mStateTimeout = getStateTimeout(mState);
+}
+
+void AsyncWiFiManager::finishHotApply()
+{
+    LOG("Close config portal");
+    mApplyStatus = ASYNC_WIFI_APPLY_IDLE;
+    WiFi.softAPdisconnect(true);
+    WiFi.mode(WIFI_STA);
+    stopCaptiveDnsServer();
+    stopServer();
+#ifndef ASYNC_WIFI_DISABLE_SCAN
+    stopScanNetworks();
+#endif
+    setState(ASYNC_WIFI_STATE_CONNECTED);
+    if (!WiFi.isConnected())
+    {
+        // Lost after the settings were applied, reconnect as usual
+        pushEvent(ASYNC_WIFI_EVENT_DISCONNECTED, 0);
+    }
+}
+#endif
+
+void AsyncWiFiManager::onConnected()
+{
+    if (mConnectStartTime)
+    {
+        unsigned long duration = millis() - mConnectStartTime;
+        mConnectStartTime = 0;
+        mConnectStats.lastConnectFast = mIsFastConnect;
+        if (mIsFastConnect)
+        {
+            mConnectStats.fastConnectCount++;
+            mConnectStats.fastConnectTime = duration;
+        }
+        else
+        {
+            mConnectStats.normalConnectCount++;
+            mConnectStats.normalConnectTime = duration;
+        }
+        LOG("Connected in %lums", duration);
+    }
+#ifdef ASYNC_WIFI_ENABLE_METRICS
+    mMetrics.connectSuccesses++;
+    mMetrics.lastConnectDuration = millis() - mAttemptTime;
+    mMetrics.totalConnectDuration += mMetrics.lastConnectDuration;
+#endif
+    mIsFastConnect = false;
+    mIsAttemptActive = false;
+    mIsReconnectScheduled = false;
+    mCandidateCount = 0;
+#ifndef ASYNC_WIFI_DISABLE_SCAN
+    mIsSelectingNetwork = false;
+#endif
+    memset(mFailureCount, 0, sizeof(mFailureCount));
+#ifndef ASYNC_WIFI_DISABLE_HEALTH
+    mHealthStats.failureCount = 0;
+    mHealthProbeTime = millis();
+#endif
+
+    // Remember the access point for the next connection, and the network as the most recently used one
+    uint8_t *bssid = WiFi.BSSID();
+    if (bssid)
+    {
+        memcpy(mSavedBSSID, bssid, sizeof(mSavedBSSID));
+        mSavedChannel = WiFi.channel();
+    }
+#ifndef ASYNC_WIFI_DISABLE_SCAN
+    mRoamRssi = 0;
+    mRoamSampleTime = millis();
+    if (mIsRoaming)
+    {
+        // Not saved, frequent roams would wear the flash
+        mIsRoaming = false;
+        return;
+    }
+    mRoamChannels = 0;
+#endif
+#ifndef ASYNC_WIFI_DISABLE_PERSISTENCE
+    SavedNetwork cached;
+    if (!mIsSettingsLoaded && readRtcCache(cached) && cached.channel == mSavedChannel &&
+        memcmp(cached.bssid, mSavedBSSID, sizeof(mSavedBSSID)) == 0)
+    {
+        // Warm boot on the cached access point, the saved networks are unchanged
+        return;
+    }
+    loadSettings();
+#endif
+    if (storeNetwork(mSavedSSID, mSavedPassword, mSavedBSSID, mSavedChannel))
+    {
+        saveSettings();
+    }
+#ifndef ASYNC_WIFI_DISABLE_PERSISTENCE
+    updateRtcCache();
+#endif
+}
+
+void AsyncWiFiManager::stopConnectToSavedWifi()
+{
+    if (mState != ASYNC_WIFI_STATE_CONNECTING)
+    {
+        return;
+    }
+    LOG("Stop connect to saved Wifi");
+    mIsAttemptActive = false;
+    mIsReconnectScheduled = false;
+    mIsFastConnect = false;
+    mCandidateCount = 0;
+#ifndef ASYNC_WIFI_DISABLE_SCAN
+    mIsSelectingNetwork = false;
+    mIsRoaming = false;
+#endif
+    setState(ASYNC_WIFI_STATE_NONE);
+    WiFi.disconnect(true);
+#ifndef ASYNC_WIFI_DISABLE_CONFIG_PORTAL
+    stopServer();
+#endif
+    // stopMDNS();
+}
+
+#ifndef ASYNC_WIFI_DISABLE_CONFIG_PORTAL
+#ifdef ASYNC_WIFI_USE_ASYNC_WEBSERVER
+// Handlers run in the context of the async TCP stack, under the portal lock. The request being handled is kept in mRequest,
+// so the same handlers serve both server backends
+void AsyncWiFiManager::handleRequest(AsyncWebServerRequest *request, void (*handler)())
+{
+    PORTAL_LOCK();
+    mRequest = request;
+    handler();
+    mRequest = nullptr;
+    mResponseStream = nullptr;
+    PORTAL_UNLOCK();
+}
+#endif
+
+void AsyncWiFiManager::addRoute(const char *uri, void (*handler)())
+{
+#ifdef ASYNC_WIFI_USE_ASYNC_WEBSERVER
+    mServer->on(uri, HTTP_ANY, [handler](AsyncWebServerRequest *request)
+                { handleRequest(request, handler); });
+#else
+    mServer->on(uri, handler);
+#endif
+}
+
+// Start a streamed 200 response, the content is sent with sendContent() and ended with endResponse()
+void AsyncWiFiManager::beginResponse(const char *contentType)
+{
+#ifdef ASYNC_WIFI_USE_ASYNC_WEBSERVER
+    mResponseStream = mRequest->beginResponseStream(contentType);
+    mResponseStream->addHeader(F("Cache-Control"), F("no-store"));
+#else
+    mServer->sendHeader(F("Cache-Control"), F("no-store"));
+    mServer->setContentLength(CONTENT_LENGTH_UNKNOWN);
+    mServer->send(200, contentType, "");
+#endif
+}
+
+void AsyncWiFiManager::sendContent(const char *content, size_t length)
+{
+#ifdef ASYNC_WIFI_USE_ASYNC_WEBSERVER
+    mResponseStream->write((const uint8_t *)content, length);
+#else
+    mServer->sendContent(content, length);
+#endif
+    METRICS(mMetrics.bytesServed += length);
+}
+
+void AsyncWiFiManager::sendContent_P(PGM_P content)
+{
+#ifdef ASYNC_WIFI_USE_ASYNC_WEBSERVER
+    mResponseStream->print(FPSTR(content));
+#else
+    mServer->sendContent_P(content);
+#endif
+    METRICS(mMetrics.bytesServed += strlen_P(content));
+}
+
+void AsyncWiFiManager::endResponse()
+{
+#ifdef ASYNC_WIFI_USE_ASYNC_WEBSERVER
+    mRequest->send(mResponseStream);
+    mResponseStream = nullptr;
+#else
+    mServer->sendContent("");
+#endif
+}
+
+void AsyncWiFiManager::sendResponse(int code, const char *contentType, const char *content)
+{
+#ifdef ASYNC_WIFI_USE_ASYNC_WEBSERVER
+    mRequest->send(code, contentType, content);
+#else
+    mServer->send(code, contentType, content);
+#endif
+    METRICS(mMetrics.bytesServed += strlen(content));
+}
+
+void AsyncWiFiManager::sendRedirect(const char *url)
+{
+#ifdef ASYNC_WIFI_USE_ASYNC_WEBSERVER
+    mRequest->redirect(url);
+#else
+    mServer->sendHeader(F("Location"), url, true);
+    mServer->send(302, "text/plain", "");
+#endif
+}
+
+bool AsyncWiFiManager::hasArg(const char *name)
+{
+#ifdef ASYNC_WIFI_USE_ASYNC_WEBSERVER
+    return mRequest->hasArg(name);
+#else
+    return mServer->hasArg(name);
+#endif
+}
+
+// Copy an argument to value like strlcpy() and return its length, or -1 if it is missing.
+// With the servers that return arguments by reference no String is copied
+int AsyncWiFiManager::readArg(const char *name, char *value, size_t size)
+{
+    if (!hasArg(name))
+    {
+        return -1;
+    }
+#ifdef ASYNC_WIFI_USE_ASYNC_WEBSERVER
+    const String &arg = mRequest->arg(name);
+#else
+    const String &arg = mServer->arg(name);
+#endif
+    return strlcpy(value, arg.c_str(), size);
+}
+
+String AsyncWiFiManager::getArg(const char *name)
+{
+#ifdef ASYNC_WIFI_USE_ASYNC_WEBSERVER
+    return mRequest->arg(name);
+#else
+    return mServer->arg(name);
+#endif
+}
+
+String AsyncWiFiManager::getHeader(const char *name)
+{
+#ifdef ASYNC_WIFI_USE_ASYNC_WEBSERVER
+    AsyncWebHeader *header = mRequest->getHeader(name);
+    return header ? header->value() : String();
+#else
+    return mServer->header(name);
+#endif
+}
+
+#ifdef DEBUG_HTTP_ARGUMENTS
+void AsyncWiFiManager::logRequest()
+{
+#ifdef ASYNC_WIFI_USE_ASYNC_WEBSERVER
+    AsyncWebServerRequest *request = mRequest;
+    String message = "URI: ";
+    message += request->url();
+#else
+    WebServerClass *request = mServer;
+    String message = "URI: ";
+    message += request->uri();
+#endif
+    message += "\nMethod: ";
+    message += (request->method() == HTTP_GET) ? "GET" : "POST";
+    message += "\nArguments: ";
+    message += request->args();
+    message += "\n";
+    for (uint8_t i = 0; i < request->args(); i++)
+    {
+        message += " " + request->argName(i) + ": " + request->arg(i) + "\n";
+    }
+    LOGD("Http: %s", message.c_str());
+}
+#endif
+
+void AsyncWiFiManager::sendNotFound()
+{
+    if (!mServer)
+    {
+        return;
+    }
+    sendResponse(404, "text/plain", "404 Not Found");
+}
+
+// Send a gzip compressed resource. If etag is set, the response can be cached and revalidated by the client
+void AsyncWiFiManager::sendGzipResource(const uint8_t *content, size_t length, const char *etag, const char *contentType)
+{
+    if (!mServer)
+    {
+        return;
+    }
+    mLastRequestTime = millis();
+    bool notModified = etag && strcmp_P(getHeader("If-None-Match").c_str(), etag) == 0;
+#ifdef ASYNC_WIFI_USE_ASYNC_WEBSERVER
+    if (notModified)
+    {
+        mRequest->send(304);
+        return;
+    }
+    AsyncWebServerResponse *response = mRequest->beginResponse_P(200, contentType, content, length);
+    response->addHeader(F("Content-Encoding"), F("gzip"));
+    if (etag)
+    {
+        response->addHeader(F("Cache-Control"), FPSTR(HTTP_CACHE_CONTROL));
+        response->addHeader(F("ETag"), FPSTR(etag));
+    }
+    mRequest->send(response);
+#else
+    if (etag)
+    {
+        mServer->sendHeader(F("Cache-Control"), FPSTR(HTTP_CACHE_CONTROL));
+        mServer->sendHeader(F("ETag"), FPSTR(etag));
+    }
+    if (notModified)
+    {
+        mServer->send(304);
+        return;
+    }
+    mServer->sendHeader(F("Content-Encoding"), F("gzip"));
+    mServer->send_P(200, contentType, (PGM_P)content, length);
+#endif
+    METRICS(mMetrics.bytesServed += length);
+}
+
+void AsyncWiFiManager::notFoundHandler()
+{
+    if (!mServer)
+    {
+        return;
+    }
+#ifdef DEBUG_HTTP_ARGUMENTS
+    logRequest();
+#endif
+    sendNotFound();
+}
+
+void AsyncWiFiManager::captivePortalHandler()
+{
+    if (!mServer)
+    {
+        return;
+    }
+    sendRedirect(AP_URL);
+}
+
+void AsyncWiFiManager::rootHandler()
+{
+    if (!mServer)
+    {
+        return;
+    }
+#ifdef DEBUG_HTTP_ARGUMENTS
+    logRequest();
+#endif
+
+    METRICS_REQUEST_BEGIN();
+    mLastRequestTime = millis();
+    // Stream the page as chunks so it never has to be assembled in the heap
+    beginResponse("text/html");
+    sendContent_P(HTML_CONFIG_WIFI_HEAD);
+    if (!sendScannedWifiList())
+    {
+        sendContent_P(HTML_NO_NETWORKS_FOUND);
+    }
+    sendContent_P(HTML_CONFIG_WIFI_FORM);
+    sendParameters();
+    sendContent_P(HTML_CONFIG_WIFI_TAIL);
+    endResponse();
+    METRICS_REQUEST_END(rootHandler);
+}
+
+void AsyncWiFiManager::scanHandler()
+{
+    if (!mServer)
+    {
+        return;
+    }
+    mLastRequestTime = millis();
+    beginResponse("application/json");
+    sendScannedWifiJson();
+    endResponse();
+}
+
+#ifdef ASYNC_WIFI_ENABLE_METRICS
+// Prometheus text exposition format
+void AsyncWiFiManager::metricsHandler()
+{
+    if (!mServer)
+    {
+        return;
+    }
+    AsyncWiFiMetrics metrics = getMetrics();
+    char buffer[SEND_BUFFER_SIZE];
+    char item[SEND_BUFFER_SIZE];
+    size_t length = 0;
+    int itemLength;
+
+    beginResponse("text/plain; version=0.0.4");
+
+    for (uint8_t i = 0; i < sizeof(metrics.stateTime) / sizeof(metrics.stateTime[0]); i++)
+    {
+        itemLength = snprintf_P(item, sizeof(item), PSTR("asyncwifi_state_time_ms{state=\"%s\"} %lu\n"), getStateName(i), metrics.stateTime[i]);
+        sendChunked(buffer, length, item, min(itemLength, (int)sizeof(item) - 1));
+    }
+    itemLength = snprintf_P(item, sizeof(item), PSTR("asyncwifi_connect_attempts_total %u\nasyncwifi_connect_successes_total %u\n"
+                                                     "asyncwifi_connect_duration_ms_last %lu\nasyncwifi_connect_duration_ms_total %lu\n"),
+                            metrics.connectAttempts, metrics.connectSuccesses, metrics.lastConnectDuration, metrics.totalConnectDuration);
+    sendChunked(buffer, length, item, min(itemLength, (int)sizeof(item) - 1));
+    itemLength = snprintf_P(item, sizeof(item), PSTR("asyncwifi_disconnects_total %u\nasyncwifi_disconnect_last_reason %u\n"),
+                            metrics.disconnects, metrics.lastDisconnectReason);
+    sendChunked(buffer, length, item, min(itemLength, (int)sizeof(item) - 1));
+    for (uint8_t i = 0; i < ASYNC_WIFI_FAILURE_COUNT; i++)
+    {
+        itemLength = snprintf_P(item, sizeof(item), PSTR("asyncwifi_connect_failures_total{class=\"%s\"} %u\n"), getFailureStr(i), metrics.failures[i]);
+        sendChunked(buffer, length, item, min(itemLength, (int)sizeof(item) - 1));
+    }
+    sendRequestMetrics(buffer, length, "root", metrics.rootHandler);
+    sendRequestMetrics(buffer, length, "save", metrics.saveDataHandler);
+    itemLength = snprintf_P(item, sizeof(item), PSTR("asyncwifi_bytes_served_total %u\nasyncwifi_heap_free_min_bytes %u\nasyncwifi_heap_max_block_min_bytes %u\n"),
+                            metrics.bytesServed, metrics.minFreeHeap, metrics.minMaxFreeBlock);
+    sendChunked(buffer, length, item, min(itemLength, (int)sizeof(item) - 1));
 
-void AsyncWiFiManager::printScannedNetWorks()
+    sendContent(buffer, length);
+    endResponse();
+}
+
+void AsyncWiFiManager::sendRequestMetrics(char *buffer, size_t &length, const char *handler, const AsyncWiFiRequestMetrics &request)
 {
-    uint8_t i = 0;
-    String ssid;
-    uint8_t encType;
-    int32_t rssi;
-    uint8_t *bssid;
-    int32_t channel;
-    bool hidden = false;
+    char item[SEND_BUFFER_SIZE];
+    int itemLength;
+    uint32_t count = 0;
+
+    // Histogram buckets are cumulative
+    for (uint8_t i = 0; i < METRICS_LATENCY_BUCKET_COUNT; i++)
+    {
+        count += request.latencyBuckets[i];
+        if (i < METRICS_LATENCY_BUCKET_COUNT - 1)
+        {
+            itemLength = snprintf_P(item, sizeof(item), PSTR("asyncwifi_request_duration_ms_bucket{handler=\"%s\",le=\"%lu\"} %u\n"), handler, METRICS_LATENCY_BOUNDS[i], count);
+        }
+        else
+        {
+            itemLength = snprintf_P(item, sizeof(item), PSTR("asyncwifi_request_duration_ms_bucket{handler=\"%s\",le=\"+Inf\"} %u\n"), handler, count);
+        }
+        sendChunked(buffer, length, item, min(itemLength, (int)sizeof(item) - 1));
+    }
+    itemLength = snprintf_P(item, sizeof(item), PSTR("asyncwifi_request_duration_ms_sum{handler=\"%s\"} %lu\nasyncwifi_request_duration_ms_count{handler=\"%s\"} %u\n"),
+                            handler, request.totalLatency, handler, request.requests);
+    sendChunked(buffer, length, item, min(itemLength, (int)sizeof(item) - 1));
+}
+
+void AsyncWiFiManager::recordRequest(AsyncWiFiRequestMetrics &request, unsigned long latency)
+{
+    uint8_t bucket = 0;
+    while (bucket < METRICS_LATENCY_BUCKET_COUNT - 1 && latency > METRICS_LATENCY_BOUNDS[bucket])
+    {
+        bucket++;
+    }
+    request.requests++;
+    request.latencyBuckets[bucket]++;
+    request.totalLatency += latency;
+}
+#endif
+
+void AsyncWiFiManager::styleHandler()
+{
+    sendGzipResource(STYLE_CSS_GZ, STYLE_CSS_GZ_LEN, STYLE_CSS_ETAG, "text/css");
+}
+
+void AsyncWiFiManager::scriptHandler()
+{
+    sendGzipResource(SCRIPT_JS_GZ, SCRIPT_JS_GZ_LEN, SCRIPT_JS_ETAG, "application/javascript");
+}
+
+// Polled by the success page to follow the new settings being applied
+void AsyncWiFiManager::statusHandler()
+{
+    static const char *const APPLY_STATUS_NAMES[] = {"idle", "connecting", "connected", "failed"};
+    char buffer[SEND_BUFFER_SIZE];
+    char item[SEND_BUFFER_SIZE];
+    size_t length = 0;
+
+    if (!mServer)
+    {
+        return;
+    }
+    mLastRequestTime = millis();
+    char ip[16] = "";
+    if (mApplyStatus == ASYNC_WIFI_APPLY_CONNECTED)
+    {
+        IPAddress address = WiFi.localIP();
+        snprintf(ip, sizeof(ip), "%u.%u.%u.%u", address[0], address[1], address[2], address[3]);
+    }
+    // What processHandler does with saved settings, so the page only promises a reboot when one follows
+    const char *mode = "restart";
+    if (mOnWiFiInformationChanged)
+    {
+        mode = "save";
+    }
+    else if (mIsHotApplyEnable && mState == ASYNC_WIFI_STATE_CONFIG_PORTAL)
+    {
+        mode = "apply";
+    }
+    beginResponse("application/json");
+    // Streamed around the SSID, which is up to 6 times longer once escaped
+    int itemLength = snprintf_P(item, sizeof(item), JSON_APPLY_STATUS, APPLY_STATUS_NAMES[mApplyStatus]);
+    sendChunked(buffer, length, item, min(itemLength, (int)sizeof(item) - 1));
+    sendEscapedJson(buffer, length, mPendingSSID);
+    itemLength = snprintf_P(item, sizeof(item), JSON_APPLY_STATUS_END, ip,
+                            mApplyStatus == ASYNC_WIFI_APPLY_FAILED ? getFailureStr(mApplyFailure) : "", mode);
+    sendChunked(buffer, length, item, min(itemLength, (int)sizeof(item) - 1));
+    sendContent(buffer, length);
+    endResponse();
+}
+
+void AsyncWiFiManager::saveDataHandler()
+{
+    if (!mServer)
+    {
+        return;
+    }
+    METRICS_REQUEST_BEGIN();
+    mLastRequestTime = millis();
+    if (mIsSavePending.load(std::memory_order_acquire))
+    {
+        sendResponse(200, "text/plain", "Settings are being applied. Please try again.");
+        METRICS_REQUEST_END(saveDataHandler);
+        return;
+    }
+    // Only copied here, they are applied from loop()
+    if (readArg("s", mPendingSSID, sizeof(mPendingSSID)) < 0)
+    {
+        strlcpy(mPendingSSID, mSavedSSID, sizeof(mPendingSSID));
+    }
+    if (readArg("p", mPendingPassword, sizeof(mPendingPassword)) < 0)
+    {
+        strlcpy(mPendingPassword, mSavedPassword, sizeof(mPendingPassword));
+    }
+    trim(mPendingSSID);
+    trim(mPendingPassword);
+    if (!parseParameters(mPendingParameters))
+    {
+        sendResponse(200, "text/plain", "Parameters are invalid. Please try again.");
+    }
+    else if (mPendingSSID[0] != '\0' && mPendingPassword[0] != '\0')
+    {
+        sendGzipResource(HTML_CONFIG_SUCCESS_GZ, HTML_CONFIG_SUCCESS_GZ_LEN, nullptr, "text/html");
+        mIsSavePending.store(true, std::memory_order_release);
+    }
+    else
+    {
+        sendResponse(200, "text/plain", "WiFi information is invalid. Please try again.");
+    }
+    METRICS_REQUEST_END(saveDataHandler);
+}
+
+#ifdef ASYNC_WIFI_ENABLE_OTA
+// Answer once the upload is complete, the device restarts from loop() after a successful update
+void AsyncWiFiManager::updateHandler()
+{
+    if (!mServer)
+    {
+        return;
+    }
+    mLastRequestTime = millis();
+    if (!authenticateUpdate())
+    {
+#ifdef ASYNC_WIFI_USE_ASYNC_WEBSERVER
+        mRequest->requestAuthentication();
+#else
+        mServer->requestAuthentication();
+#endif
+        return;
+    }
+    if (mUpdateStats.success)
+    {
+        sendResponse(200, "text/plain", "Update successful. Restarting...");
+        mIsRestartPending = true;
+    }
+    else
+    {
+        sendResponse(500, "text/plain", "Update failed.");
+    }
+}
+
+#ifndef ASYNC_WIFI_USE_ASYNC_WEBSERVER
+void AsyncWiFiManager::updateUploadHandler()
+{
+    if (!authenticateUpdate())
+    {
+        return;
+    }
+    HTTPUpload &upload = mServer->upload();
+    switch (upload.status)
+    {
+    case UPLOAD_FILE_START:
+        beginUpdate(mServer->clientContentLength());
+        break;
+    case UPLOAD_FILE_WRITE:
+        writeUpdate(upload.buf, upload.currentSize);
+        break;
+    case UPLOAD_FILE_END:
+        endUpdate(true);
+        break;
+    default:
+        endUpdate(false);
+        break;
+    }
+}
+#endif
+
+// Checked for each chunk, so nothing of an unauthenticated upload reaches the flash
+bool AsyncWiFiManager::authenticateUpdate()
+{
+#ifdef ASYNC_WIFI_USE_ASYNC_WEBSERVER
+    return mRequest->authenticate(mUpdateUser, mUpdatePassword);
+#else
+    return mServer->authenticate(mUpdateUser, mUpdatePassword);
+#endif
+}
+
+// The image is written to the flash chunk by chunk as it is received, it is never held in RAM
+void AsyncWiFiManager::beginUpdate(size_t total)
+{
+    if (Update.isRunning())
+    {
+        // The previous upload was interrupted
+        Update.end(false);
+    }
+    LOG("Update started");
+    mUpdateStats = {};
+    mUpdateTotal = total;
+    mUpdateStartTime = millis();
+    mUpdateChunkTime = mUpdateStartTime;
+    mLastRequestTime = mUpdateStartTime;
+    // The config portal must not time out during the upload
+    mStateTimeout = 0;
+
+    mIsUpdateSha256 = false;
+    bool isSha256 = hasArg("sha256");
+    if (isSha256 && !parseHex(getArg("sha256").c_str(), mUpdateSha256, sizeof(mUpdateSha256)))
+    {
+        LOGE("Invalid SHA-256");
+        return;
+    }
+#ifdef ESP8266
+#ifdef ASYNC_WIFI_USE_ASYNC_WEBSERVER
+    // Writes happen in the TCP callbacks, where yielding is not allowed
+    Update.runAsync(true);
+#endif
+    uint32_t size = (ESP.getFreeSketchSpace() - 0x1000) & 0xFFFFF000;
+#else
+    uint32_t size = UPDATE_SIZE_UNKNOWN;
+#endif
+    if (!Update.begin(size))
+    {
+        LOGE("Update begin failed: %u", Update.getError());
+        return;
+    }
+    // Checked by Update.end() on the data it has written
+    if (hasArg("md5") && !Update.setMD5(getArg("md5").c_str()))
+    {
+        LOGE("Invalid MD5");
+        Update.end(false);
+        return;
+    }
+    mIsUpdateSha256 = isSha256;
+    if (mIsUpdateSha256)
+    {
+#ifdef ESP8266
+        br_sha256_init(&mUpdateSha256Context);
+#else
+        mbedtls_sha256_init(&mUpdateSha256Context);
+        mbedtls_sha256_starts(&mUpdateSha256Context, 0);
+#endif
+    }
+}
+
+void AsyncWiFiManager::writeUpdate(uint8_t *data, size_t length)
+{
+    if (!Update.isRunning() || Update.hasError() || length == 0)
+    {
+        return;
+    }
+    if (Update.write(data, length) != length)
+    {
+        LOGE("Update write failed: %u", Update.getError());
+        Update.end(false);
+        return;
+    }
+    if (mIsUpdateSha256)
+    {
+#ifdef ESP8266
+        br_sha256_update(&mUpdateSha256Context, data, length);
+#else
+        mbedtls_sha256_update(&mUpdateSha256Context, data, length);
+#endif
+    }
+    mUpdateStats.size += length;
+    mUpdateStats.chunkCount++;
+    mUpdateStats.maxChunkSize = max(mUpdateStats.maxChunkSize, (uint16_t)length);
+    mUpdateChunkTime = millis();
+    mLastRequestTime = mUpdateChunkTime;
+    if (mOnUpdateProgress)
+    {
+        mOnUpdateProgress(mUpdateStats.size, mUpdateTotal);
+    }
+}
+
+// Verify and activate the new image, or drop it when the upload did not complete
+void AsyncWiFiManager::endUpdate(bool isComplete)
+{
+    bool success = isComplete && Update.isRunning() && !Update.hasError();
+    if (mIsUpdateSha256)
+    {
+        uint8_t sha256[sizeof(mUpdateSha256)];
+#ifdef ESP8266
+        br_sha256_out(&mUpdateSha256Context, sha256);
+#else
+        mbedtls_sha256_finish(&mUpdateSha256Context, sha256);
+        mbedtls_sha256_free(&mUpdateSha256Context);
+#endif
+        mIsUpdateSha256 = false;
+        if (success && memcmp(sha256, mUpdateSha256, sizeof(sha256)) != 0)
+        {
+            LOGE("SHA-256 mismatch");
+            success = false;
+        }
+    }
+    if (success)
+    {
+        // Also writes the last buffered bytes and checks the MD5
+        success = Update.end(true);
+    }
+    else if (Update.isRunning())
+    {
+        Update.end(false);
+    }
+
+    mUpdateStats.duration = millis() - mUpdateStartTime;
+    mUpdateStats.throughput = mUpdateStats.duration ? (uint64_t)mUpdateStats.size * 1000 / mUpdateStats.duration : 0;
+    mUpdateStats.success = success;
+    if (success)
+    {
+        LOG("Update done: %u bytes in %lums, %u bytes/s", mUpdateStats.size, mUpdateStats.duration, mUpdateStats.throughput);
+    }
+    else
+    {
+        LOGE("Update failed: %u", Update.getError());
+        mStateTime = millis();
+        mStateTimeout = getStateTimeout(mState);
+    }
+}
+
+bool AsyncWiFiManager::parseHex(const char *hex, uint8_t *data, size_t size)
+{
+    if (strlen(hex) != size * 2)
+    {
+        return false;
+    }
+    for (size_t i = 0; i < size * 2; i++)
+    {
+        char c = tolower(hex[i]);
+        uint8_t value;
+        if (c >= '0' && c <= '9')
+        {
+            value = c - '0';
+        }
+        else if (c >= 'a' && c <= 'f')
+        {
+            value = c - 'a' + 10;
+        }
+        else
+        {
+            return false;
+        }
+        data[i / 2] = (i % 2) ? (data[i / 2] | value) : (value << 4);
+    }
+    return true;
+}
+#endif
+#endif
 
-    int n = WiFi.scanComplete();
+void AsyncWiFiManager::registerWiFiEvents()
+{
+    static bool registered = false;
 
+    if (registered)
+    {
+        return;
+    }
+    registered = true;
 #ifdef ESP8266
-    while (i < n && WiFi.getNetworkInfo(i, ssid, encType, rssi, bssid, channel, hidden))
+    mConnectedHandler = WiFi.onStationModeConnected([](const WiFiEventStationModeConnected &event)
+                                                    { pushEvent(ASYNC_WIFI_EVENT_CONNECTED, 0); });
+    mGotIPHandler = WiFi.onStationModeGotIP([](const WiFiEventStationModeGotIP &event)
+                                            { pushEvent(ASYNC_WIFI_EVENT_GOT_IP, 0); });
+    mDisconnectedHandler = WiFi.onStationModeDisconnected([](const WiFiEventStationModeDisconnected &event)
+                                                          { pushEvent(ASYNC_WIFI_EVENT_DISCONNECTED, event.reason); });
 #else
-    while (i < n && WiFi.getNetworkInfo(i, ssid, encType, rssi, bssid, channel))
+    WiFi.onEvent(onWiFiEvent);
+#endif
+}
+
+#ifndef ESP8266
+// Called from the WiFi event task
+void AsyncWiFiManager::onWiFiEvent(arduino_event_id_t event, arduino_event_info_t info)
+{
+    switch (event)
+    {
+    case ARDUINO_EVENT_WIFI_STA_CONNECTED:
+        pushEvent(ASYNC_WIFI_EVENT_CONNECTED, 0);
+        break;
+    case ARDUINO_EVENT_WIFI_STA_GOT_IP:
+        pushEvent(ASYNC_WIFI_EVENT_GOT_IP, 0);
+        break;
+    case ARDUINO_EVENT_WIFI_STA_LOST_IP:
+        pushEvent(ASYNC_WIFI_EVENT_LOST_IP, 0);
+        break;
+    case ARDUINO_EVENT_WIFI_STA_DISCONNECTED:
+        pushEvent(ASYNC_WIFI_EVENT_DISCONNECTED, info.wifi_sta_disconnected.reason);
+        break;
+    case ARDUINO_EVENT_WIFI_SCAN_DONE:
+        pushEvent(ASYNC_WIFI_EVENT_SCAN_DONE, 0);
+        break;
+    default:
+        break;
+    }
+}
+#endif
+
+// Pushed by the WiFi event task and by the loop, consumed by the loop. A slot is reserved first, like a log message,
+// then marked ready. Once the queue is full, the events are merged until it is drained: the last link event wins,
+// as it tells the current state, and a scan done only has to be seen once
+void AsyncWiFiManager::pushEvent(uint8_t event, uint8_t reason)
+{
+    bool isOverflow = mOverflowEvent.load(std::memory_order_acquire) != 0 || mIsOverflowScanDone.load(std::memory_order_acquire);
+    uint8_t head = mEventHead.load(std::memory_order_relaxed);
+    uint8_t next;
+    while (!isOverflow)
+    {
+        next = (head + 1) % EVENT_QUEUE_SIZE;
+        if (next == mEventTail.load(std::memory_order_acquire))
+        {
+            isOverflow = true;
+        }
+        else if (mEventHead.compare_exchange_weak(head, next, std::memory_order_acq_rel, std::memory_order_relaxed))
+        {
+            break;
+        }
+    }
+
+    if (isOverflow)
+    {
+        mEventDropCount.fetch_add(1, std::memory_order_relaxed);
+        if (event == ASYNC_WIFI_EVENT_SCAN_DONE)
+        {
+            mIsOverflowScanDone.store(true, std::memory_order_release);
+        }
+        else
+        {
+            mOverflowEvent.store((uint16_t)(event << 8 | reason), std::memory_order_release);
+        }
+    }
+    else
+    {
+        QueuedEvent &entry = mEventQueue[head];
+        entry.event = event;
+        entry.reason = reason;
+        entry.ready.store(true, std::memory_order_release);
+    }
+#ifdef ASYNC_WIFI_ENABLE_TASK
+    if (mTaskHandle)
+    {
+        xTaskNotifyGive(mTaskHandle);
+    }
+#endif
+}
+
+// Stops at an event that is still being written, it is handled by the next call
+void AsyncWiFiManager::processEvents()
+{
+    uint8_t tail = mEventTail.load(std::memory_order_relaxed);
+    while (tail != mEventHead.load(std::memory_order_acquire))
+    {
+        QueuedEvent &entry = mEventQueue[tail];
+        if (!entry.ready.load(std::memory_order_acquire))
+        {
+            break;
+        }
+        uint8_t event = entry.event;
+        uint8_t reason = entry.reason;
+        entry.ready.store(false, std::memory_order_relaxed);
+        tail = (tail + 1) % EVENT_QUEUE_SIZE;
+        mEventTail.store(tail, std::memory_order_release);
+        handleEvent(event, reason);
+    }
+    if (tail != mEventHead.load(std::memory_order_acquire))
+    {
+        return;
+    }
+
+    // The merged events came after all the queued ones
+    uint32_t dropCount = mEventDropCount.load(std::memory_order_relaxed);
+    if (dropCount != mEventReportedDropCount)
+    {
+        LOGE("Event queue full, %lu events merged", (unsigned long)(dropCount - mEventReportedDropCount));
+        mEventReportedDropCount = dropCount;
+    }
+    uint16_t overflowEvent = mOverflowEvent.exchange(0, std::memory_order_acq_rel);
+    if (overflowEvent != 0)
+    {
+        handleEvent(overflowEvent >> 8, overflowEvent & 0xff);
+    }
+    if (mIsOverflowScanDone.exchange(false, std::memory_order_acq_rel))
+    {
+        handleEvent(ASYNC_WIFI_EVENT_SCAN_DONE, 0);
+    }
+}
+
+void AsyncWiFiManager::handleEvent(uint8_t event, uint8_t reason)
+{
+    if (event == ASYNC_WIFI_EVENT_SCAN_DONE)
+    {
+#ifndef ASYNC_WIFI_DISABLE_SCAN
+        onScanDone();
+#endif
+        return;
+    }
+    if (event == ASYNC_WIFI_EVENT_DISCONNECTED)
+    {
+        LOG("Disconnected, reason %d", reason);
+    }
+#ifndef ASYNC_WIFI_DISABLE_SCAN
+    if (mIsRoaming)
+    {
+        handleRoamEvent(event, reason);
+        return;
+    }
+#endif
+
+    for (size_t i = 0; i < sizeof(TRANSITIONS) / sizeof(TRANSITIONS[0]); i++)
+    {
+        if (TRANSITIONS[i].state == mState && TRANSITIONS[i].event == event)
+        {
+            setState(TRANSITIONS[i].nextState);
+            if (mState == ASYNC_WIFI_STATE_CONNECTED)
+            {
+                onConnected();
+#ifndef ASYNC_WIFI_DISABLE_SCAN
+                stopScanNetworks();
+#endif
+#ifndef ASYNC_WIFI_DISABLE_CONFIG_PORTAL
+                stopServer();
+#endif
+            }
+            else if (mState == ASYNC_WIFI_STATE_CONNECTING)
+            {
+#ifndef ASYNC_WIFI_DISABLE_SCAN
+                if (mIsRoamScan)
+                {
+                    stopScanNetworks();
+                }
 #endif
+#ifdef ASYNC_WIFI_ENABLE_METRICS
+                mMetrics.disconnects++;
+                mMetrics.lastDisconnectReason = reason;
+#endif
+                onConnectFailed(classifyFailure(reason, true), reason);
+            }
+            return;
+        }
+    }
+
+    // Progress of the current connection attempt. A disconnection requested by the library itself is not a failure
+#ifndef ASYNC_WIFI_DISABLE_CONFIG_PORTAL
+    if (mApplyStatus == ASYNC_WIFI_APPLY_CONNECTING)
     {
-        if (hidden)
+        if (event == ASYNC_WIFI_EVENT_CONNECTED)
+        {
+            // The STA joined another channel than expected
+            moveAP(WiFi.channel());
+        }
+        else if (event == ASYNC_WIFI_EVENT_GOT_IP)
         {
-            continue;
+            onHotApplySucceeded();
+        }
+        else if (event == ASYNC_WIFI_EVENT_DISCONNECTED && reason != REASON_ASSOC_LEAVE)
+        {
+            onHotApplyFailed(classifyFailure(reason, false));
         }
-        LOG("%2d. %-24s %4ddBm | %s", i + 1, ssid.c_str(), rssi, getEncryptionTypeStr(encType).c_str());
-        i++;
+        return;
     }
-}
-
-bool AsyncWiFiManager::getScannedWifiHtmlStr(String &str)
-{
-    int i = 0;
-    String ssid;
-    uint8_t encType;
-    int32_t rssi;
-    uint8_t *bssid;
-    int32_t channel;
-    bool hidden = false;
-    bool ret = false;
-
-    int n = WiFi.scanComplete();
-
-#ifdef ESP8266
-    while (i < n && WiFi.getNetworkInfo(i, ssid, encType, rssi, bssid, channel, hidden))
-#else
-    while (i < n && WiFi.getNetworkInfo(i, ssid, encType, rssi, bssid, channel))
 #endif
+    if (mState == ASYNC_WIFI_STATE_CONNECTING && mIsAttemptActive)
     {
-        if (hidden)
+        if (event == ASYNC_WIFI_EVENT_CONNECTED)
         {
-            continue;
+            mIsAssociated = true;
+            mAssociatedTime = millis();
         }
-        LOG("%2d. %-24s %4ddBm | %s", i + 1, ssid.c_str(), rssi, getEncryptionTypeStr(encType).c_str());
-
-        str += FPSTR(HTML_WIFI_ITEM1);
-        str += ssid;
-        str += FPSTR(HTML_WIFI_ITEM2);
-        str += String(getRssiLevel(rssi));
-#ifdef ESP8266
-        if (encType != AUTH_OPEN)
-#else
-        if (encType != WIFI_AUTH_OPEN)
-#endif
+        else if (event == ASYNC_WIFI_EVENT_DISCONNECTED && reason != REASON_ASSOC_LEAVE)
         {
-            str += FPSTR(HTML_WIFI_LOCK);
+            onConnectFailed(classifyFailure(reason, false), reason);
         }
-        str += FPSTR(HTML_WIFI_ITEM3);
-        str += "\n";
-        i++;
-        ret = true;
     }
-    return ret;
-}
-
-bool AsyncWiFiManager::isValidWifiSettings()
-{
-    return mSavedSSID.length() > 0 && mSavedPassword.length() > 0;
 }
 
-void AsyncWiFiManager::readSavedSettings()
+#ifndef ASYNC_WIFI_DISABLE_SCAN
+// The state stays connected while the stronger access point is joined, only a failed roam is reported
+void AsyncWiFiManager::handleRoamEvent(uint8_t event, uint8_t reason)
 {
-    if (!readFile("/ssid.txt", mSavedSSID) || !readFile("/pass.txt", mSavedPassword))
+    if (event == ASYNC_WIFI_EVENT_DISCONNECTED && !mIsAttemptActive)
     {
-        LOGE("Failed to read settings");
-        mSavedSSID = "";
-        mSavedPassword = "";
+        // Disconnected by onRoamScanDone()
+        startConnectAttempt(true);
     }
-}
-
-void AsyncWiFiManager::saveSettings()
-{
-    if (!writeFile("/ssid.txt", mSavedSSID) || !writeFile("/pass.txt", mSavedPassword))
+    else if (event == ASYNC_WIFI_EVENT_CONNECTED)
     {
-        LOGE("Failed to save settings");
+        mIsAssociated = true;
+        mAssociatedTime = millis();
     }
-    else if (mSavedSSID.length() > 0)
+    else if (event == ASYNC_WIFI_EVENT_GOT_IP)
     {
-        LOG("Saved WiFi: %s", mSavedSSID.c_str());
+        onConnected();
+        updateSnapshot();
+    }
+    else if (event == ASYNC_WIFI_EVENT_DISCONNECTED && reason != REASON_ASSOC_LEAVE)
+    {
+        onConnectFailed(classifyFailure(reason, true), reason);
     }
 }
 
-void AsyncWiFiManager::startConfigPortal()
+void AsyncWiFiManager::onScanDone()
 {
-    if (mState != ASYNC_WIFI_STATE_NONE)
+    if (!mIsScanning)
     {
-        LOGE("Cannot start config portal");
         return;
     }
-
-    setState(ASYNC_WIFI_STATE_CONFIG_PORTAL);
-    WiFi.mode(WIFI_AP);
-    if (mAPSSID.length() == 0 || mAPPassword.length() == 0)
+    int wifiCount = WiFi.scanComplete();
+    if (mIsRoamScan)
     {
-        LOG("AP SSID or password has not been set. Use default AP: '%s' '%s'", mAPSSID.c_str(), mAPPassword.c_str());
-        mAPSSID = AP_SSID_DEFAULT;
-        mAPPassword = AP_PASSWORD_DEFAULT;
+        onRoamScanDone(wifiCount);
+        return;
     }
-    if (!WiFi.softAP(mAPSSID, mAPPassword))
+    if (wifiCount < 0)
     {
-        LOGE("Failed to start AP");
-        setState(ASYNC_WIFI_STATE_NONE);
-        return;
+        LOG("WiFi scan disabled or failed");
     }
-    WiFi.softAPConfig(AP_IP_ADDR, IPAddress(0, 0, 0, 0), IPAddress(255, 255, 255, 0));
-    LOG("Start config portal AP: %s", mAPSSID.c_str());
+    else
+    {
+        // Keep the results in the cache and release the driver memory
+        updateScanResults(wifiCount);
+        WiFi.scanDelete();
+        if (mScanChannel > 0 && getNextScanChannel(mScanChannel) > 0)
+        {
+            // Continued by processHandler()
+            mIsScanSlicePending = true;
+            mScanSliceTime = millis();
+            return;
+        }
 
-    startServer();
-    startMDNS();
-    startScanNetworks();
-}
+        uint8_t count = 0;
+        for (uint8_t i = 0; i < mScanResultCount; i++)
+        {
+            if (mScanResults[i].seen)
+            {
+                mScanResults[count++] = mScanResults[i];
+            }
+        }
+        mScanResultCount = count;
+        if (mScanResultCount == 0)
+        {
+            LOG("No networks found");
+        }
+        else
+        {
+            LOG("Found %d networks", mScanResultCount);
+        }
+    }
+    stopScanNetworks();
 
-void AsyncWiFiManager::stopConfigPortal()
-{
-    if (mState != ASYNC_WIFI_STATE_CONFIG_PORTAL)
+    if (mIsSelectingNetwork && mState == ASYNC_WIFI_STATE_CONNECTING)
     {
-        return;
+        mIsSelectingNetwork = false;
+        connectRankedNetworks();
     }
-    LOG("Stop config portal");
-    setState(ASYNC_WIFI_STATE_DISCONNECTED);
-    WiFi.softAPdisconnect(true);
-    WiFi.mode(WIFI_OFF);
-    stopServer();
-    // stopMDNS();
-    stopScanNetworks();
 }
 
-void AsyncWiFiManager::startServer()
+// Sample the signal of the connection, and look for a stronger access point of the same network while it stays low
+void AsyncWiFiManager::processRoaming()
 {
-    if (!mServer)
+    unsigned long now = millis();
+    if ((unsigned long)(now - mRoamSampleTime) < ROAM_SAMPLE_INTERVAL)
     {
-        LOG("Start server");
-        mServer = new WebServerClass(80);
-        mServer->onNotFound(notFoundHandler);
-        mServer->on("/", rootHandler);
-        mServer->on("/save", saveDataHandler);
-        mServer->begin();
+        return;
     }
-}
+    int8_t rssi = WiFi.RSSI();
+    if (rssi >= 0)
+    {
+        return;
+    }
+    // Exponential moving average, a single weak sample does not start a scan
+    mRoamRssi = mRoamRssi == 0 ? rssi * 16 : mRoamRssi + (rssi * 16 - mRoamRssi) / ROAM_RSSI_SMOOTHING;
+    mRoamingStats.rssi = mRoamRssi / 16;
+    bool isLow = mRoamRssi < mRoamingPolicy.rssiThreshold * 16;
+    if (isLow)
+    {
+        mRoamingStats.lowRssiTime += now - mRoamSampleTime;
+    }
+    mRoamSampleTime = now;
 
-void AsyncWiFiManager::stopServer()
-{
-    if (mServer)
+    if (isLow && !mIsScanning && !mIsRoaming && (unsigned long)(now - mRoamScanTime) > mRoamingPolicy.scanInterval &&
+        (unsigned long)(now - mRoamTime) > mRoamingPolicy.roamInterval)
     {
-        LOG("Stop server");
-        mServer->stop();
-        delete mServer;
-        mServer = nullptr;
+        LOG("Low signal %ddBm, scan for another access point", mRoamingStats.rssi);
+        mRoamScanTime = now;
+        mRoamingStats.roamScanCount++;
+        mRoamTarget.score = INT16_MIN;
+        mRoamTarget.channel = 0;
+        // One channel at a time where the network was seen, all channels the first time
+        uint8_t channel = 1;
+        while (channel <= 14 && !(mRoamChannels & (1 << channel)))
+        {
+            channel++;
+        }
+        startRoamScan(channel <= 14 ? channel : 0);
     }
 }
 
-void AsyncWiFiManager::startMDNS()
+// Only the access points of the current network are reported
+void AsyncWiFiManager::startRoamScan(uint8_t channel)
 {
-    if (!mStartedmDNS && mMDnsServerName.length() > 0 && MDNS.begin(mMDnsServerName))
-    {
-        mStartedmDNS = true;
+    LOGD("Roaming scan, channel %d", channel);
+    mRoamScanChannel = channel;
 #ifdef ESP8266
-        MDNS.addService("http", "tcp", 80);
+    int8_t result = WiFi.scanNetworks(true, false, channel, (uint8_t *)mSavedSSID);
+#else
+    int16_t result = WiFi.scanNetworks(true, false, false, ROAM_SCAN_CHANNEL_TIME, channel, mSavedSSID);
 #endif
-        LOG("mDNS responder started at http://%s.local", mMDnsServerName.c_str());
+    if (result == WIFI_SCAN_FAILED)
+    {
+        LOGE("WiFi scan failed");
+        return;
     }
+    mIsScanning = true;
+    mIsRoamScan = true;
 }
 
-void AsyncWiFiManager::stopMDNS()
+void AsyncWiFiManager::onRoamScanDone(int count)
 {
-    if (mStartedmDNS)
+    String ssid;
+    uint8_t encType;
+    int32_t rssi;
+    uint8_t *bssid;
+    int32_t channel;
+#ifdef ESP8266
+    bool hidden;
+#endif
+    uint8_t *currentBSSID = WiFi.BSSID();
+
+    for (int i = 0; i < count; i++)
     {
-        mStartedmDNS = false;
-        LOG("Stop mDNS responder");
-        MDNS.end();
+#ifdef ESP8266
+        if (!WiFi.getNetworkInfo(i, ssid, encType, rssi, bssid, channel, hidden))
+#else
+        if (!WiFi.getNetworkInfo(i, ssid, encType, rssi, bssid, channel))
+#endif
+        {
+            continue;
+        }
+        if (strcmp(ssid.c_str(), mSavedSSID) != 0)
+        {
+            continue;
+        }
+        if (channel > 0 && channel <= 14)
+        {
+            mRoamChannels |= 1 << channel;
+        }
+        if ((!currentBSSID || memcmp(bssid, currentBSSID, sizeof(mRoamTarget.bssid)) != 0) && rssi > mRoamTarget.score)
+        {
+            mRoamTarget.score = rssi;
+            memcpy(mRoamTarget.bssid, bssid, sizeof(mRoamTarget.bssid));
+            mRoamTarget.channel = channel;
+        }
     }
-}
-
-void AsyncWiFiManager::startConnectToSavedWifi()
-{
-    if (mState != ASYNC_WIFI_STATE_NONE)
+    WiFi.scanDelete();
+    mIsScanning = false;
+    mIsRoamScan = false;
+    if (mState != ASYNC_WIFI_STATE_CONNECTED)
     {
-        LOGE("Cannot connnect to saved wifi");
         return;
     }
-    setState(ASYNC_WIFI_STATE_CONNECTING);
-    WiFi.mode(WIFI_STA);
-    WiFi.setAutoReconnect(true);
-    WiFi.begin(mSavedSSID.c_str(), mSavedPassword.c_str());
-    LOG("Connecting to %s", mSavedSSID.c_str());
-    startMDNS();
-}
+    if (mRoamScanChannel > 0)
+    {
+        uint8_t next = mRoamScanChannel + 1;
+        while (next <= 14 && !(mRoamChannels & (1 << next)))
+        {
+            next++;
+        }
+        if (next <= 14)
+        {
+            startRoamScan(next);
+            return;
+        }
+    }
 
-void AsyncWiFiManager::stopConnectToSavedWifi()
-{
-    if (mState != ASYNC_WIFI_STATE_CONNECTING)
+    if (mRoamTarget.channel == 0 || mRoamTarget.score < mRoamRssi / 16 + mRoamingPolicy.hysteresis)
     {
+        LOG("No stronger access point");
         return;
     }
-    LOG("Stop connect to saved Wifi");
-    setState(ASYNC_WIFI_STATE_NONE);
-    WiFi.disconnect(true);
-    stopServer();
-    // stopMDNS();
+    LOG("Roam to %02x:%02x:%02x:%02x:%02x:%02x (channel %d, %ddBm)", mRoamTarget.bssid[0], mRoamTarget.bssid[1], mRoamTarget.bssid[2],
+        mRoamTarget.bssid[3], mRoamTarget.bssid[4], mRoamTarget.bssid[5], mRoamTarget.channel, mRoamTarget.score);
+    mRoamingStats.roamCount++;
+    mRoamTime = millis();
+    mIsRoaming = true;
+    mConnectStartTime = millis();
+    memcpy(mSavedBSSID, mRoamTarget.bssid, sizeof(mSavedBSSID));
+    mSavedChannel = mRoamTarget.channel;
+    // The access point is joined once the disconnection is reported
+    WiFi.disconnect();
 }
+#endif
 
-void AsyncWiFiManager::sendNotFound()
+// Time allowed in each state, 0 if the state never times out
+unsigned long AsyncWiFiManager::getStateTimeout(int state)
 {
-    if (!mServer)
+    switch (state)
     {
-        return;
+#ifndef ASYNC_WIFI_DISABLE_CONFIG_PORTAL
+    case ASYNC_WIFI_STATE_CONFIG_PORTAL:
+        return mConfigPortalTimeout;
+    case ASYNC_WIFI_STATE_CONNECTING:
+        return mIsAutoConfigPortalEnable ? mConnectWifiTimeout : 0;
+#endif
+    default:
+        return 0;
     }
-    mServer->send(404, "text/plain", "404 Not Found");
 }
 
-void AsyncWiFiManager::notFoundHandler()
+void AsyncWiFiManager::onStateTimeout()
 {
-    if (!mServer)
+    mStateTimeout = 0;
+#ifndef ASYNC_WIFI_DISABLE_CONFIG_PORTAL
+    if (mState == ASYNC_WIFI_STATE_CONFIG_PORTAL)
     {
-        return;
+        LOG("Config portal timeout");
+        stopConfigPortal();
     }
-#ifdef DEBUG_HTTP_ARGUMENTS
-    String message = "URI: ";
-    message += mServer->uri();
-    message += "\nMethod: ";
-    message += (mServer->method() == HTTP_GET) ? "GET" : "POST";
-    message += "\nArguments: ";
-    message += mServer->args();
-    message += "\n";
-    for (uint8_t i = 0; i < mServer->args(); i++)
+    else if (mState == ASYNC_WIFI_STATE_CONNECTING)
     {
-        message += " " + mServer->argName(i) + ": " + mServer->arg(i) + "\n";
+        LOG("Connect to saved Wifi timeout");
+        stopConnectToSavedWifi();
+        startConfigPortal();
     }
-    LOG("Http: %s", message.c_str());
 #endif
-    sendNotFound();
 }
 
-void AsyncWiFiManager::rootHandler()
+void AsyncWiFiManager::processHandler()
 {
-    if (!mServer)
-    {
-        return;
-    }
-#ifdef DEBUG_HTTP_ARGUMENTS
-    String message = "URI: ";
-    message += mServer->uri();
-    message += "\nMethod: ";
-    message += (mServer->method() == HTTP_GET) ? "GET" : "POST";
-    message += "\nArguments: ";
-    message += mServer->args();
-    message += "\n";
-    for (uint8_t i = 0; i < mServer->args(); i++)
+#ifndef ASYNC_WIFI_DISABLE_CONFIG_PORTAL
+    // A hot apply keeps the pending settings until it ends
+    if (mIsSavePending.load(std::memory_order_acquire) && mApplyStatus != ASYNC_WIFI_APPLY_CONNECTING)
     {
-        message += " " + mServer->argName(i) + ": " + mServer->arg(i) + "\n";
-    }
-    LOG("Http: %s", message.c_str());
+        if (mParameterCount > 0)
+        {
+            applyParameters(mPendingParameters);
+#ifndef ASYNC_WIFI_DISABLE_PERSISTENCE
+            saveParameters();
+#endif
+            notify(NOTIFY_PARAMETERS_CHANGED, mState);
+        }
+        if (mOnWiFiInformationChanged)
+        {
+            usePendingSettings();
+            mIsSavePending = false;
+            saveSettings();
+            notify(NOTIFY_WIFI_INFORMATION_CHANGED, mState);
+        }
+        else if (mIsHotApplyEnable && mState == ASYNC_WIFI_STATE_CONFIG_PORTAL)
+        {
+            startHotApply();
+        }
+        else
+        {
+            usePendingSettings();
+            saveSettings();
+#if ASYNC_WIFI_LOG_LEVEL > ASYNC_WIFI_LOG_LEVEL_NONE
+            flushLog();
 #endif
+            delay(1000);
+            ESP.restart();
+        }
+    }
 
-    String html = FPSTR(HTML_CONFIG_WIFI);
-    String wifiList = "";
-    if (getScannedWifiHtmlStr(wifiList))
+#ifdef ASYNC_WIFI_ENABLE_OTA
+    if (mIsRestartPending)
     {
-        html.replace(FPSTR(HTML_WIFI_LIST), wifiList);
+        LOG("Restart to the new firmware");
+#if ASYNC_WIFI_LOG_LEVEL > ASYNC_WIFI_LOG_LEVEL_NONE
+        flushLog();
+#endif
+        delay(1000);
+        ESP.restart();
     }
-    else
+    if (Update.isRunning() && (unsigned long)(millis() - mUpdateChunkTime) > UPDATE_IDLE_TIMEOUT)
     {
-        html.replace(FPSTR(HTML_WIFI_LIST), FPSTR(HTML_NO_NETWORKS_FOUND));
+        // The client went away, the async server does not report it
+        endUpdate(false);
     }
+#endif
 
-    mServer->send(200, "text/html", html);
-}
-
-void AsyncWiFiManager::saveDataHandler()
-{
-    if (!mServer)
+    if (mApplyStatus == ASYNC_WIFI_APPLY_CONNECTING && (unsigned long)(millis() - mApplyTime) > HOT_APPLY_TIMEOUT)
     {
-        return;
+        onHotApplyFailed(WiFi.status() == WL_NO_SSID_AVAIL ? ASYNC_WIFI_FAILURE_AP_NOT_FOUND : ASYNC_WIFI_FAILURE_ASSOCIATION);
     }
-    if (mServer->hasArg("s"))
+    else if (mApplyStatus == ASYNC_WIFI_APPLY_CONNECTED && (unsigned long)(millis() - mApplyTime) > HOT_APPLY_CLOSE_DELAY)
     {
-        mSavedSSID = mServer->arg("s");
+        finishHotApply();
     }
-    if (mServer->hasArg("p"))
+#endif
+
+    if (mStateTimeout && (unsigned long)(millis() - mStateTime) > mStateTimeout)
     {
-        mSavedPassword = mServer->arg("p");
+        onStateTimeout();
     }
-    trim(mSavedSSID);
-    trim(mSavedPassword);
-    if (isValidWifiSettings())
-    {
-        String html = FPSTR(HTML_CONFIG_SUCCESS);
-        mServer->send(200, "text/html", html);
 
-        saveSettings();
-        if (mOnWiFiInformationChanged)
+    if (mIsAttemptActive)
+    {
+        if (mIsAssociated && (unsigned long)(millis() - mAssociatedTime) > mReconnectPolicy.dhcpTimeout)
         {
-            mOnWiFiInformationChanged();
+            onConnectFailed(ASYNC_WIFI_FAILURE_DHCP_TIMEOUT, 0);
         }
-        else
+        else if (!mIsAssociated && (unsigned long)(millis() - mAttemptTime) > (mIsFastConnect ? FAST_CONNECT_TIMEOUT : mReconnectPolicy.attemptTimeout))
         {
-            delay(1000);
-            ESP.restart();
+            onConnectFailed(ASYNC_WIFI_FAILURE_ASSOCIATION, 0);
         }
     }
-    else
+    else if (mIsReconnectScheduled && (long)(millis() - mReconnectTime) >= 0)
     {
-        mServer->send(200, "text/plain", F("WiFi information is invalid. Please try again."));
+        startNetworkSelection();
     }
-}
-
-void AsyncWiFiManager::processHandler()
-{
-    static int prevState = ASYNC_WIFI_STATE_NONE;
-    static int prevWifiCount = -99;
-    static unsigned long long timeoutTime = 0, period = 0, scanTime = 0;
 
-    if (mState == ASYNC_WIFI_STATE_CONNECTED && !WiFi.isConnected())
+#ifndef ASYNC_WIFI_DISABLE_SCAN
+#ifdef ESP8266
+    // Scans with options have no completion callback
+    if (mIsScanning && !mIsScanSlicePending && WiFi.scanComplete() >= 0)
     {
-        setState(ASYNC_WIFI_STATE_CONNECTING);
+        pushEvent(ASYNC_WIFI_EVENT_SCAN_DONE, 0);
     }
-    else if (mState == ASYNC_WIFI_STATE_CONNECTING && WiFi.isConnected())
+#endif
+    if (mIsScanSlicePending &&
+        (unsigned long)(millis() - mScanSliceTime) >= ((WiFi.getMode() & WIFI_AP) ? SCAN_SLICE_INTERVAL : 0))
     {
-        setState(ASYNC_WIFI_STATE_CONNECTED);
-        stopScanNetworks();
-        stopServer();
+        mIsScanSlicePending = false;
+        startScanSlice(getNextScanChannel(mScanChannel));
     }
 
-    if (prevState != mState)
+    if (mIsRoamingEnable && mState == ASYNC_WIFI_STATE_CONNECTED)
     {
-        prevState = mState;
-        if (mState == ASYNC_WIFI_STATE_CONFIG_PORTAL)
-        {
-            timeoutTime = millis();
-            period = mConfigPortalTimeout;
-        }
-        else if (mState == ASYNC_WIFI_STATE_CONNECTING && mIsAutoConfigPortalEnable)
-        {
-            timeoutTime = millis();
-            period = mConnectWifiTimeout;
-        }
+        processRoaming();
     }
+#endif
 
-    if (period && !WiFi.isConnected() && (unsigned long)(millis() - timeoutTime) > period)
+#ifndef ASYNC_WIFI_DISABLE_HEALTH
+    if (mState == ASYNC_WIFI_STATE_CONNECTED || mState == ASYNC_WIFI_STATE_DEGRADED)
     {
-        timeoutTime = 0;
-        period = 0;
-        if (mState == ASYNC_WIFI_STATE_CONFIG_PORTAL)
+        if (mIsHealthMonitorEnable)
         {
-            LOG("Config portal timeout");
-            stopConfigPortal();
-        }
-        else if (mState == ASYNC_WIFI_STATE_CONNECTING)
-        {
-            LOG("Connect to saved Wifi timeout");
-            stopConnectToSavedWifi();
-            startConfigPortal();
+            processHealth();
         }
     }
+    else if (mHealthProbe != HEALTH_PROBE_NONE)
+    {
+        stopProbe();
+    }
+#endif
 
-    if (mIsScanning && (unsigned long)(millis() - scanTime) > 100)
+#if !defined(ASYNC_WIFI_DISABLE_CONFIG_PORTAL) && !defined(ASYNC_WIFI_DISABLE_SCAN)
+    // Rescan in the background, but not while a client is using the portal since scanning disturbs the AP
+    if (mState == ASYNC_WIFI_STATE_CONFIG_PORTAL && mScanInterval && !mIsScanning &&
+        mApplyStatus != ASYNC_WIFI_APPLY_CONNECTING && mApplyStatus != ASYNC_WIFI_APPLY_CONNECTED &&
+        (unsigned long)(millis() - mLastScanTime) > mScanInterval &&
+        (unsigned long)(millis() - mLastRequestTime) > SCAN_REQUEST_QUIET_TIME)
     {
-        scanTime = millis();
-        int wifiCount = WiFi.scanComplete();
-        if (prevWifiCount != wifiCount)
-        {
-            prevWifiCount = wifiCount;
-            if (wifiCount == 0)
-            {
-                LOG("No networks found");
-            }
-            else if (wifiCount > 0)
-            {
-                LOG("Found %d networks", wifiCount);
-            }
-            else if (wifiCount == WIFI_SCAN_RUNNING)
-            {
-                LOG("WiFi scan running");
-            }
-            else
-            {
-                LOG("WiFi scan disabled or failed");
-            }
-        }
+        startScanNetworks();
     }
+#endif
 }
 
-void AsyncWiFiManager::trim(String &str)
+#ifndef ASYNC_WIFI_DISABLE_CONFIG_PORTAL
+// Remove leading and trailing spaces and line breaks in place
+void AsyncWiFiManager::trim(char *str)
 {
-    while (str.length() > 0 && (str.indexOf(' ') == 0 || str.indexOf('\r') == 0 || str.indexOf('\n') == 0))
+    size_t length = strlen(str);
+    while (length > 0 && strchr(" \r\n", str[length - 1]))
     {
-        str = str.substring(1);
+        length--;
     }
-    while (str.length() > 0 && (str.lastIndexOf(' ') == str.length() - 1 || str.lastIndexOf('\r') == str.length() - 1 || str.lastIndexOf('\n') == str.length() - 1))
+    size_t start = 0;
+    while (start < length && strchr(" \r\n", str[start]))
     {
-        str = str.substring(0, str.length() - 1);
+        start++;
     }
+    memmove(str, str + start, length - start);
+    str[length - start] = '\0';
 }
 
 int AsyncWiFiManager::getRssiLevel(int rssi)
@@ -698,7 +4177,9 @@ int AsyncWiFiManager::getRssiLevel(int rssi)
     }
     return level;
 }
+#endif
 
+#ifndef ASYNC_WIFI_DISABLE_PERSISTENCE
 void AsyncWiFiManager::initFS()
 {
     static bool initialized = false;
@@ -721,7 +4202,8 @@ void AsyncWiFiManager::initFS()
 #endif
 }
 
-bool AsyncWiFiManager::readFile(const char *path, String &content)
+// Read a text file into content, longer files are truncated to size - 1 bytes
+bool AsyncWiFiManager::readFile(const char *path, char *content, size_t size)
 {
     fs::File file = FS.open(path, "r");
     if (!file || file.isDirectory())
@@ -729,20 +4211,25 @@ bool AsyncWiFiManager::readFile(const char *path, String &content)
         LOGE("Failed to open file %s for reading", path);
         return false;
     }
-    content = file.readString();
+    size_t length = file.read((uint8_t *)content, size - 1);
+    content[length] = '\0';
     file.close();
     return true;
 }
 
-bool AsyncWiFiManager::writeFile(const char *path, String &content)
+// Pass the previous result as crc to continue a CRC over several buffers
+uint32_t AsyncWiFiManager::crc32(const void *data, size_t length, uint32_t crc)
 {
-    fs::File file = FS.open(path, "w");
-    if (!file)
+    const uint8_t *bytes = (const uint8_t *)data;
+    crc = ~crc;
+    while (length--)
     {
-        LOGE("Failed to open file %s for writing", path);
-        return false;
+        crc ^= *bytes++;
+        for (uint8_t i = 0; i < 8; i++)
+        {
+            crc = (crc >> 1) ^ (0xEDB88320UL & (0 - (crc & 1)));
+        }
     }
-    file.print(content);
-    file.close();
-    return true;
-}
\ No newline at end of file
+    return ~crc;
+}
+#endif
\ No newline at end of file
@@ -1,25 +1,133 @@
 #pragma once
 
 #include <Arduino.h>
-#include <LittleFS.h>
+#include <atomic>
+
+#define ASYNC_WIFI_LOG_LEVEL_NONE 0
+#define ASYNC_WIFI_LOG_LEVEL_ERROR 1
+#define ASYNC_WIFI_LOG_LEVEL_INFO 2
+#define ASYNC_WIFI_LOG_LEVEL_DEBUG 3
+
+// Messages above this level are compiled out, ASYNC_WIFI_LOG_LEVEL_NONE also removes the log buffer
+#ifndef ASYNC_WIFI_LOG_LEVEL
+#define ASYNC_WIFI_LOG_LEVEL ASYNC_WIFI_LOG_LEVEL_INFO
+#endif
+
+// Uncomment to collect runtime metrics, available from getMetrics() and the /metrics route of the config portal
+// #define ASYNC_WIFI_ENABLE_METRICS
+
+// Uncomment to add an /update route to the config portal. The firmware is uploaded as a multipart form and
+// can be verified with the md5 or sha256 query argument, e.g. /update?md5=<hex>. The route is only added once
+// setUpdateCredentials() is called, anyone who joins the AP could flash any firmware otherwise
+// #define ASYNC_WIFI_ENABLE_OTA
+
+// Uncomment to run the work of loop() in its own task on ESP32, started with startTask(). loop() then only calls
+// the callbacks of the application, from the task of the application
+// #define ASYNC_WIFI_ENABLE_TASK
+
+// Uncomment to use ESPAsyncWebServer for the config portal instead of the WebServer of the core.
+// Requests are then handled by the TCP stack and loop() no longer serves clients. On ESP32 a request waits while
+// loop() runs, and loop() waits for a request being handled
+// #define ASYNC_WIFI_USE_ASYNC_WEBSERVER
+
+// Uncomment to remove the parts that are not used, they are then not linked at all
+// #define ASYNC_WIFI_DISABLE_CONFIG_PORTAL // Only connect to saved WiFi. Also removes the web server, captive DNS and pages
+// #define ASYNC_WIFI_DISABLE_SCAN          // The config portal does not list networks, no roaming
+// #define ASYNC_WIFI_DISABLE_MDNS
+// #define ASYNC_WIFI_DISABLE_PERSISTENCE   // Settings are kept in RAM only, provisioned with setWifiInformation()
+// #define ASYNC_WIFI_DISABLE_HEALTH        // No health monitor, the connection is only watched through the WiFi events
 
 #ifdef ESP8266
 #include <ESP8266WiFi.h>
 #include <WiFiClient.h>
-#include <ESP8266WebServer.h>
+#ifndef ASYNC_WIFI_DISABLE_MDNS
 #include <ESP8266mDNS.h>
-
-#define WebServerClass ESP8266WebServer
+#endif
 #else
 #include <WiFi.h>
 #include <WiFiClient.h>
 #include <WiFiAP.h>
 #include <WiFiUdp.h>
-#include <WebServer.h>
+#ifndef ASYNC_WIFI_DISABLE_MDNS
 #include <ESPmDNS.h>
+#endif
+#endif
+
+#ifndef ASYNC_WIFI_DISABLE_PERSISTENCE
+#include <LittleFS.h>
+#endif
+
+#ifndef ASYNC_WIFI_DISABLE_CONFIG_PORTAL
+#include <DNSServer.h>
+#ifdef ASYNC_WIFI_USE_ASYNC_WEBSERVER
+#include <ESPAsyncWebServer.h>
+
+#define WebServerClass AsyncWebServer
+#elif defined(ESP8266)
+#include <ESP8266WebServer.h>
+
+#define WebServerClass ESP8266WebServer
+#else
+#include <WebServer.h>
 
 #define WebServerClass WebServer
 #endif
+#if defined(ASYNC_WIFI_USE_ASYNC_WEBSERVER) && !defined(ESP8266)
+// Requests are handled in the async_tcp task, at the same time as loop()
+#define ASYNC_WIFI_PORTAL_LOCK
+#endif
+#endif
+
+#if defined(ASYNC_WIFI_ENABLE_TASK) && defined(ESP8266)
+#error "ASYNC_WIFI_ENABLE_TASK is only available on ESP32"
+#endif
+
+#ifdef ASYNC_WIFI_ENABLE_OTA
+#ifdef ASYNC_WIFI_DISABLE_CONFIG_PORTAL
+#error "ASYNC_WIFI_ENABLE_OTA needs the config portal"
+#endif
+#ifdef ESP8266
+#include <Updater.h>
+#include <bearssl/bearssl_hash.h>
+#else
+#include <Update.h>
+#include <mbedtls/sha256.h>
+#endif
+#endif
+
+#define WIFI_SSID_MAX_LENGTH 32
+#define WIFI_PASSWORD_MAX_LENGTH 64
+#define MDNS_NAME_MAX_LENGTH 63 // Longest DNS label
+#ifndef WIFI_NETWORK_STORE_SIZE
+#define WIFI_NETWORK_STORE_SIZE 4 // Maximum number of saved networks, the least recently used one is replaced when full
+#endif
+#ifndef WIFI_SCAN_CACHE_SIZE
+#define WIFI_SCAN_CACHE_SIZE 20 // Maximum number of networks kept from a scan
+#endif
+#ifndef LOG_QUEUE_SIZE
+#define LOG_QUEUE_SIZE 16 // Number of messages waiting for the log sink
+#endif
+#ifndef LOG_MESSAGE_SIZE
+#define LOG_MESSAGE_SIZE 80 // (bytes) Longer messages are truncated
+#endif
+#ifndef PARAMETER_MAX_COUNT
+#define PARAMETER_MAX_COUNT 8 // Maximum number of custom parameters
+#endif
+#define PARAMETER_ID_MAX_LENGTH 32
+#define UPDATE_CREDENTIAL_MAX_LENGTH 32
+#ifndef ASYNC_WIFI_DISABLE_HEALTH
+#define HEALTH_HOST_MAX_LENGTH 63
+#define HEALTH_PATH_MAX_LENGTH 63
+#endif
+#ifndef RTC_CACHE_OFFSET
+#define RTC_CACHE_OFFSET 0 // (words) Position of the warm boot cache in the RTC user memory of ESP8266, it uses 30 words
+#endif
+#ifndef NOTIFICATION_QUEUE_SIZE
+#define NOTIFICATION_QUEUE_SIZE 16 // Callbacks waiting for loop() with ASYNC_WIFI_ENABLE_TASK
+#endif
+#ifndef RECONNECT_HISTORY_SIZE
+#define RECONNECT_HISTORY_SIZE 16 // Number of failed connection attempts kept for getReconnectHistory()
+#endif
 
 enum AsyncWiFiState
 {
@@ -27,80 +135,728 @@ enum AsyncWiFiState
     ASYNC_WIFI_STATE_CONNECTING,
     ASYNC_WIFI_STATE_CONFIG_PORTAL,
     ASYNC_WIFI_STATE_CONNECTED,
-    ASYNC_WIFI_STATE_DISCONNECTED
+    ASYNC_WIFI_STATE_DISCONNECTED,
+    ASYNC_WIFI_STATE_DEGRADED // Connected, but the health monitor probes fail
+};
+
+enum AsyncWiFiEvent
+{
+    ASYNC_WIFI_EVENT_NONE,
+    ASYNC_WIFI_EVENT_CONNECTED,
+    ASYNC_WIFI_EVENT_GOT_IP,
+    ASYNC_WIFI_EVENT_LOST_IP,
+    ASYNC_WIFI_EVENT_DISCONNECTED,
+    ASYNC_WIFI_EVENT_SCAN_DONE
+};
+
+// Progress of new settings saved in the config portal when hot apply is enabled
+enum AsyncWiFiApplyStatus
+{
+    ASYNC_WIFI_APPLY_IDLE,
+    ASYNC_WIFI_APPLY_CONNECTING,
+    ASYNC_WIFI_APPLY_CONNECTED,
+    ASYNC_WIFI_APPLY_FAILED
+};
+
+enum AsyncWiFiParameterType
+{
+    ASYNC_WIFI_PARAMETER_STRING,
+    ASYNC_WIFI_PARAMETER_INT,
+    ASYNC_WIFI_PARAMETER_BOOL
+};
+
+enum AsyncWiFiFailure
+{
+    ASYNC_WIFI_FAILURE_WRONG_PASSWORD,
+    ASYNC_WIFI_FAILURE_AP_NOT_FOUND,
+    ASYNC_WIFI_FAILURE_ASSOCIATION,
+    ASYNC_WIFI_FAILURE_DHCP_TIMEOUT,
+    ASYNC_WIFI_FAILURE_CONNECTION_LOST,
+    ASYNC_WIFI_FAILURE_COUNT
+};
+
+// The delay before retrying is baseDelay doubled for each consecutive failure of the same class,
+// limited to maxDelay, then reduced by a random part of up to jitterPercent
+struct AsyncWiFiReconnectPolicy
+{
+    unsigned long baseDelay[ASYNC_WIFI_FAILURE_COUNT]; // (ms) Indexed by AsyncWiFiFailure
+    unsigned long maxDelay;                            // (ms)
+    uint8_t jitterPercent;
+    unsigned long attemptTimeout; // (ms) Time to associate with the access point
+    unsigned long dhcpTimeout;    // (ms) Time to get an IP address after association
+};
+
+#ifndef ASYNC_WIFI_DISABLE_SCAN
+// While connected, the signal is smoothed over samples. When it stays below rssiThreshold the channels of the
+// network are scanned, and a stronger access point of the same SSID is joined
+struct AsyncWiFiRoamingPolicy
+{
+    int8_t rssiThreshold;       // (dBm)
+    uint8_t hysteresis;         // (dB) The other access point must be stronger than the current one by this margin
+    unsigned long scanInterval; // (ms) Minimum time between roaming scans
+    unsigned long roamInterval; // (ms) Minimum time between two roams
+};
+
+struct AsyncWiFiRoamingStats
+{
+    uint16_t roamCount;        // Access point changes
+    uint16_t roamScanCount;    // Scans started because the signal was low
+    unsigned long lowRssiTime; // (ms) Time connected with the smoothed signal below the threshold
+    int8_t rssi;               // (dBm) Smoothed signal of the connection
+};
+#endif
+
+#ifndef ASYNC_WIFI_DISABLE_HEALTH
+// While connected, the gateway is probed with a TCP connection, a refused connection also proves it is reachable.
+// When an endpoint is set, it is then probed with an HTTP request that must answer 2xx or 3xx
+struct AsyncWiFiHealthPolicy
+{
+    unsigned long probeInterval; // (ms)
+    unsigned long probeTimeout;  // (ms)
+    uint16_t gatewayPort;
+    uint8_t degradedFailures;  // Consecutive failed probes before ASYNC_WIFI_STATE_DEGRADED
+    uint8_t reconnectFailures; // Consecutive failed probes before a reconnection is forced, 0 to never reconnect
+};
+
+struct AsyncWiFiHealthStats
+{
+    uint16_t latency;        // (ms) Smoothed time to connect to the gateway
+    uint8_t loss;            // (%) Smoothed share of failed probes
+    uint8_t failureCount;    // Consecutive failed probes
+    bool internet;           // The last endpoint probe succeeded, false without endpoint
+    uint32_t probeCount;
+    uint16_t reconnectCount; // Reconnections forced by failed probes
+};
+#endif
+
+struct AsyncWiFiReconnectAttempt
+{
+    unsigned long time;  // (ms) millis() when the attempt failed
+    uint8_t failure;     // AsyncWiFiFailure
+    uint8_t reason;      // Disconnect reason reported by the driver, 0 for timeouts
+    unsigned long delay; // (ms) Delay before the next attempt
+};
+
+#ifdef ASYNC_WIFI_ENABLE_METRICS
+#define METRICS_LATENCY_BUCKET_COUNT 9
+
+struct AsyncWiFiRequestMetrics
+{
+    uint32_t requests;
+    uint32_t latencyBuckets[METRICS_LATENCY_BUCKET_COUNT]; // Upper bounds 5, 10, 25, 50, 100, 250, 500, 1000 ms and above
+    unsigned long totalLatency;                             // (ms)
+};
+
+struct AsyncWiFiMetrics
+{
+    unsigned long stateTime[ASYNC_WIFI_STATE_DEGRADED + 1]; // (ms) Time spent in each AsyncWiFiState
+    uint32_t connectAttempts;
+    uint32_t connectSuccesses;
+    unsigned long lastConnectDuration;  // (ms) Duration of the successful attempt
+    unsigned long totalConnectDuration; // (ms)
+    uint32_t disconnects;               // Established connections that were lost
+    uint8_t lastDisconnectReason;
+    uint32_t failures[ASYNC_WIFI_FAILURE_COUNT]; // Failed attempts, indexed by AsyncWiFiFailure
+#ifndef ASYNC_WIFI_DISABLE_CONFIG_PORTAL
+    AsyncWiFiRequestMetrics rootHandler;
+    AsyncWiFiRequestMetrics saveDataHandler;
+    uint32_t bytesServed; // Response bodies sent by the config portal
+#endif
+    uint32_t minFreeHeap;     // Sampled at state transitions
+    uint32_t minMaxFreeBlock; // Sampled at state transitions
+};
+#endif
+
+#ifdef ASYNC_WIFI_ENABLE_OTA
+// Last firmware upload. The chunk sizes are those of the web server, they bound the throughput
+struct AsyncWiFiUpdateStats
+{
+    uint32_t size;          // (bytes) Written to the flash
+    unsigned long duration; // (ms) From the start to the end of the upload
+    uint32_t throughput;    // (bytes/s) Sustained over the upload
+    uint16_t chunkCount;
+    uint16_t maxChunkSize; // (bytes)
+    bool success;
+};
+#endif
+
+struct AsyncWiFiScanResult
+{
+    char ssid[WIFI_SSID_MAX_LENGTH + 1];
+    int8_t rssi;
+    uint8_t channel;
+    uint8_t encType;
+    uint8_t bssid[6];
+    bool seen; // Seen by the scan in progress, the other results are removed when it completes
+};
+
+#ifndef ASYNC_WIFI_DISABLE_SCAN
+// A channel mask is scanned one channel at a time. So is every scan while the config portal AP is running,
+// with a pause between channels to serve the clients
+struct AsyncWiFiScanOptions
+{
+    uint16_t channelMask;                // Bit n scans channel n, 0 for channels 1 to 13
+    bool passive;                        // Listen for beacons instead of sending probe requests (ESP32 only)
+    uint16_t dwellTime;                  // (ms) Time spent on each channel (ESP32 only)
+    char ssid[WIFI_SSID_MAX_LENGTH + 1]; // Probe for this network only, empty for all networks
+};
+#endif
+
+struct AsyncWiFiConnectStats
+{
+    uint16_t fastConnectCount;         // Connections using the cached BSSID and channel
+    uint16_t fastConnectFallbackCount; // Fast connections that fell back to a normal connection
+    uint16_t normalConnectCount;       // Connections after a scan of all channels
+    unsigned long fastConnectTime;     // (ms) Duration of the last fast connection
+    unsigned long normalConnectTime;   // (ms) Duration of the last normal connection
+    bool lastConnectFast;
+    unsigned long bootToBeginTime;     // (ms) millis() at the first WiFi.begin() after boot
+    bool warmBoot;                     // The first connection used the RTC cache, the file system was not mounted for it
+};
+
+// Consistent copy of the state, can be read from any task
+struct AsyncWiFiSnapshot
+{
+    AsyncWiFiState state;
+    unsigned long stateTime; // (ms) millis() when the state was entered
+    uint32_t localIP;        // 0 unless connected
+    char ssid[WIFI_SSID_MAX_LENGTH + 1]; // Network of the connection, empty unless connected
+#ifdef ASYNC_WIFI_ENABLE_TASK
+    uint32_t notificationDropCount; // Callbacks dropped because loop() was not called often enough
+#endif
 };
 
 class AsyncWiFiManager
 {
 private:
+    // Stored as is in the settings file
+    struct SavedNetwork
+    {
+        char ssid[WIFI_SSID_MAX_LENGTH + 1];
+        char password[WIFI_PASSWORD_MAX_LENGTH + 1];
+        // Access point of the last successful connection, channel 0 if unknown
+        uint8_t bssid[6];
+        uint8_t channel;
+        uint32_t lastUsed; // Sequence number of the last save or connection, larger is more recent
+    };
+
+    // A saved network ranked for the next connection, with the access point to join
+    struct NetworkCandidate
+    {
+        uint8_t network; // Index in mNetworks
+        int16_t score;
+        uint8_t bssid[6];
+        uint8_t channel; // 0 to let the driver find the access point
+    };
+
+#ifndef ASYNC_WIFI_DISABLE_PERSISTENCE
+    // The saved settings file is a header followed by the saved networks
+    struct SettingsHeader
+    {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t size;
+        uint32_t crc;
+    };
+
+    // Network of the last connection, kept in RTC memory across deep sleep
+    struct RtcCache
+    {
+        uint32_t magic;
+        uint32_t crc;
+        SavedNetwork network;
+    };
+
+    // Versions 1 and 2 store a single network
+    struct SettingsData
+    {
+        char ssid[WIFI_SSID_MAX_LENGTH + 1];
+        char password[WIFI_PASSWORD_MAX_LENGTH + 1];
+        uint8_t bssid[6];
+        uint8_t channel;
+    };
+#endif
+
+    // Registered with addParameter(), the value is owned by the sketch
+    struct CustomParameter
+    {
+        const char *id; // Form field and key in the parameters file
+        const char *label;
+        uint8_t type;      // AsyncWiFiParameterType
+        uint8_t maxLength; // String parameters
+        void *value;
+        int32_t min; // Int parameters
+        int32_t max;
+    };
+
+    struct StateTransition
+    {
+        uint8_t state;
+        uint8_t event;
+        uint8_t nextState;
+    };
+
+    struct QueuedEvent
+    {
+        std::atomic<bool> ready;
+        uint8_t event;
+        uint8_t reason;
+    };
+
+    static const uint8_t EVENT_QUEUE_SIZE = 8;
+
+#ifdef ASYNC_WIFI_ENABLE_TASK
+    struct Notification
+    {
+        uint8_t type;
+        uint8_t state;
+    };
+#endif
+
+#if ASYNC_WIFI_LOG_LEVEL > ASYNC_WIFI_LOG_LEVEL_NONE
+    struct LogEntry
+    {
+        std::atomic<bool> ready;
+        uint8_t level;
+        char message[LOG_MESSAGE_SIZE];
+    };
+#endif
+    static const StateTransition TRANSITIONS[];
+
     static unsigned long mConnectWifiTimeout;
-    static unsigned long mConfigPortalTimeout;
-    static String mSavedSSID;
-    static String mSavedPassword;
-    static String mAPSSID;
-    static String mAPPassword;
+    // Network of the current connection
+    static char mSavedSSID[WIFI_SSID_MAX_LENGTH + 1];
+    static char mSavedPassword[WIFI_PASSWORD_MAX_LENGTH + 1];
+    static SavedNetwork mNetworks[WIFI_NETWORK_STORE_SIZE];
+    static uint8_t mNetworkCount;
+    static NetworkCandidate mCandidates[WIFI_NETWORK_STORE_SIZE];
+    static uint8_t mCandidateCount;
+    static uint8_t mCandidateIndex;
+    static unsigned long mSelectionTime;
+    static CustomParameter mParameters[PARAMETER_MAX_COUNT];
+    static uint8_t mParameterCount;
     static int mState;
+#ifndef ASYNC_WIFI_DISABLE_CONFIG_PORTAL
+    static unsigned long mConfigPortalTimeout;
+    static char mAPSSID[WIFI_SSID_MAX_LENGTH + 1];
+    static char mAPPassword[WIFI_PASSWORD_MAX_LENGTH + 1];
+    static uint8_t mAPChannel;
     static WebServerClass *mServer;
-    static bool mStartedmDNS;
-    static bool mIsScanning;
+#ifdef ASYNC_WIFI_USE_ASYNC_WEBSERVER
+    static AsyncWebServerRequest *mRequest;
+    static AsyncResponseStream *mResponseStream;
+#endif
+    static DNSServer *mCaptiveDnsServer;
     static bool mIsAutoConfigPortalEnable;
-    static String mMDnsServerName;
+    static bool mIsHotApplyEnable;
+    static uint8_t mApplyStatus;
+    static uint8_t mApplyFailure;
+    static unsigned long mApplyTime;
+    static unsigned long mLastRequestTime;
+    // Set by the save handler, the pending settings then belong to loop() until it is cleared
+    static std::atomic<bool> mIsSavePending;
+    // Submitted in the config portal, they replace the saved network only once they are applied
+    static char mPendingSSID[WIFI_SSID_MAX_LENGTH + 1];
+    static char mPendingPassword[WIFI_PASSWORD_MAX_LENGTH + 1];
+    static uint8_t *mPendingParameters; // Values of all the parameters, allocated while the server runs
+#ifdef ASYNC_WIFI_PORTAL_LOCK
+    static SemaphoreHandle_t mPortalLock;
+#endif
+#ifdef ASYNC_WIFI_ENABLE_OTA
+    static void (*mOnUpdateProgress)(size_t written, size_t total);
+    static AsyncWiFiUpdateStats mUpdateStats;
+    static size_t mUpdateTotal; // (bytes) Size of the request, 0 if unknown
+    static unsigned long mUpdateStartTime;
+    static unsigned long mUpdateChunkTime;
+    static bool mIsUpdateSha256; // The image is verified against mUpdateSha256
+    static uint8_t mUpdateSha256[32];
+    static char mUpdateUser[UPDATE_CREDENTIAL_MAX_LENGTH + 1];
+    static char mUpdatePassword[UPDATE_CREDENTIAL_MAX_LENGTH + 1];
+#ifdef ESP8266
+    static br_sha256_context mUpdateSha256Context;
+#else
+    static mbedtls_sha256_context mUpdateSha256Context;
+#endif
+    static volatile bool mIsRestartPending;
+#endif
+#endif
+#ifndef ASYNC_WIFI_DISABLE_SCAN
+    static bool mIsScanning;
+    static bool mIsScanSlicePending;
+    static AsyncWiFiScanOptions mScanOptions;
+    static uint8_t mScanChannel; // Channel of the current slice, 0 when all channels are scanned at once
+    static unsigned long mScanSliceTime;
+    static bool mIsSelectingNetwork;
+    static bool mIsRoamingEnable;
+    static bool mIsRoamScan;
+    static bool mIsRoaming;
+    static AsyncWiFiRoamingPolicy mRoamingPolicy;
+    static AsyncWiFiRoamingStats mRoamingStats;
+    static int16_t mRoamRssi; // (1/16 dBm) 0 until the first sample
+    static unsigned long mRoamSampleTime;
+    static unsigned long mRoamScanTime;
+    static unsigned long mRoamTime;
+    static uint16_t mRoamChannels; // Channels where the network was seen, bit n for channel n
+    static uint8_t mRoamScanChannel; // 0 for all channels
+    static NetworkCandidate mRoamTarget;
+    static AsyncWiFiScanResult mScanResults[WIFI_SCAN_CACHE_SIZE];
+    static uint8_t mScanResultCount;
+    static unsigned long mScanInterval;
+    static unsigned long mLastScanTime;
+#endif
+#ifndef ASYNC_WIFI_DISABLE_MDNS
+    static bool mStartedmDNS;
+    static char mMDnsServerName[MDNS_NAME_MAX_LENGTH + 1];
+#endif
+#ifndef ASYNC_WIFI_DISABLE_PERSISTENCE
+    static uint32_t mSavedSettingsCrc;
+    static uint32_t mSavedParametersCrc;
+    static bool mIsSettingsLoaded;
+#ifndef ESP8266
+    static RtcCache mRtcCache;
+#endif
+#endif
+    static uint8_t mSavedBSSID[6];
+    static uint8_t mSavedChannel;
+    static bool mIsFastConnect;
+    static unsigned long mConnectStartTime;
+    static AsyncWiFiConnectStats mConnectStats;
+    static unsigned long mStateTime;
+    static AsyncWiFiReconnectPolicy mReconnectPolicy;
+    static uint8_t mFailureCount[ASYNC_WIFI_FAILURE_COUNT];
+    static bool mIsAttemptActive;
+    static bool mIsAssociated;
+    static bool mIsReconnectScheduled;
+    static unsigned long mAttemptTime;
+    static unsigned long mAssociatedTime;
+    static unsigned long mReconnectTime;
+    static AsyncWiFiReconnectAttempt mReconnectHistory[RECONNECT_HISTORY_SIZE];
+    static uint8_t mReconnectHistoryHead;
+    static uint8_t mReconnectHistoryCount;
+    static unsigned long mStateTimeout;
+    static QueuedEvent mEventQueue[EVENT_QUEUE_SIZE];
+    static std::atomic<uint8_t> mEventHead;
+    static std::atomic<uint8_t> mEventTail;
+    static std::atomic<uint16_t> mOverflowEvent; // Last event and reason pushed while the queue was full, 0 if none
+    static std::atomic<bool> mIsOverflowScanDone;
+    static std::atomic<uint32_t> mEventDropCount;
+    static uint32_t mEventReportedDropCount;
+    static AsyncWiFiSnapshot mSnapshot;
+    static std::atomic<uint32_t> mSnapshotSequence; // Odd while mSnapshot is written
+#ifdef ASYNC_WIFI_ENABLE_TASK
+    static TaskHandle_t mTaskHandle;
+    static Notification mNotificationQueue[NOTIFICATION_QUEUE_SIZE];
+    static std::atomic<uint8_t> mNotificationHead;
+    static std::atomic<uint8_t> mNotificationTail;
+    static uint32_t mNotificationDropCount;
+#endif
+#ifdef ESP8266
+    static WiFiEventHandler mConnectedHandler;
+    static WiFiEventHandler mGotIPHandler;
+    static WiFiEventHandler mDisconnectedHandler;
+#endif
+#ifdef ASYNC_WIFI_ENABLE_METRICS
+    static AsyncWiFiMetrics mMetrics;
+#endif
+#if ASYNC_WIFI_LOG_LEVEL > ASYNC_WIFI_LOG_LEVEL_NONE
+    static LogEntry mLogQueue[LOG_QUEUE_SIZE];
+    static std::atomic<uint8_t> mLogHead;
+    static std::atomic<uint8_t> mLogTail;
+    static std::atomic<uint32_t> mLogDroppedCount;
+    static uint32_t mLogReportedDroppedCount;
+    static void (*mLogSink)(uint8_t level, const char *message);
+#endif
+#ifndef ASYNC_WIFI_DISABLE_HEALTH
+    static bool mIsHealthMonitorEnable;
+    static AsyncWiFiHealthPolicy mHealthPolicy;
+    static AsyncWiFiHealthStats mHealthStats;
+    static char mHealthHost[HEALTH_HOST_MAX_LENGTH + 1]; // Empty to probe the gateway only
+    static char mHealthPath[HEALTH_PATH_MAX_LENGTH + 1];
+    static uint16_t mHealthPort;
+    static unsigned long mHealthProbeTime;
+    static uint32_t mHealthLatency; // (1/8 ms) 0 until the first sample
+    static uint16_t mHealthLoss;    // (1/100 %)
+    static unsigned long mProbeStartTime;
+    static uint32_t mProbeGateway; // IPv4 address
+    // Also read or written by the lwIP callbacks, which run in the lwIP task on ESP32
+    static std::atomic<uint8_t> mHealthProbe;     // Probe in progress, HEALTH_PROBE_NONE between probes
+    static std::atomic<uint16_t> mProbeSequence;  // Incremented for each probe, results of older probes are ignored
+    static std::atomic<uint32_t> mProbeResult;    // Sequence number << 8 | status
+    static std::atomic<unsigned long> mProbeEndTime;
+#endif
     static void (*onStateChanged)(AsyncWiFiState state);
     static void (*mOnWiFiInformationChanged)();
+    static void (*mOnParametersChanged)();
 
 public:
     static void begin();
     static void loop();
+#ifdef ASYNC_WIFI_ENABLE_TASK
+    // Call after begin() and the setters. The task then does the work of loop(), which only calls the callbacks.
+    // The other functions must not be called once the task runs, except the getters of the stats and getSnapshot().
+    // Up to NOTIFICATION_QUEUE_SIZE callbacks wait for loop(). When it is full, new ones are dropped and counted in
+    // AsyncWiFiSnapshot::notificationDropCount, the current state is then still available from getSnapshot()
+    static bool startTask(UBaseType_t priority = 1, uint32_t stackSize = 8192, BaseType_t core = ARDUINO_RUNNING_CORE);
+#endif
     static void resetSettings();
     static void turnOff();
 
     // Only used for debugging.The device needs to restart after using it.
-    static void setWifiInformation(String ssid, String password);
+    static void setWifiInformation(const char *ssid, const char *password);
+    static void setWifiInformation(const String &ssid, const String &password);
+    // Add a network to the saved ones or change its password. Must call after begin()
+    static void addWifiInformation(const char *ssid, const char *password);
+    static void addWifiInformation(const String &ssid, const String &password);
+    static uint8_t getSavedNetworkCount();
+    // Must call before begin(). id and label must stay valid, e.g. string literals. The value is set from the saved
+    // parameters by begin() and from the config portal form. Returns false if PARAMETER_MAX_COUNT is reached
+    static bool addParameter(const char *id, const char *label, char *value, uint8_t maxLength);
+    static bool addParameter(const char *id, const char *label, int32_t *value, int32_t min, int32_t max);
+    static bool addParameter(const char *id, const char *label, bool *value);
 
     // Must call before begin()
-    static void setAPInformation(String ssid, String password);
+#ifndef ASYNC_WIFI_DISABLE_CONFIG_PORTAL
+    static void setAPInformation(const char *ssid, const char *password);
+    static void setAPInformation(const String &ssid, const String &password);
     static void setAutoConfigPortalEnable(bool enabled);
-    static void setMDnsServerName(String serverName);
-    static void setConnectWifiTimeout(unsigned int timeout);
+    static void setHotApplyEnable(bool enabled);
     static void setConfigPortalTimeout(unsigned int timeout);
+#endif
+#ifndef ASYNC_WIFI_DISABLE_MDNS
+    static void setMDnsServerName(const char *serverName);
+    static void setMDnsServerName(const String &serverName);
+#endif
+    static void setConnectWifiTimeout(unsigned int timeout);
+#if !defined(ASYNC_WIFI_DISABLE_CONFIG_PORTAL) && !defined(ASYNC_WIFI_DISABLE_SCAN)
+    static void setScanInterval(unsigned long interval);
+#endif
+    static void setReconnectPolicy(const AsyncWiFiReconnectPolicy &policy);
+#ifndef ASYNC_WIFI_DISABLE_HEALTH
+    static void setHealthMonitorEnable(bool enabled);
+    static void setHealthPolicy(const AsyncWiFiHealthPolicy &policy);
+    // host is a name or an IP address, an empty host probes the gateway only
+    static void setHealthEndpoint(const char *host, uint16_t port = 80, const char *path = "/");
+#endif
+#ifndef ASYNC_WIFI_DISABLE_SCAN
+    static void setScanOptions(const AsyncWiFiScanOptions &options);
+    static void setRoamingEnable(bool enabled);
+    static void setRoamingPolicy(const AsyncWiFiRoamingPolicy &policy);
+#endif
 
     static void setOnStateChanged(void (*callback)(AsyncWiFiState state));
     static void setOnWiFiInformationChanged(void (*callback)());
+    // Called from loop() after the parameters have been saved in the config portal
+    static void setOnParametersChanged(void (*callback)());
+#if ASYNC_WIFI_LOG_LEVEL > ASYNC_WIFI_LOG_LEVEL_NONE
+    // Messages are written to Serial by default
+    static void setLogSink(void (*sink)(uint8_t level, const char *message));
+    // Write the buffered messages to the sink. Called by loop()
+    static void flushLog();
+    static uint32_t getLogDroppedCount();
+#endif
 
+#ifndef ASYNC_WIFI_DISABLE_SCAN
     static void printScannedNetWorks();
+#endif
+    static const AsyncWiFiConnectStats &getConnectStats();
+    static const AsyncWiFiReconnectPolicy &getReconnectPolicy();
+#ifndef ASYNC_WIFI_DISABLE_HEALTH
+    static const AsyncWiFiHealthPolicy &getHealthPolicy();
+    static const AsyncWiFiHealthStats &getHealthStats();
+#endif
+#ifndef ASYNC_WIFI_DISABLE_SCAN
+    static const AsyncWiFiScanOptions &getScanOptions();
+    static const AsyncWiFiRoamingPolicy &getRoamingPolicy();
+    static const AsyncWiFiRoamingStats &getRoamingStats();
+#endif
+#ifdef ASYNC_WIFI_ENABLE_METRICS
+    static AsyncWiFiMetrics getMetrics();
+#endif
+    static uint8_t getReconnectHistory(AsyncWiFiReconnectAttempt *attempts, uint8_t size);
+    static const char *getFailureStr(uint8_t failure);
     static int getState();
-    static String getStateStr();
+    static AsyncWiFiSnapshot getSnapshot();
+    // WiFi events that found the queue full and were merged with the next ones, loop() was not called often enough
+    static uint32_t getEventDropCount();
+    static const char *getStateStr();
+#ifndef ASYNC_WIFI_DISABLE_CONFIG_PORTAL
+    static AsyncWiFiApplyStatus getApplyStatus();
+#endif
+#ifdef ASYNC_WIFI_ENABLE_OTA
+    // HTTP basic authentication of the /update route, set before the config portal starts. Without it there is no route
+    static void setUpdateCredentials(const char *user, const char *password);
+    // Called for each chunk written to the flash, total is the size of the request or 0 if unknown.
+    // With ASYNC_WIFI_USE_ASYNC_WEBSERVER it is called from the TCP task
+    static void setOnUpdateProgress(void (*callback)(size_t written, size_t total));
+    static const AsyncWiFiUpdateStats &getUpdateStats();
+#endif
 
 private:
+    static void runLoop();
     static void setState(int state);
+    static void updateSnapshot();
+    static void notify(uint8_t type, uint8_t state);
+    static void dispatchNotification(uint8_t type, uint8_t state);
+#ifdef ASYNC_WIFI_ENABLE_TASK
+    static void taskHandler(void *arg);
+    static void processNotifications();
+#endif
+    static const char *getStateName(int state);
+#ifndef ASYNC_WIFI_DISABLE_SCAN
     static void startScanNetworks();
     static void stopScanNetworks();
-    static String getEncryptionTypeStr(uint8_t encType);
-    static bool getScannedWifiHtmlStr(String &str);
+    static void startScanSlice(uint8_t channel);
+    static uint8_t getNextScanChannel(uint8_t channel);
+    static void updateScanResults(int count);
+    static const char *getEncryptionTypeStr(uint8_t encType);
+    static bool isLockedNetwork(const AsyncWiFiScanResult &network);
+    static void onScanDone();
+    static void processRoaming();
+    static void startRoamScan(uint8_t channel);
+    static void onRoamScanDone(int count);
+    static void handleRoamEvent(uint8_t event, uint8_t reason);
+#endif
 
     static bool isValidWifiSettings();
     static void readSavedSettings();
-    static void saveSettings();
-    static void startConfigPortal();
-    static void stopConfigPortal();
-    static void startServer();
-    static void stopServer();
+    static bool saveSettings();
+    static int findNetwork(const char *ssid);
+    static bool storeNetwork(const char *ssid, const char *password, const uint8_t *bssid, uint8_t channel);
+    static void useNetwork(uint8_t index);
+    static bool addParameter(const char *id, const char *label, uint8_t type, void *value);
+#ifndef ASYNC_WIFI_DISABLE_PERSISTENCE
+    static void loadSettings();
+    static bool readSettingsFile();
+    static bool writeSettingsFile();
+    static void loadParameters();
+    static bool saveParameters();
+    static size_t serializeParameter(const CustomParameter &parameter, uint8_t *record);
+    static bool readRtcCache(SavedNetwork &network);
+    static void updateRtcCache();
+#endif
+#ifndef ASYNC_WIFI_DISABLE_MDNS
     static void startMDNS();
     static void stopMDNS();
+#endif
     static void startConnectToSavedWifi();
     static void stopConnectToSavedWifi();
+    static void startNetworkSelection();
+    static void connectRankedNetworks();
+    static bool connectNextCandidate();
+    static void onConnected();
+    static void startConnectAttempt(bool fast);
+    static void onConnectFailed(uint8_t failure, uint8_t reason);
+    static unsigned long getReconnectDelay(uint8_t failure);
+    static uint8_t classifyFailure(uint8_t reason, bool wasConnected);
+#ifndef ASYNC_WIFI_DISABLE_HEALTH
+    static void processHealth();
+    static void startProbe(uint8_t probe);
+    static void stopProbe();
+    static void onHealthProbeDone(bool success);
+    static void runInTcpip(void (*function)(void *));
+    // The lwIP callbacks of the probes, defined in the .cpp so the lwIP headers stay out of this one
+    struct Probe;
+#endif
+
+#ifndef ASYNC_WIFI_DISABLE_CONFIG_PORTAL
+    static void startConfigPortal();
+    static void stopConfigPortal();
+    static uint8_t getAPChannel();
+    static void moveAP(uint8_t channel);
+    static void startServer();
+    static void stopServer();
+    static void startCaptiveDnsServer();
+    static void stopCaptiveDnsServer();
+    static void startHotApply();
+    static void onHotApplySucceeded();
+    static void usePendingSettings();
+    static void onHotApplyFailed(uint8_t failure);
+    static void finishHotApply();
 
+#ifdef ASYNC_WIFI_USE_ASYNC_WEBSERVER
+    static void handleRequest(AsyncWebServerRequest *request, void (*handler)());
+#endif
+    static void addRoute(const char *uri, void (*handler)());
+    static void beginResponse(const char *contentType);
+    static void sendContent(const char *content, size_t length);
+    static void sendContent_P(PGM_P content);
+    static void endResponse();
+    static void sendResponse(int code, const char *contentType, const char *content);
+    static void sendRedirect(const char *url);
+    static bool hasArg(const char *name);
+    static String getArg(const char *name);
+    static String getHeader(const char *name);
+#ifdef DEBUG_HTTP_ARGUMENTS
+    static void logRequest();
+#endif
     static void sendNotFound();
+    static void sendGzipResource(const uint8_t *content, size_t length, const char *etag, const char *contentType);
     static void notFoundHandler();
+    static void captivePortalHandler();
     static void rootHandler();
     static void saveDataHandler();
+    static void scanHandler();
+    static void statusHandler();
+    static void styleHandler();
+    static void scriptHandler();
+    static bool sendScannedWifiList();
+    static void sendScannedWifiJson();
+    static void sendChunked(char *buffer, size_t &length, const char *data, int size);
+    static void sendEscapedHtml(char *buffer, size_t &length, const char *text);
+    static void sendEscapedJson(char *buffer, size_t &length, const char *text);
+    static void sendParameters();
+    static size_t getParameterSize(const CustomParameter &parameter);
+    static bool parseParameters(uint8_t *values);
+    static void applyParameters(const uint8_t *values);
+    static int readArg(const char *name, char *value, size_t size);
+#ifdef ASYNC_WIFI_ENABLE_OTA
+    static void updateHandler();
+#ifndef ASYNC_WIFI_USE_ASYNC_WEBSERVER
+    static void updateUploadHandler();
+#endif
+    static bool authenticateUpdate();
+    static void beginUpdate(size_t total);
+    static void writeUpdate(uint8_t *data, size_t length);
+    static void endUpdate(bool isComplete);
+    static bool parseHex(const char *hex, uint8_t *data, size_t size);
+#endif
+#ifdef ASYNC_WIFI_ENABLE_METRICS
+    static void metricsHandler();
+    static void sendRequestMetrics(char *buffer, size_t &length, const char *handler, const AsyncWiFiRequestMetrics &request);
+    static void recordRequest(AsyncWiFiRequestMetrics &request, unsigned long latency);
+#endif
+#endif
+#ifdef ASYNC_WIFI_ENABLE_METRICS
+    static void sampleHeap();
+#endif
 
+    static void registerWiFiEvents();
+#ifndef ESP8266
+    static void onWiFiEvent(arduino_event_id_t event, arduino_event_info_t info);
+#endif
+#if ASYNC_WIFI_LOG_LEVEL > ASYNC_WIFI_LOG_LEVEL_NONE
+    static void logMessage(uint8_t level, PGM_P format, ...);
+    static void serialLogSink(uint8_t level, const char *message);
+#endif
+    static void pushEvent(uint8_t event, uint8_t reason);
+    static void processEvents();
+    static void handleEvent(uint8_t event, uint8_t reason);
+    static unsigned long getStateTimeout(int state);
+    static void onStateTimeout();
     static void processHandler();
 
+#ifndef ASYNC_WIFI_DISABLE_CONFIG_PORTAL
     static int getRssiLevel(int rssi);
-    static void trim(String &str);
+    static void trim(char *str);
+#endif
 
+#ifndef ASYNC_WIFI_DISABLE_PERSISTENCE
     static void initFS();
-    static bool readFile(const char *path, String &content);
-    static bool writeFile(const char *path, String &content);
+    static bool readFile(const char *path, char *content, size_t size);
+    static uint32_t crc32(const void *data, size_t length, uint32_t crc = 0);
+#endif
+
+#ifdef ASYNC_WIFI_HOST_TEST
+    friend struct AsyncWiFiManagerTest; // Access of the host tests in test/
+#endif
 };
\ No newline at end of file
@@ -10,9 +10,21 @@ void setup()
     AsyncWiFiManager::setMDnsServerName("esp32");
     // Automatically switch to config portal mode when unable to connect to saved WiFi (default: false)
     AsyncWiFiManager::setAutoConfigPortalEnable(false);
+    // Try WiFi information saved in the config portal without restarting (default: false)
+    AsyncWiFiManager::setHotApplyEnable(true);
+    // Join a stronger access point of the same WiFi when the signal is low (default: false)
+    AsyncWiFiManager::setRoamingEnable(false);
+
+    // Extra fields of the config portal, loaded by begin() and saved with the WiFi information
+    // static char mqttHost[41] = "";
+    // AsyncWiFiManager::addParameter("mqtt", "MQTT host", mqttHost, 40);
 
     // Begin
     AsyncWiFiManager::begin();
+    // Keep a fallback network, the saved networks are tried from the strongest and most recently used one
+    // AsyncWiFiManager::addWifiInformation("Phone hotspot", "12345678");
+    // With ASYNC_WIFI_ENABLE_TASK on ESP32, keep serving the portal while loop() is busy
+    // AsyncWiFiManager::startTask();
 }
 
 void loop()
@@ -2,5 +2,232 @@
 
 #include <Arduino.h>
 
-const char HTML_CONFIG_SUCCESS[] PROGMEM = "<!DOCTYPE html><html lang='en'><head> <meta charset='UTF-8'> <meta name='viewport' content='width=device-width, initial-scale=1.0'> <title>Config WiFi</title></head><body> <h1>WiFi information has been saved.</h1> <p>The device will reboot automatically.</p> <a href='/'>Return to configuration page</a></body></html>";
-const char HTML_CONFIG_WIFI[] PROGMEM = "<!DOCTYPE html><html lang='en'><head> <meta name='format-detection' content='telephone=no'> <meta charset='UTF-8'> <meta name='viewport' content='width=device-width,initial-scale=1,user-scalable=no' /> <title>Config WiFi</title> <script> function validateForm() { var ssid = document.getElementById('s').value; var password = document.getElementById('p').value; if (ssid.length < 3) { alert('SSID must be at least 3 characters.'); return false; } if (password.length < 8) { alert('Password must be at least 8 characters.'); return false; } return true; } function c(l) { document.getElementById('s').value = l.innerText || l.textContent; p = l.nextElementSibling.classList.contains('l'); document.getElementById('p').disabled = !p; if (p) { document.getElementById('p').focus(); } } function f() { var x = document.getElementById('p'); x.type === 'password' ? x.type = 'text' : x.type = 'password'; } </script> <style> .topnav { background-color: #333; overflow: hidden; text-align: center; padding: 10px 0; } .topnav h1 { margin: 0; color: #fff; font-size: large; } body { margin: 0; padding: 0; text-align: center; font-family: verdana } input, select { padding: 5px; font-size: 1em; margin: 5px 0; box-sizing: border-box } input, button, select { border-radius: .3rem; width: 100% } input[type=radio], input[type=checkbox] { width: auto } button, input[type='button'], input[type='submit'] { cursor: pointer; border: 0; background-color: #1fa3ec; color: #fff; line-height: 2.4rem; font-size: 1.2rem; width: 100% } input[type='file'] { border: 1px solid #1fa3ec } .wrap { padding-right: 4%; padding-left: 4%; padding-top: 10px; padding-bottom: 10px; text-align: left; display: inline-block; min-width: 260px; max-width: 500px } .wrap div { padding: 5px; } a { color: #000; font-weight: 700; text-decoration: none } a:hover { color: #1fa3ec; text-decoration: underline } .q { height: 16px; margin: 0; padding: 0 5px; text-align: right; min-width: 38px; float: right } .q.q-0:after { background-position-x: 0 } .q.q-1:after { background-position-x: -16px } .q.q-2:after { background-position-x: -32px } .q.q-3:after { background-position-x: -48px } .q.q-4:after { background-position-x: -64px } .q.l:before { background-position-x: -80px; padding-right: 5px } .ql .q { float: left } .q:after, .q:before { content: ''; width: 16px; height: 16px; display: inline-block; background-repeat: no-repeat; background-position: 16px 0; background-image: url('data:image/png;base64,iVBORw0KGgoAAAANSUhEUgAAAGAAAAAQCAMAAADeZIrLAAAAJFBMVEX///8AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAADHJj5lAAAAC3RSTlMAIjN3iJmqu8zd7vF8pzcAAABsSURBVHja7Y1BCsAwCASNSVo3/v+/BUEiXnIoXkoX5jAQMxTHzK9cVSnvDxwD8bFx8PhZ9q8FmghXBhqA1faxk92PsxvRc2CCCFdhQCbRkLoAQ3q/wWUBqG35ZxtVzW4Ed6LngPyBU2CobdIDQ5oPWI5nCUwAAAAASUVORK5CYII='); } @media (-webkit-min-device-pixel-ratio: 2), (min-resolution: 192dpi) { .q:before, .q:after { background-image: url('data:image/png;base64,iVBORw0KGgoAAAANSUhEUgAAALwAAAAgCAMAAACfM+KhAAAALVBMVEX///8AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAADAOrOgAAAADnRSTlMAESIzRGZ3iJmqu8zd7gKjCLQAAACmSURBVHgB7dDBCoMwEEXRmKlVY3L//3NLhyzqIqSUggy8uxnhCR5Mo8xLt+14aZ7wwgsvvPA/ofv9+44334UXXngvb6XsFhO/VoC2RsSv9J7x8BnYLW+AjT56ud/uePMdb7IP8Bsc/e7h8Cfk912ghsNXWPpDC4hvN+D1560A1QPORyh84VKLjjdvfPFm++i9EWq0348XXnjhhT+4dIbCW+WjZim9AKk4UZMnnCEuAAAAAElFTkSuQmCC'); background-size: 95px 16px; } } dt { font-weight: bold } dd { margin: 0; padding: 0 0 0.5em 0; min-height: 12px } td { vertical-align: top; } .h { display: none } button { transition: 0s opacity; transition-delay: 3s; transition-duration: 0s; cursor: pointer } button.D { background-color: #dc3630 } button:active { opacity: 50% !important; cursor: wait; transition-delay: 0s } body.invert, body.invert a, body.invert h1 { background-color: #060606; color: #fff; } body.invert { color: #fff; background-color: #282828; border-top: 1px solid #555; border-right: 1px solid #555; border-bottom: 1px solid #555; } body.invert .q[role=img] { -webkit-filter: invert(1); filter: invert(1); } :disabled { opacity: 0.5; } </style></head><body> <div class='topnav'> <h1>WiFi Manager</h1> </div> <div class='wrap'> <!-- HTML_WIFI_LIST --> <!-- <div><a href='#p' onclick='c(this)'>Wifi Chua</a><div class='q q-3 l'></div></div> --> <br> <form action='/save' method='POST' onsubmit='return validateForm();'> <label for='s'>SSID</label> <input id='s' name='s' maxlength='32' autocorrect='off' autocapitalize='none' placeholder=''> <br> <label for='p'>Password</label> <input id='p' name='p' maxlength='64' type='password' placeholder=''> <input type='checkbox' onclick='f()'>Show Password<br> <br> <button type='submit'>Save</button> </form> <br> <form action='/' method='POST'> <input type='hidden' name='refresh' value='1'> <button type='submit'>Refresh</button> </form> </div></body></html>";
+const char HTML_CONFIG_WIFI_HEAD[] PROGMEM = "<!DOCTYPE html><html lang='en'><head> <meta name='format-detection' content='telephone=no'> <meta charset='UTF-8'> <meta name='viewport' content='width=device-width,initial-scale=1,user-scalable=no' /> <title>Config WiFi</title> <link rel='stylesheet' href='/style.css'> <script src='/script.js' defer></script></head><body> <div class='topnav'> <h1>WiFi Manager</h1> </div> <div class='wrap'> <div id='l'>";
+const char HTML_CONFIG_WIFI_FORM[] PROGMEM = "</div> <!-- <div><a href='#p' onclick='c(this)'>Wifi Chua</a><div class='q q-3 l'></div></div> --> <br> <form action='/save' method='POST' onsubmit='return validateForm();'> <label for='s'>SSID</label> <input id='s' name='s' maxlength='32' autocorrect='off' autocapitalize='none' placeholder=''> <br> <label for='p'>Password</label> <input id='p' name='p' maxlength='64' type='password' placeholder=''> <input type='checkbox' onclick='f()'>Show Password<br> <br> ";
+const char HTML_CONFIG_WIFI_TAIL[] PROGMEM = " <button type='submit'>Save</button> </form> <br> <button type='button' onclick='r()'>Refresh</button> </div></body></html>";
+
+const char HTML_CONFIG_SUCCESS_ETAG[] PROGMEM = "\"89e60a262dd00198\"";
+const size_t HTML_CONFIG_SUCCESS_GZ_LEN = 526;
+const uint8_t HTML_CONFIG_SUCCESS_GZ[] PROGMEM = {
+  0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x85, 0x54,
+  0xc1, 0x8e, 0xd3, 0x30, 0x10, 0xfd, 0x95, 0xe1, 0xe4, 0x54, 0xb4, 0x49,
+  0x7b, 0x43, 0x6c, 0x12, 0x09, 0xca, 0x56, 0xda, 0x13, 0x15, 0x2a, 0x42,
+  0x1c, 0xdd, 0x78, 0x92, 0x18, 0x39, 0x76, 0x64, 0x4f, 0x5a, 0x22, 0xc4,
+  0xbf, 0x33, 0x4e, 0xba, 0xbb, 0x68, 0xb7, 0x85, 0x4b, 0x54, 0xdb, 0x6f,
+  0xde, 0x7b, 0x33, 0x7e, 0x6e, 0xfe, 0xe6, 0xd3, 0xe7, 0xed, 0xe1, 0xfb,
+  0xfe, 0x1e, 0x5a, 0xea, 0x4c, 0x99, 0xc7, 0x2f, 0x18, 0x69, 0x9b, 0x42,
+  0xa0, 0x15, 0xbc, 0x46, 0xa9, 0x4a, 0xc8, 0x3b, 0x24, 0x09, 0x55, 0x2b,
+  0x7d, 0x40, 0x2a, 0xc4, 0xd7, 0xc3, 0x6e, 0xf5, 0x4e, 0x3c, 0x6e, 0x5b,
+  0xd9, 0x61, 0x21, 0x4e, 0x1a, 0xcf, 0xbd, 0xf3, 0x24, 0xa0, 0x72, 0x96,
+  0xd0, 0x32, 0xec, 0xac, 0x15, 0xb5, 0x85, 0xc2, 0x93, 0xae, 0x70, 0x35,
+  0x2d, 0x96, 0xa0, 0xad, 0x26, 0x2d, 0xcd, 0x2a, 0x54, 0xd2, 0x60, 0xb1,
+  0x49, 0xd7, 0x91, 0x86, 0x34, 0x19, 0x2c, 0xb7, 0xce, 0xd6, 0xba, 0x81,
+  0x6f, 0x7a, 0xa7, 0xf3, 0x6c, 0xde, 0xca, 0xb3, 0x49, 0x3f, 0x3f, 0x3a,
+  0x35, 0x32, 0xae, 0xdd, 0x94, 0xf1, 0x94, 0x49, 0x6a, 0xe7, 0x3b, 0x49,
+  0xda, 0x59, 0x68, 0x65, 0x80, 0x23, 0xa2, 0x85, 0x20, 0x4f, 0xa8, 0x52,
+  0xae, 0xd8, 0x30, 0xb2, 0x07, 0xad, 0x0a, 0xd1, 0x89, 0xf2, 0x43, 0xdf,
+  0x9b, 0x51, 0xdb, 0x99, 0xf6, 0xef, 0xc2, 0x34, 0x65, 0x6c, 0xcf, 0x50,
+  0x09, 0xad, 0xc7, 0xba, 0x10, 0x99, 0x28, 0xbf, 0x20, 0x0d, 0xde, 0x02,
+  0xb9, 0xd8, 0x03, 0x7b, 0x19, 0xfc, 0xac, 0xd1, 0xcb, 0x06, 0xf3, 0x4c,
+  0x32, 0x38, 0x54, 0x5e, 0xf7, 0x54, 0x42, 0x3d, 0xd8, 0x6a, 0x3a, 0x1a,
+  0x92, 0x05, 0xfc, 0x82, 0x1a, 0xa9, 0x6a, 0x13, 0x91, 0x05, 0x92, 0x34,
+  0x84, 0xf4, 0x47, 0x70, 0x56, 0x2c, 0x52, 0x6a, 0xd1, 0x26, 0x4f, 0xc8,
+  0xc4, 0x63, 0x88, 0x58, 0x3f, 0x8b, 0xf0, 0x6a, 0xc2, 0x25, 0x8b, 0x3b,
+  0xf8, 0xfd, 0x0a, 0x3b, 0x21, 0x4f, 0xd2, 0x43, 0x07, 0x05, 0x28, 0x57,
+  0x0d, 0x1d, 0x4f, 0x34, 0x6d, 0x90, 0xee, 0x0d, 0xc6, 0x9f, 0x1f, 0xc7,
+  0x07, 0x95, 0x70, 0x7f, 0x5c, 0xac, 0x6b, 0x86, 0xa7, 0x01, 0x8a, 0x02,
+  0x04, 0xdb, 0xb6, 0xc8, 0x14, 0xb6, 0x11, 0x91, 0xa0, 0x4b, 0x09, 0x7f,
+  0xd2, 0x76, 0xbe, 0x0f, 0x26, 0x12, 0xdb, 0xa7, 0xf3, 0xd8, 0xa4, 0x80,
+  0xb7, 0x10, 0x52, 0xcb, 0x5f, 0xc1, 0xd3, 0x10, 0x77, 0xc0, 0x97, 0x7b,
+  0xd0, 0x1d, 0xba, 0x81, 0x92, 0x61, 0x09, 0x9b, 0xf5, 0x7a, 0x1d, 0xcd,
+  0x01, 0x9a, 0x80, 0xd7, 0x64, 0x50, 0xfd, 0x53, 0x05, 0xd5, 0x0b, 0x91,
+  0x25, 0x3c, 0xec, 0x41, 0x2a, 0xc5, 0xad, 0x87, 0xcb, 0xbe, 0x9e, 0xc4,
+  0xe1, 0xd0, 0xe2, 0x95, 0x91, 0xc3, 0x59, 0x1b, 0x03, 0x95, 0x71, 0x01,
+  0xa3, 0xbb, 0x2b, 0x46, 0x6a, 0xa9, 0xcd, 0x2d, 0x17, 0xbb, 0xe9, 0xec,
+  0x72, 0x99, 0xd1, 0xcf, 0x0b, 0x37, 0xef, 0x2f, 0x0b, 0x9c, 0x2d, 0xec,
+  0x0d, 0x4a, 0x66, 0x27, 0x3f, 0x82, 0x6c, 0xa4, 0xb6, 0xaf, 0x14, 0xbb,
+  0x49, 0x51, 0xc6, 0x3c, 0x4d, 0x82, 0xff, 0x1f, 0xd6, 0x5c, 0x11, 0x73,
+  0x79, 0xdd, 0xe1, 0xed, 0x2c, 0x47, 0x15, 0xcd, 0x69, 0x7e, 0xf6, 0x70,
+  0xa5, 0x3c, 0x0e, 0x6d, 0x7e, 0x5c, 0xf3, 0xa0, 0x3c, 0x1e, 0x9d, 0x23,
+  0x90, 0x03, 0xb9, 0xc8, 0xc7, 0x0f, 0xcc, 0x8c, 0x33, 0x03, 0xe7, 0xab,
+  0x92, 0x31, 0xa1, 0xcf, 0x01, 0xbb, 0xdd, 0xc1, 0xd4, 0xc5, 0x10, 0x63,
+  0x99, 0x67, 0x97, 0xb8, 0xe7, 0xd9, 0xf4, 0x00, 0xf9, 0x6d, 0xc5, 0xff,
+  0x88, 0x3f, 0x25, 0xf3, 0x31, 0xd6, 0x33, 0x04, 0x00, 0x00
+};
+
+const char STYLE_CSS_ETAG[] PROGMEM = "\"5021735b8ca9a5af\"";
+const size_t STYLE_CSS_GZ_LEN = 1445;
+const uint8_t STYLE_CSS_GZ[] PROGMEM = {
+  0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0xa5, 0x56,
+  0x59, 0x73, 0xe2, 0x38, 0x10, 0xfe, 0x2b, 0xde, 0x9a, 0x9a, 0x22, 0x53,
+  0x04, 0x30, 0xd8, 0x06, 0x03, 0x35, 0x55, 0x0b, 0x06, 0x32, 0x04, 0x48,
+  0x38, 0xc2, 0x91, 0xcc, 0xce, 0x83, 0x6c, 0x09, 0x5b, 0x60, 0x5b, 0xc6,
+  0x17, 0x26, 0x5b, 0xfc, 0xf7, 0x95, 0x7c, 0x70, 0x64, 0x32, 0x93, 0xad,
+  0x5d, 0x78, 0x40, 0xb4, 0xfa, 0x52, 0x7f, 0x9f, 0x5a, 0x5d, 0xf4, 0x89,
+  0x63, 0x83, 0x90, 0xfb, 0x9b, 0x53, 0x81, 0xb6, 0xd5, 0x5d, 0x12, 0xd8,
+  0xb0, 0xa0, 0x11, 0x93, 0xb8, 0x0d, 0xee, 0x93, 0x20, 0x08, 0x4d, 0x8e,
+  0x84, 0xc8, 0x5d, 0x9b, 0x64, 0xdf, 0xe0, 0x0c, 0x0c, 0x21, 0xb2, 0x9b,
+  0x9c, 0x8f, 0x22, 0xbf, 0x00, 0x4c, 0xac, 0xdb, 0x0d, 0x4e, 0x43, 0xb6,
+  0x8f, 0xdc, 0x26, 0xe7, 0x00, 0x08, 0xb1, 0xad, 0x37, 0xb8, 0x32, 0xef,
+  0x44, 0x1c, 0xdf, 0x3c, 0x16, 0x53, 0xc7, 0x46, 0x99, 0xfa, 0xb6, 0x80,
+  0xab, 0x63, 0xaa, 0xcd, 0x37, 0xb9, 0xcc, 0xf7, 0x7a, 0xbd, 0x6e, 0x72,
+  0x6b, 0x62, 0xfb, 0x05, 0x0f, 0xbf, 0xa2, 0x06, 0x67, 0x52, 0x15, 0xd4,
+  0x3c, 0xaa, 0x04, 0x1e, 0xae, 0x0d, 0x4e, 0x9e, 0xf9, 0xf7, 0x23, 0xc7,
+  0x3e, 0xd6, 0xc0, 0xc2, 0xe6, 0xa1, 0xc1, 0xd1, 0x5c, 0x21, 0xb0, 0xc1,
+  0x11, 0xdb, 0x4e, 0xe0, 0xdf, 0x7a, 0xc8, 0x44, 0x9a, 0x4f, 0xdd, 0x9d,
+  0x7c, 0x48, 0x4e, 0x74, 0x15, 0xb5, 0x8c, 0xac, 0xe6, 0x29, 0x98, 0x14,
+  0x67, 0xce, 0xa9, 0x24, 0x62, 0xbb, 0xb1, 0xbe, 0x4a, 0x5c, 0x88, 0xdc,
+  0x02, 0x15, 0xa5, 0x2e, 0xd5, 0xc0, 0xf7, 0x89, 0x7d, 0xf6, 0x9c, 0x2a,
+  0xb8, 0x00, 0xe2, 0xc0, 0x6b, 0x70, 0x45, 0xc1, 0x65, 0x1e, 0xf7, 0x18,
+  0xfa, 0x06, 0xab, 0x05, 0xff, 0x39, 0xb1, 0xfb, 0xee, 0x1f, 0x1c, 0xf4,
+  0x95, 0x69, 0x91, 0x1f, 0xb7, 0x17, 0x12, 0xcd, 0x40, 0xda, 0x96, 0x7a,
+  0xff, 0x41, 0x5d, 0xa5, 0x46, 0x20, 0xf0, 0xc9, 0x31, 0x0d, 0x73, 0xa1,
+  0x99, 0x4b, 0x44, 0xb9, 0x2b, 0xf3, 0x9c, 0x17, 0xa8, 0x16, 0xf6, 0x73,
+  0xcc, 0x5c, 0x0b, 0x5c, 0x8f, 0x55, 0xd6, 0x21, 0x38, 0x29, 0x4c, 0x92,
+  0x5a, 0x5c, 0xb7, 0x77, 0xb0, 0x2d, 0xaf, 0x81, 0x80, 0xb4, 0x37, 0x78,
+  0x98, 0xd8, 0x46, 0x05, 0x03, 0x61, 0xdd, 0xf0, 0x1b, 0x5c, 0xa5, 0x28,
+  0xc6, 0x87, 0xb9, 0x2c, 0x57, 0xb1, 0xf2, 0xbb, 0xf3, 0xe5, 0xd6, 0xd8,
+  0x44, 0x71, 0x32, 0x59, 0xec, 0x32, 0x2d, 0xa9, 0x47, 0x4c, 0x0c, 0xb3,
+  0x80, 0xc7, 0xe2, 0xde, 0x05, 0xce, 0x19, 0x92, 0x82, 0x9b, 0x04, 0x13,
+  0x3f, 0x9f, 0x90, 0x2e, 0x98, 0x68, 0xfd, 0x46, 0x42, 0xb9, 0x94, 0x30,
+  0xeb, 0x2c, 0x52, 0x09, 0x2d, 0x87, 0x95, 0x49, 0x2f, 0x89, 0xc1, 0xcc,
+  0x9b, 0x1c, 0xc4, 0x9e, 0x63, 0x02, 0x4a, 0x09, 0x6c, 0xc7, 0xa7, 0x52,
+  0x4d, 0xa2, 0x6d, 0x29, 0xd6, 0xd8, 0x2e, 0xa4, 0xd9, 0x57, 0xaa, 0xb1,
+  0xa9, 0x05, 0xa2, 0x4c, 0x22, 0xf1, 0x54, 0x92, 0x66, 0x08, 0x71, 0xf8,
+  0x96, 0x38, 0xe9, 0xce, 0x27, 0xf3, 0x72, 0x83, 0x52, 0x1d, 0xb0, 0xea,
+  0xa7, 0x65, 0xe4, 0x79, 0x3e, 0xad, 0xd8, 0x3e, 0x2d, 0x63, 0x8d, 0xcf,
+  0x88, 0x0b, 0x91, 0x46, 0x5c, 0xe0, 0x63, 0x42, 0x93, 0xb4, 0x89, 0x8d,
+  0x8e, 0xa0, 0x61, 0xb0, 0xdb, 0x75, 0x61, 0x9e, 0xa1, 0xf2, 0x93, 0x3e,
+  0x85, 0x0e, 0xb9, 0xec, 0x20, 0x47, 0x50, 0xf4, 0x1a, 0x60, 0xed, 0xa7,
+  0x66, 0x14, 0x6a, 0x9b, 0x06, 0xc9, 0x71, 0x7f, 0x55, 0x6a, 0x65, 0x21,
+  0xd7, 0x7c, 0xe3, 0xe9, 0x58, 0xdc, 0x51, 0xb5, 0x0c, 0xd1, 0x72, 0x35,
+  0x39, 0xf0, 0x3b, 0x77, 0x2b, 0xb9, 0x19, 0x97, 0x65, 0x8c, 0x81, 0xb9,
+  0x2a, 0x98, 0x20, 0xc7, 0xb7, 0xc7, 0x24, 0xc0, 0x4f, 0xb7, 0xa9, 0xfb,
+  0xe2, 0xae, 0xc0, 0x9f, 0xf2, 0xb9, 0xe0, 0x99, 0x43, 0x3c, 0xcc, 0x52,
+  0x2f, 0x44, 0xd4, 0x7b, 0xa2, 0x57, 0xfe, 0x48, 0xaf, 0xc0, 0x12, 0x4c,
+  0x74, 0x2b, 0x1f, 0xea, 0x0a, 0x95, 0x4c, 0x57, 0xf8, 0x50, 0x57, 0x94,
+  0x33, 0x5d, 0xf1, 0x43, 0xdd, 0xaa, 0x98, 0xe8, 0x9a, 0x0d, 0x15, 0xad,
+  0x89, 0x8b, 0x7e, 0xa3, 0x2a, 0x5f, 0x31, 0x32, 0x65, 0xb2, 0x14, 0x9b,
+  0x9b, 0x5c, 0x5c, 0xf9, 0xb4, 0x58, 0x8c, 0x92, 0x54, 0x98, 0xc4, 0xbe,
+  0xa5, 0x8b, 0x93, 0xeb, 0x33, 0x82, 0xb9, 0xf3, 0xb5, 0x8a, 0x61, 0xba,
+  0x06, 0xed, 0x17, 0x74, 0xbe, 0xc8, 0xcc, 0x45, 0x0e, 0x62, 0xb1, 0x6c,
+  0x92, 0x2e, 0x9b, 0xef, 0xe5, 0x9d, 0xf8, 0x7b, 0xd3, 0x13, 0xb0, 0x05,
+  0x74, 0x7a, 0xbb, 0x03, 0xd7, 0xbc, 0xc9, 0x41, 0xe0, 0x83, 0x46, 0x2c,
+  0x28, 0x39, 0xb6, 0xde, 0x54, 0x81, 0x87, 0xaa, 0xe2, 0x2d, 0x5e, 0xb4,
+  0x1f, 0xa7, 0x7b, 0x7e, 0x70, 0xa7, 0x93, 0x16, 0xfd, 0x3c, 0xcc, 0xe6,
+  0x46, 0x77, 0xae, 0xd3, 0xd5, 0x1d, 0xfb, 0xdb, 0x9a, 0x28, 0xad, 0x11,
+  0xfd, 0xe9, 0xa0, 0x97, 0xbe, 0x3b, 0x64, 0x82, 0xfb, 0x5e, 0x7b, 0xb4,
+  0xe8, 0xae, 0x4a, 0xa5, 0x92, 0xdc, 0xfa, 0xf7, 0x9f, 0xce, 0xb7, 0xfb,
+  0x8d, 0x64, 0xb2, 0x95, 0x22, 0x4c, 0x67, 0x4f, 0xe6, 0xa8, 0xd5, 0xdf,
+  0x3c, 0x08, 0xf8, 0xde, 0xda, 0x05, 0xf2, 0x2b, 0xac, 0x85, 0x3d, 0xd9,
+  0x79, 0xd5, 0xe8, 0x6e, 0xdb, 0x9b, 0xcd, 0xa7, 0xed, 0xc5, 0xb7, 0x0d,
+  0xa8, 0x3d, 0x97, 0xdb, 0x8a, 0xd7, 0xda, 0x2b, 0xad, 0xd9, 0xc3, 0x6c,
+  0x41, 0x84, 0x52, 0x98, 0x2f, 0xb5, 0xe7, 0x5d, 0xbc, 0xb2, 0xfb, 0x64,
+  0xb5, 0x25, 0x2b, 0x69, 0xd3, 0x9a, 0x8c, 0xa2, 0xa7, 0x6f, 0xaf, 0x83,
+  0xba, 0xb6, 0x98, 0xd9, 0x61, 0x27, 0xda, 0x77, 0x64, 0xb5, 0x17, 0xc9,
+  0x63, 0xe3, 0xa5, 0xbe, 0x93, 0x7b, 0x96, 0x6e, 0xac, 0xda, 0xc6, 0xae,
+  0x45, 0x6f, 0x4b, 0xb4, 0xad, 0x57, 0xc6, 0x5e, 0x14, 0x4e, 0xb5, 0x8a,
+  0xa2, 0x28, 0x3d, 0x68, 0x4c, 0x14, 0x75, 0xba, 0x1d, 0x92, 0xd6, 0x44,
+  0xd8, 0x95, 0xf6, 0xcb, 0x79, 0x7b, 0x77, 0x27, 0x48, 0x2f, 0x91, 0xbf,
+  0x78, 0x5d, 0x8a, 0x5d, 0x58, 0x1d, 0xda, 0xfa, 0xf8, 0xd0, 0x9e, 0x57,
+  0x14, 0xa2, 0xc2, 0x7e, 0x67, 0x22, 0x91, 0xf1, 0xb2, 0x2f, 0xd9, 0xca,
+  0x7c, 0x1f, 0x9f, 0x64, 0x36, 0x5f, 0x3c, 0x4e, 0x07, 0x92, 0xf2, 0xdc,
+  0xef, 0x7f, 0xcd, 0x7d, 0x69, 0x1e, 0xff, 0xb4, 0x10, 0xc4, 0x80, 0xbb,
+  0xa1, 0x5d, 0x41, 0xdd, 0x62, 0xbf, 0xc0, 0x6e, 0x15, 0x44, 0x21, 0xd6,
+  0x50, 0xc1, 0xc1, 0x11, 0x32, 0x0b, 0xf1, 0x3d, 0xa7, 0x3d, 0xe9, 0xcb,
+  0xed, 0x0d, 0xdb, 0x73, 0x11, 0xed, 0x9a, 0x41, 0x0a, 0x58, 0xbd, 0x02,
+  0x1d, 0xfc, 0x85, 0x92, 0xe5, 0x44, 0x9c, 0x5b, 0x2e, 0x23, 0xd3, 0x35,
+  0x3b, 0xff, 0x07, 0x90, 0xc3, 0x38, 0x71, 0x3d, 0x01, 0x52, 0x59, 0x8f,
+  0xf2, 0x03, 0x83, 0x09, 0x86, 0x8b, 0xff, 0x02, 0xe4, 0x15, 0xa8, 0xad,
+  0x47, 0xf7, 0x51, 0x8f, 0x57, 0x76, 0x02, 0x6a, 0x77, 0xd6, 0x7f, 0x9d,
+  0xde, 0xbd, 0x9c, 0x81, 0xd5, 0x07, 0x1b, 0x65, 0x38, 0x61, 0x71, 0xad,
+  0x04, 0x58, 0xbd, 0x5d, 0x83, 0x9d, 0xb6, 0x42, 0x46, 0xfb, 0x6e, 0x77,
+  0x35, 0xb5, 0x06, 0xe6, 0xe2, 0x59, 0x18, 0x96, 0x4a, 0xc2, 0xc3, 0xd0,
+  0x38, 0xbc, 0xee, 0xfa, 0xbb, 0xd9, 0x5c, 0xd7, 0x0f, 0x72, 0x10, 0xd9,
+  0x86, 0x32, 0x95, 0x46, 0x44, 0x8e, 0x86, 0x7e, 0xbe, 0x2c, 0x82, 0x97,
+  0xda, 0x7e, 0xaf, 0x7b, 0x61, 0x38, 0x6e, 0x95, 0xc8, 0x3a, 0xac, 0xe7,
+  0x45, 0x51, 0x10, 0xc4, 0xf9, 0x6a, 0x65, 0xeb, 0xa1, 0x5a, 0x5d, 0x79,
+  0x3d, 0xe3, 0xb1, 0xb4, 0x20, 0x4a, 0x65, 0xea, 0xcd, 0xc2, 0xfa, 0x7d,
+  0x2d, 0x92, 0xdb, 0xf6, 0xf3, 0x70, 0x99, 0x6f, 0x6d, 0x9e, 0xa4, 0x6a,
+  0x00, 0x4b, 0x01, 0x1a, 0x8f, 0xa0, 0x5a, 0xeb, 0x8f, 0xe5, 0xb6, 0xa7,
+  0x95, 0x50, 0xcd, 0x90, 0x95, 0xf5, 0xb6, 0x5e, 0xae, 0xe8, 0x86, 0xf7,
+  0xb0, 0x5a, 0x8e, 0x9d, 0x8e, 0x22, 0x1a, 0xe1, 0x43, 0xbe, 0x53, 0x96,
+  0xaa, 0x7c, 0xab, 0x3c, 0x19, 0x3f, 0x4e, 0x0f, 0x86, 0x2c, 0x2e, 0x06,
+  0xc3, 0xcd, 0x06, 0x86, 0xeb, 0x71, 0xcf, 0xca, 0xe7, 0x71, 0xbd, 0xbb,
+  0xdc, 0xf1, 0x82, 0x28, 0xd3, 0x98, 0x1b, 0xc3, 0x78, 0xca, 0x8b, 0xb0,
+  0xaf, 0x2a, 0xcb, 0xfc, 0x72, 0xf3, 0x82, 0xad, 0x7a, 0x6b, 0xb0, 0x15,
+  0xe7, 0x2f, 0x23, 0xdb, 0x56, 0xba, 0x41, 0x5c, 0x9a, 0xae, 0xd9, 0x7b,
+  0xda, 0xce, 0x82, 0x89, 0xa5, 0x28, 0x94, 0x24, 0x97, 0x40, 0x26, 0xcf,
+  0x6d, 0x9d, 0x4d, 0x24, 0xc9, 0xfd, 0x3f, 0x1e, 0x21, 0x1b, 0x37, 0xae,
+  0x5e, 0x16, 0x95, 0x98, 0xf0, 0x08, 0xe1, 0xaf, 0xc6, 0x25, 0xf6, 0x2d,
+  0x4a, 0xc8, 0x62, 0x52, 0xc6, 0xa9, 0x53, 0x43, 0x61, 0x8d, 0xd3, 0x67,
+  0x66, 0xf4, 0xed, 0xf1, 0xb1, 0x06, 0xcc, 0xac, 0xe5, 0xd3, 0x67, 0x96,
+  0x3e, 0x72, 0x06, 0xdd, 0x39, 0xb5, 0x9b, 0xf8, 0x9d, 0x4a, 0x46, 0x0f,
+  0x2a, 0xf6, 0x5d, 0x60, 0x67, 0x7d, 0x84, 0xf7, 0x38, 0xe2, 0x00, 0x0d,
+  0xfb, 0x87, 0xe6, 0x85, 0x9c, 0xb2, 0x3a, 0xb6, 0x13, 0xbc, 0x6b, 0x69,
+  0x90, 0x3d, 0x64, 0x3c, 0xdd, 0x78, 0x33, 0xaa, 0xa4, 0xfe, 0x8b, 0x9d,
+  0xf7, 0xa7, 0x50, 0xa8, 0x09, 0x55, 0x81, 0x4f, 0x95, 0x1a, 0x40, 0xf3,
+  0x71, 0xc8, 0x3a, 0x67, 0x1a, 0x9c, 0xbd, 0xda, 0x9f, 0xb9, 0x3f, 0xb0,
+  0xe5, 0x10, 0xd7, 0x07, 0xb6, 0x7f, 0xf6, 0xbe, 0x07, 0xd8, 0x7f, 0x2f,
+  0x35, 0xde, 0x8b, 0xa7, 0xcc, 0x22, 0xb6, 0xd9, 0xf9, 0x6f, 0x2f, 0xd6,
+  0x1c, 0xb8, 0xfa, 0x17, 0x8f, 0xae, 0xef, 0x24, 0xc4, 0x57, 0xd9, 0xf7,
+  0x7a, 0x74, 0xba, 0x74, 0x79, 0xf1, 0x9e, 0xc7, 0x53, 0xd5, 0x3b, 0x2e,
+  0x2a, 0x32, 0xfb, 0x66, 0x33, 0x5a, 0x3a, 0xdf, 0x9c, 0x67, 0x25, 0x49,
+  0x92, 0x4e, 0x7b, 0xe9, 0xb3, 0xf2, 0x8b, 0xdd, 0xd3, 0x18, 0x74, 0xbd,
+  0x7d, 0x95, 0x4e, 0x71, 0xf7, 0xdd, 0x25, 0x26, 0xfa, 0x8a, 0x2d, 0x9d,
+  0xcd, 0x66, 0x59, 0x0f, 0xa2, 0xc3, 0x9a, 0xcf, 0x66, 0xb4, 0x44, 0xeb,
+  0xa6, 0x4c, 0x19, 0xf8, 0xb3, 0xe8, 0xd8, 0xa0, 0x54, 0x00, 0xaa, 0x89,
+  0xe0, 0x65, 0xc9, 0x29, 0xaf, 0x9a, 0xc7, 0x7f, 0x00, 0x31, 0x5f, 0xfe,
+  0x17, 0x3b, 0x0c, 0x00, 0x00
+};
+
+const char SCRIPT_JS_ETAG[] PROGMEM = "\"fa33f254671f3599\"";
+const size_t SCRIPT_JS_GZ_LEN = 545;
+const uint8_t SCRIPT_JS_GZ[] PROGMEM = {
+  0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x85, 0x53,
+  0x61, 0x6b, 0xdb, 0x30, 0x10, 0xfd, 0x2b, 0x57, 0xf6, 0x41, 0x0a, 0xdb,
+  0xd4, 0x8d, 0x7e, 0x29, 0x73, 0xd2, 0x42, 0xbb, 0x8e, 0x05, 0xba, 0x52,
+  0x48, 0xff, 0x80, 0x22, 0x9f, 0x63, 0x2d, 0x8a, 0x6c, 0x4b, 0x72, 0x93,
+  0xb2, 0xe6, 0xbf, 0xef, 0xa4, 0xc4, 0x71, 0x42, 0xc1, 0x31, 0xd8, 0x48,
+  0xe7, 0x77, 0x4f, 0xef, 0xde, 0x9d, 0x8a, 0xd6, 0xaa, 0xa0, 0x2b, 0x0b,
+  0xaf, 0xd2, 0xe8, 0x5c, 0x06, 0xfc, 0x55, 0xb9, 0x15, 0x1f, 0xc1, 0x3f,
+  0x0a, 0x38, 0xf0, 0x5e, 0xe7, 0x30, 0x81, 0xbc, 0x52, 0xed, 0x0a, 0x6d,
+  0x10, 0x0b, 0x0c, 0x0f, 0x06, 0xe3, 0xf2, 0xee, 0x6d, 0x9a, 0x73, 0xe6,
+  0xd9, 0x48, 0x50, 0x62, 0x8b, 0x59, 0x82, 0xd7, 0xd2, 0xfb, 0x75, 0xe5,
+  0x06, 0x53, 0xea, 0x3e, 0x45, 0x17, 0xc0, 0xe3, 0x09, 0xc2, 0xa0, 0x5d,
+  0x84, 0x12, 0xc6, 0x70, 0x15, 0x0f, 0x96, 0x06, 0x5d, 0xe0, 0x6c, 0x36,
+  0x9b, 0xfe, 0x84, 0x55, 0xeb, 0x03, 0xcc, 0x11, 0x64, 0x00, 0x83, 0x92,
+  0xd6, 0x57, 0xa0, 0x4a, 0xe9, 0xa4, 0x0a, 0xe8, 0xbc, 0x60, 0xa3, 0x0c,
+  0x1c, 0x86, 0xd6, 0x59, 0x28, 0xa4, 0xf1, 0x44, 0xb9, 0x4d, 0xa4, 0x9d,
+  0x8e, 0x9e, 0xf8, 0xfa, 0x88, 0xf8, 0xb9, 0x53, 0xf9, 0x81, 0xfc, 0xfa,
+  0x1c, 0xf9, 0x7e, 0x1f, 0x1c, 0xc9, 0xdf, 0x16, 0x9d, 0x75, 0x8a, 0x9b,
+  0x48, 0x7f, 0xde, 0x25, 0xf2, 0xc5, 0x08, 0x6d, 0x2d, 0xba, 0x17, 0xdc,
+  0x04, 0x78, 0x7f, 0xa7, 0x6d, 0xa0, 0xd5, 0x7d, 0x65, 0x03, 0xa1, 0x33,
+  0xa8, 0x13, 0xc2, 0x52, 0x68, 0x4f, 0x30, 0xd3, 0x73, 0xa3, 0xed, 0x42,
+  0x28, 0x43, 0xa2, 0x1f, 0xb5, 0x0f, 0x42, 0x11, 0x56, 0x6a, 0xeb, 0x39,
+  0x33, 0x51, 0xe1, 0xa0, 0xcf, 0xb9, 0xf6, 0x72, 0x6e, 0x30, 0xf6, 0xe3,
+  0xa2, 0xde, 0xf9, 0x5d, 0x0f, 0x2a, 0x8d, 0x49, 0x05, 0xfd, 0xf4, 0x9c,
+  0xa8, 0xb7, 0x7d, 0x85, 0xc5, 0x61, 0x22, 0x36, 0x67, 0x7a, 0x9b, 0xc1,
+  0x46, 0x84, 0xb7, 0x9a, 0x4a, 0x9d, 0x4c, 0x80, 0x75, 0x8d, 0x60, 0x70,
+  0x7b, 0x88, 0x03, 0x8b, 0x25, 0x33, 0xf8, 0x71, 0x14, 0x39, 0xe0, 0x8e,
+  0x5c, 0x75, 0xe9, 0xcc, 0x02, 0x83, 0x2a, 0x39, 0xbb, 0xf4, 0x4a, 0x5a,
+  0xf1, 0xd7, 0x57, 0x96, 0x14, 0x86, 0x12, 0x2d, 0x3f, 0xe0, 0xb8, 0x43,
+  0x1f, 0x91, 0xfb, 0xde, 0xd0, 0x2e, 0xe1, 0x52, 0x05, 0x1f, 0xb0, 0xb6,
+  0xab, 0xc3, 0x0c, 0xd5, 0x91, 0x9c, 0xdd, 0x77, 0xea, 0xf7, 0xcb, 0x9f,
+  0x47, 0xc2, 0xda, 0x6e, 0x96, 0x6e, 0x81, 0x45, 0xed, 0x6c, 0x6c, 0xe4,
+  0x1c, 0xcd, 0xcd, 0x53, 0x05, 0x16, 0x03, 0x69, 0x5f, 0x7a, 0x28, 0xaa,
+  0xd6, 0xe6, 0xe3, 0xcb, 0xdd, 0x8f, 0xf1, 0xdc, 0xdd, 0xb0, 0x8c, 0xf2,
+  0x8a, 0xca, 0x3d, 0x48, 0xaa, 0xa1, 0x17, 0xb1, 0xee, 0x44, 0x9c, 0x5c,
+  0x14, 0xe5, 0x90, 0xae, 0xdf, 0x5e, 0x07, 0x67, 0xb9, 0x7e, 0x8d, 0x2a,
+  0x22, 0x4c, 0x0e, 0xc0, 0x64, 0x07, 0x6a, 0xce, 0x73, 0x49, 0x51, 0x3a,
+  0x2c, 0xa2, 0xdf, 0x9f, 0x6a, 0x16, 0xb7, 0x47, 0xb3, 0x47, 0xd1, 0xb5,
+  0xf0, 0xbb, 0x19, 0x59, 0x8b, 0x65, 0xba, 0x2e, 0xbb, 0xa9, 0x7b, 0x92,
+  0xab, 0xd4, 0x23, 0xcf, 0xe2, 0x0d, 0x90, 0xa2, 0xb2, 0xca, 0x68, 0xb5,
+  0xa4, 0x50, 0x5f, 0x51, 0x84, 0x2b, 0x2e, 0xa3, 0xe5, 0x19, 0x34, 0xa7,
+  0x79, 0x0d, 0x34, 0x5f, 0x19, 0x7c, 0x26, 0xfa, 0x86, 0xbe, 0x44, 0x6e,
+  0xa2, 0x87, 0x60, 0x92, 0x8b, 0x69, 0x84, 0x85, 0xac, 0x6b, 0xb4, 0xf9,
+  0x7d, 0xa9, 0x4d, 0x9e, 0x48, 0x4e, 0x23, 0x4d, 0x6a, 0xc6, 0x71, 0x24,
+  0x4f, 0xbd, 0x4d, 0xef, 0xd6, 0x63, 0x98, 0x52, 0x05, 0x8e, 0x2e, 0x18,
+  0x77, 0x5f, 0xe0, 0xfb, 0x37, 0x7a, 0x46, 0xd9, 0x7f, 0x01, 0xbb, 0x81,
+  0x99, 0xd7, 0x04, 0x00, 0x00
+};
@@ -2,7 +2,13 @@
 
 DEST_FILE=HtmlResource.h
 TMP_FILE=tmp.html
-SOURCE_FILES=("html_config_success.html" "html_config_wifi.html")
+GZIP_TMP_FILE=tmp.gz
+SOURCE_FILES=("html_config_wifi.html")
+# Static files are stored gzip compressed and served with an ETag
+GZIP_SOURCE_FILES=("html_config_success.html" "style.css" "script.js")
+# The page is streamed in parts, so it is split at these markers at build time
+WIFI_LIST_MARKER="<!-- HTML_WIFI_LIST -->"
+PARAMS_MARKER="<!-- HTML_PARAMS -->"
 
 remove_unsupport_character() {
     tr -d '\r\n' < $1 > ${TMP_FILE}
@@ -15,6 +21,16 @@ remove_unsupport_character() {
     rm -rf ${TMP_FILE}
 }
 
+get_variable_name() {
+    local name="${1%.*}"
+    local extension="${1##*.}"
+    if [[ "${extension}" != "html" ]]
+    then
+        name="${name}_${extension}"
+    fi
+    echo "${name^^}"
+}
+
 echo "#pragma once" > ${DEST_FILE}
 echo "" >> ${DEST_FILE}
 echo "#include <Arduino.h>" >> ${DEST_FILE}
@@ -23,9 +39,35 @@ echo "" >> ${DEST_FILE}
 
 for file in "${SOURCE_FILES[@]}"
 do
-    filename="${file%.*}"
-    filename="${filename^^}"
+    filename=`get_variable_name $file`
     
     content=`remove_unsupport_character $file`
-    echo "const char $filename[] PROGMEM = \"${content}\";" >> ${DEST_FILE}
-done
\ No newline at end of file
+    if [[ "${content}" == *"${WIFI_LIST_MARKER}"* ]]
+    then
+        echo "const char ${filename}_HEAD[] PROGMEM = \"${content%%${WIFI_LIST_MARKER}*}\";" >> ${DEST_FILE}
+        content="${content#*${WIFI_LIST_MARKER}}"
+        if [[ "${content}" == *"${PARAMS_MARKER}"* ]]
+        then
+            echo "const char ${filename}_FORM[] PROGMEM = \"${content%%${PARAMS_MARKER}*}\";" >> ${DEST_FILE}
+            content="${content#*${PARAMS_MARKER}}"
+        fi
+        echo "const char ${filename}_TAIL[] PROGMEM = \"${content}\";" >> ${DEST_FILE}
+    else
+        echo "const char $filename[] PROGMEM = \"${content}\";" >> ${DEST_FILE}
+    fi
+done
+
+for file in "${GZIP_SOURCE_FILES[@]}"
+do
+    filename=`get_variable_name $file`
+
+    remove_unsupport_character $file | gzip -9 -n > ${GZIP_TMP_FILE}
+    hash=`md5sum ${GZIP_TMP_FILE} | cut -c1-16`
+    echo "" >> ${DEST_FILE}
+    echo "const char ${filename}_ETAG[] PROGMEM = \"\\\"${hash}\\\"\";" >> ${DEST_FILE}
+    echo "const size_t ${filename}_GZ_LEN = `stat -c %s ${GZIP_TMP_FILE}`;" >> ${DEST_FILE}
+    echo "const uint8_t ${filename}_GZ[] PROGMEM = {" >> ${DEST_FILE}
+    xxd -i < ${GZIP_TMP_FILE} >> ${DEST_FILE}
+    echo "};" >> ${DEST_FILE}
+    rm -rf ${GZIP_TMP_FILE}
+done
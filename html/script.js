@@ -0,0 +1,51 @@
+function validateForm() {
+    var ssid = document.getElementById('s').value;
+    var password = document.getElementById('p').value;
+    if (ssid.length < 3) {
+        alert("SSID must be at least 3 characters.");
+        return false;
+    }
+    if (password.length < 8) {
+        alert("Password must be at least 8 characters.");
+        return false;
+    }
+    return true;
+}
+function c(l) {
+    document.getElementById('s').value = l.innerText || l.textContent;
+    p = l.nextElementSibling.classList.contains('l');
+    document.getElementById('p').disabled = !p;
+    if (p) {
+        document.getElementById('p').focus();
+    }
+}
+function f() {
+    var x = document.getElementById('p');
+    x.type === 'password' ? x.type = 'text' : x.type = 'password';
+}
+function r() {
+    fetch('/scan.json').then(function (res) {
+        return res.json();
+    }).then(function (n) {
+        var l = document.getElementById('l');
+        l.innerHTML = n.length ? '' : '<label>No networks found</label><br>';
+        n.forEach(function (w) {
+            var d = document.createElement('div');
+            var a = document.createElement('a');
+            var q = document.createElement('div');
+            a.href = '#p';
+            a.textContent = w.s;
+            if (w.k) {
+                a.className = 's';
+            }
+            a.onclick = function () {
+                c(a);
+            };
+            q.className = 'q q-' + w.q + (w.l ? ' l' : '');
+            d.appendChild(a);
+            d.appendChild(q);
+            l.appendChild(d);
+        });
+    });
+}
+setInterval(r, 10000);
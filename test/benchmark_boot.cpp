@@ -0,0 +1,127 @@
+#include "test.h"
+
+#include <sys/wait.h>
+
+// Time from begin() to the first WiFi.begin() on cold boots, which mount the file system and read the settings, and on
+// warm boots, which join the network kept in RTC memory. Each boot is a child process, with a fresh static state
+// like after a reset or a deep sleep
+
+#define BOOT_COUNT 21
+
+static const mock::AccessPoint HOME = {"home", "password1", {0x02, 0, 0, 0, 0, 1}, 6, -50, WIFI_AUTH_WPA2_PSK, true};
+
+struct BootResult
+{
+    bool isConnected;
+    bool isWarmBoot;          // Reported by the library
+    uint64_t beginTime;       // (us) From begin() to the first WiFi.begin()
+    mock::FileSystemStats fs; // Until the first WiFi.begin()
+};
+
+static std::string getRtcPath()
+{
+    return std::string(getTestDirectory()) + "/rtc.bin";
+}
+
+// Connect once with the settings saved in the file system, like a first boot after provisioning
+static void provision()
+{
+    AsyncWiFiManager::setWifiInformation("home", "password1");
+    AsyncWiFiManager::begin();
+    CHECK(runUntil([]()
+                   { return AsyncWiFiManager::getState() == ASYNC_WIFI_STATE_CONNECTED; },
+                   10000));
+    CHECK(mock::saveRtcMemory(getRtcPath().c_str()));
+}
+
+static BootResult boot(bool isWarm)
+{
+    BootResult result = {};
+    if (isWarm)
+    {
+        CHECK(mock::loadRtcMemory(getRtcPath().c_str()));
+    }
+    uint64_t start = mock::hostMicros();
+    AsyncWiFiManager::begin();
+    while (mock::getWiFiStats().beginCount == 0 && mock::hostMicros() - start < 1000000)
+    {
+        mock::deliverEvents();
+        AsyncWiFiManager::loop();
+    }
+    result.beginTime = mock::getWiFiStats().firstBeginTime - start;
+    result.fs = mock::getFileSystemStats();
+    result.isConnected = runUntil([]()
+                                  { return AsyncWiFiManager::getState() == ASYNC_WIFI_STATE_CONNECTED; },
+                                  10000);
+    result.isWarmBoot = AsyncWiFiManager::getConnectStats().warmBoot;
+    return result;
+}
+
+// Run function in a child process, returns its result
+template <typename Result, typename Function>
+static Result runChild(Function function)
+{
+    int fds[2];
+    CHECK(pipe(fds) == 0);
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        close(fds[0]);
+        Result result = function();
+        CHECK(write(fds[1], &result, sizeof(result)) == sizeof(result));
+        _exit(0);
+    }
+    close(fds[1]);
+    Result result = {};
+    ssize_t length = read(fds[0], &result, sizeof(result));
+    close(fds[0]);
+    int status = 0;
+    waitpid(pid, &status, 0);
+    CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    CHECK_EQ(length, sizeof(result));
+    return result;
+}
+
+static std::vector<BootResult> bootMany(bool isWarm)
+{
+    std::vector<BootResult> results;
+    for (int i = 0; i < BOOT_COUNT; i++)
+    {
+        results.push_back(runChild<BootResult>([isWarm]()
+                                               { return boot(isWarm); }));
+        CHECK(results.back().isConnected);
+        CHECK_EQ(results.back().isWarmBoot, isWarm);
+    }
+    return results;
+}
+
+static void printResults(const char *name, std::vector<BootResult> &results)
+{
+    std::vector<unsigned long> times;
+    for (const BootResult &result : results)
+    {
+        times.push_back(result.beginTime);
+    }
+    printf("%s boot: begin() to WiFi.begin() median %lu us, max %lu us, %u mounts, %u opens, %u bytes read\n", name,
+           getPercentile(times, 50), getPercentile(times, 100), results[0].fs.mountCount, results[0].fs.openCount,
+           results[0].fs.readBytes);
+}
+
+TEST(benchmarkColdAndWarmBoot)
+{
+    mock::setSerialQuiet(true);
+    mock::setConnectDelay(0, 0);
+    mock::addAccessPoint(HOME);
+    runChild<int>([]()
+                  { provision(); return 0; });
+
+    std::vector<BootResult> cold = bootMany(false);
+    std::vector<BootResult> warm = bootMany(true);
+    printResults("Cold", cold);
+    printResults("Warm", warm);
+    CHECK(cold[0].fs.mountCount >= 1);
+    CHECK(cold[0].fs.readBytes > 0);
+    CHECK_EQ(warm[0].fs.mountCount, 0);
+    CHECK_EQ(warm[0].fs.openCount, 0);
+}
@@ -0,0 +1,172 @@
+#include "test.h"
+
+#include <arpa/inet.h>
+#include <atomic>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <thread>
+
+// The captive DNS server answers every name with the AP address from loop(). The benchmark sends queries from a client
+// thread while the main thread runs loop() like the sketch, on the real clock
+
+#define QUERY_COUNT 20000
+#define WINDOW_SIZE 16 // Queries in flight in the burst benchmark
+
+static const char *const NAMES[] = {"connectivitycheck.gstatic.com", "captive.apple.com", "www.msftconnecttest.com", "example.org"};
+
+static size_t makeQuery(uint8_t *packet, uint16_t id, const char *name)
+{
+    const uint8_t header[] = {(uint8_t)(id >> 8), (uint8_t)id, 0x01, 0x00, 0, 1, 0, 0, 0, 0, 0, 0};
+    memcpy(packet, header, sizeof(header));
+    size_t length = sizeof(header);
+    while (*name)
+    {
+        const char *end = strchr(name, '.');
+        size_t labelLength = end ? end - name : strlen(name);
+        packet[length++] = labelLength;
+        memcpy(packet + length, name, labelLength);
+        length += labelLength;
+        name += labelLength + (end ? 1 : 0);
+    }
+    const uint8_t question[] = {0, 0, 1, 0, 1}; // Type A, class IN
+    memcpy(packet + length, question, sizeof(question));
+    return length + sizeof(question);
+}
+
+// The answer of the query id, with the AP address
+static bool isAnswer(const uint8_t *packet, ssize_t length, uint16_t id)
+{
+    return length >= 16 && (packet[0] << 8 | packet[1]) == id && (packet[2] & 0x80) && (packet[3] & 0x0F) == 0 &&
+           packet[7] == 1 && memcmp(packet + length - 4, "\xC0\xA8\x04\x01", 4) == 0;
+}
+
+static int openClient()
+{
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(mock::getDnsPort());
+    CHECK(fd >= 0 && connect(fd, (sockaddr *)&address, sizeof(address)) == 0);
+    timeval timeout = {1, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    return fd;
+}
+
+static void startPortal()
+{
+    mock::setSerialQuiet(true);
+    AsyncWiFiManager::setScanInterval(0);
+    AsyncWiFiManager::begin();
+    runFor(50, 1);
+    CHECK_EQ(AsyncWiFiManager::getState(), ASYNC_WIFI_STATE_CONFIG_PORTAL);
+    CHECK(mock::getDnsPort() != 0);
+}
+
+// Run loop() until the client is done, returns the number of calls
+template <typename Client>
+static unsigned long runWithClient(Client client)
+{
+    std::atomic<bool> isDone(false);
+    std::thread thread([&]()
+                       { client(); isDone = true; });
+    unsigned long loopCount = 0;
+    while (!isDone)
+    {
+        mock::deliverEvents();
+        AsyncWiFiManager::loop();
+        loopCount++;
+    }
+    thread.join();
+    return loopCount;
+}
+
+TEST(answersEveryNameWithApAddress)
+{
+    startPortal();
+    int fd = openClient();
+    std::atomic<int> answerCount(0);
+    runWithClient([&]()
+                  {
+                      for (uint16_t i = 0; i < 4; i++)
+                      {
+                          uint8_t packet[512];
+                          size_t length = makeQuery(packet, i, NAMES[i]);
+                          send(fd, packet, length, 0);
+                          ssize_t received = recv(fd, packet, sizeof(packet), 0);
+                          answerCount += isAnswer(packet, received, i);
+                      }
+                  });
+    CHECK_EQ(answerCount, 4);
+    close(fd);
+}
+
+TEST(redirectsCaptivePortalProbes)
+{
+    startPortal();
+    const char *const PROBES[] = {"/generate_204", "/hotspot-detect.html", "/connecttest.txt"};
+    for (const char *probe : PROBES)
+    {
+        CHECK_EQ(httpRequest("GET", probe), 302);
+    }
+}
+
+TEST(benchmarkSequentialQueries)
+{
+    startPortal();
+    int fd = openClient();
+    std::vector<unsigned long> latencies;
+    latencies.reserve(QUERY_COUNT);
+    std::atomic<int> errorCount(0);
+    uint64_t start = mock::hostMicros();
+    unsigned long loopCount = runWithClient([&]()
+                                            {
+                                                uint8_t packet[512];
+                                                for (int i = 0; i < QUERY_COUNT; i++)
+                                                {
+                                                    size_t length = makeQuery(packet, i, NAMES[i % 4]);
+                                                    uint64_t sent = mock::hostMicros();
+                                                    send(fd, packet, length, 0);
+                                                    ssize_t received = recv(fd, packet, sizeof(packet), 0);
+                                                    latencies.push_back(mock::hostMicros() - sent);
+                                                    errorCount += !isAnswer(packet, received, i);
+                                                }
+                                            });
+    uint64_t duration = mock::hostMicros() - start;
+    close(fd);
+    CHECK_EQ(errorCount, 0);
+    printf("DNS sequential: %d queries, %.0f queries/s, latency p50 %lu us, p99 %lu us, %.1f loop() calls per query\n",
+           QUERY_COUNT, QUERY_COUNT * 1e6 / duration, getPercentile(latencies, 50), getPercentile(latencies, 99),
+           (double)loopCount / QUERY_COUNT);
+}
+
+// Like several clients probing at once: one query is answered per loop(), the others wait in the socket buffer
+TEST(benchmarkBurstQueries)
+{
+    startPortal();
+    int fd = openClient();
+    std::atomic<int> errorCount(0);
+    uint64_t start = mock::hostMicros();
+    unsigned long loopCount = runWithClient([&]()
+                                            {
+                                                uint8_t packet[512];
+                                                for (int i = 0; i < QUERY_COUNT; i += WINDOW_SIZE)
+                                                {
+                                                    for (int j = i; j < i + WINDOW_SIZE; j++)
+                                                    {
+                                                        size_t length = makeQuery(packet, j, NAMES[j % 4]);
+                                                        send(fd, packet, length, 0);
+                                                    }
+                                                    for (int j = i; j < i + WINDOW_SIZE; j++)
+                                                    {
+                                                        ssize_t received = recv(fd, packet, sizeof(packet), 0);
+                                                        errorCount += !isAnswer(packet, received, j);
+                                                    }
+                                                }
+                                            });
+    uint64_t duration = mock::hostMicros() - start;
+    close(fd);
+    CHECK_EQ(errorCount, 0);
+    printf("DNS burst of %d: %d queries, %.0f queries/s, %.1f loop() calls per query\n", WINDOW_SIZE, QUERY_COUNT,
+           QUERY_COUNT * 1e6 / duration, (double)loopCount / QUERY_COUNT);
+}
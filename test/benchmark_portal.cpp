@@ -0,0 +1,149 @@
+#include "test.h"
+
+#include <arpa/inet.h>
+#include <atomic>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <thread>
+
+// Response time of the config portal pages, requested from a client thread while the main thread runs loop() like the
+// sketch, on the real clock. Then the channel of the AP during a hot apply, with and without the network in the scan data
+
+#define REQUEST_COUNT 500
+
+static const mock::AccessPoint HOME = {"home", "password1", {0x02, 0, 0, 0, 0, 1}, 6, -50, WIFI_AUTH_WPA2_PSK, true};
+static const mock::AccessPoint OFFICE = {"office", "password2", {0x02, 0, 0, 0, 0, 2}, 11, -60, WIFI_AUTH_WPA2_PSK, true};
+
+// GET over a new connection like a browser, returns the status code, -1 on error
+static int get(const char *path, size_t *length)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(mock::getHttpPort());
+    if (fd < 0 || connect(fd, (sockaddr *)&address, sizeof(address)) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    timeval timeout = {2, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    std::string request = std::string("GET ") + path + " HTTP/1.1\r\nHost: 192.168.4.1\r\n\r\n";
+    send(fd, request.data(), request.size(), MSG_NOSIGNAL);
+    std::string response;
+    char buffer[4096];
+    ssize_t received;
+    while ((received = recv(fd, buffer, sizeof(buffer), 0)) > 0)
+    {
+        response.append(buffer, received);
+    }
+    close(fd);
+    *length = response.size();
+    return response.compare(0, 9, "HTTP/1.1 ") == 0 ? atoi(response.c_str() + 9) : -1;
+}
+
+static void startPortal()
+{
+    mock::setSerialQuiet(true);
+    static char ssids[20][16];
+    for (uint8_t i = 0; i < 20; i++)
+    {
+        snprintf(ssids[i], sizeof(ssids[i]), "network%d", i);
+        mock::addAccessPoint({ssids[i], "password1", {0x02, 0, 0, 0, 1, i}, (uint8_t)(i % 13 + 1), (int8_t)(-40 - i * 2),
+                              WIFI_AUTH_WPA2_PSK, true});
+    }
+    AsyncWiFiManager::begin();
+    std::string body;
+    CHECK(runUntil([&]()
+                   { return httpRequest("GET", "/scan.json", nullptr, &body) == 200 && body.find("network19") != std::string::npos; },
+                   10000));
+}
+
+TEST(benchmarkPageLatency)
+{
+    startPortal();
+    const char *const PATHS[] = {"/", "/scan.json", "/status.json"};
+    for (const char *path : PATHS)
+    {
+        std::vector<unsigned long> latencies;
+        latencies.reserve(REQUEST_COUNT);
+        size_t length = 0;
+        std::atomic<int> errorCount(0);
+        std::atomic<bool> isDone(false);
+        std::thread client([&]()
+                           {
+                               for (int i = 0; i < REQUEST_COUNT; i++)
+                               {
+                                   uint64_t start = mock::hostMicros();
+                                   errorCount += get(path, &length) != 200;
+                                   latencies.push_back(mock::hostMicros() - start);
+                               }
+                               isDone = true;
+                           });
+        unsigned long loopCount = 0;
+        while (!isDone)
+        {
+            mock::deliverEvents();
+            AsyncWiFiManager::loop();
+            loopCount++;
+        }
+        client.join();
+        CHECK_EQ(errorCount, 0);
+        printf("GET %s: %zu bytes, latency p50 %lu us, p99 %lu us, %.1f loop() calls per request\n", path, length,
+               getPercentile(latencies, 50), getPercentile(latencies, 99), (double)loopCount / REQUEST_COUNT);
+    }
+}
+
+// Hot apply of the network on channel 6. Returns the WiFi stats once connected
+static mock::WiFiStats applyHome(bool isScanned)
+{
+    mock::setManualClock(true);
+    mock::setSerialQuiet(true);
+    mock::setConnectDelay(2000, 1000);
+    if (isScanned)
+    {
+        mock::addAccessPoint(HOME);
+    }
+    mock::addAccessPoint(OFFICE);
+    AsyncWiFiManager::setHotApplyEnable(true);
+    AsyncWiFiManager::begin();
+    std::string body;
+    CHECK(runUntil([&]()
+                   { return httpRequest("GET", "/scan.json", nullptr, &body) == 200 && body.find("office") != std::string::npos; },
+                   10000));
+    CHECK_EQ(mock::getWiFiStats().apChannel, 1);
+    if (!isScanned)
+    {
+        // The network appears after the scan
+        mock::addAccessPoint(HOME);
+    }
+    CHECK_EQ(httpRequest("POST", "/save", "s=home&p=password1"), 200);
+    CHECK(runUntil([]()
+                   { return AsyncWiFiManager::getApplyStatus() == ASYNC_WIFI_APPLY_CONNECTED; },
+                   30000));
+    mock::WiFiStats stats = mock::getWiFiStats();
+    CHECK_EQ(stats.apChannel, 6);
+    CHECK_EQ(stats.staChannel, 6);
+    printf("%s: AP started %u times, pulled by the station %u times, %lu ms with the radio shared between channels\n",
+           isScanned ? "Scanned network" : "Network not scanned", stats.softAPCount, stats.apPullCount,
+           stats.splitChannelTime);
+    return stats;
+}
+
+// The AP moves to the channel of the network before the station joins it, the radio stays on one channel
+TEST(movesAccessPointBeforeJoiningScannedNetwork)
+{
+    mock::WiFiStats stats = applyHome(true);
+    CHECK_EQ(stats.softAPCount, 2);
+    CHECK_EQ(stats.apPullCount, 0);
+    CHECK_EQ(stats.splitChannelTime, 0);
+}
+
+// Without scan data the station searches all channels and the driver pulls the AP when it associates
+TEST(followsStationToUnscannedNetwork)
+{
+    mock::WiFiStats stats = applyHome(false);
+    CHECK_EQ(stats.apPullCount, 1);
+    CHECK(stats.splitChannelTime >= 2000);
+}
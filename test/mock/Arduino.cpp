@@ -0,0 +1,264 @@
+#include <Arduino.h>
+#include "Mock.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+HardwareSerial Serial;
+EspClass ESP;
+
+static const auto START_TIME = std::chrono::steady_clock::now();
+static std::atomic<bool> isManualClock(false);
+static std::atomic<unsigned long> manualTime(0);
+static std::atomic<bool> isSerialQuiet(false);
+static std::atomic<uint32_t> restartCount(0);
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size)
+{
+    if (!isSerialQuiet)
+    {
+        fwrite(buffer, 1, size, stdout);
+    }
+    return size;
+}
+
+unsigned long millis()
+{
+    if (isManualClock)
+    {
+        return manualTime;
+    }
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - START_TIME).count();
+}
+
+unsigned long micros()
+{
+    if (isManualClock)
+    {
+        return manualTime * 1000;
+    }
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - START_TIME).count();
+}
+
+void delay(unsigned long ms)
+{
+    if (isManualClock)
+    {
+        manualTime += ms;
+        return;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void yield()
+{
+    std::this_thread::yield();
+}
+
+long random(long max)
+{
+    return max > 0 ? ::random() % max : 0;
+}
+
+long random(long min, long max)
+{
+    return min < max ? min + random(max - min) : min;
+}
+
+void randomSeed(unsigned long seed)
+{
+    srandom(seed);
+}
+
+long map(long value, long fromLow, long fromHigh, long toLow, long toHigh)
+{
+    return (value - fromLow) * (toHigh - toLow) / (fromHigh - fromLow) + toLow;
+}
+
+void EspClass::restart()
+{
+    restartCount++;
+}
+
+uint32_t EspClass::getFreeHeap()
+{
+    return 200000;
+}
+
+uint32_t EspClass::getMaxAllocHeap()
+{
+    return 110000;
+}
+
+// FreeRTOS
+
+struct MockTask
+{
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable condition;
+    uint32_t notificationCount = 0;
+};
+
+struct MockSemaphore
+{
+    std::mutex mutex;
+};
+
+struct TaskExit
+{
+};
+
+static std::mutex taskMutex;
+static std::vector<MockTask *> tasks;
+static std::atomic<bool> isStoppingTasks(false);
+static thread_local MockTask *currentTask = nullptr;
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char *name, uint32_t stackSize, void *arg,
+                                   UBaseType_t priority, TaskHandle_t *handle, BaseType_t core)
+{
+    MockTask *task = new MockTask();
+    std::lock_guard<std::mutex> lock(taskMutex);
+    *handle = task;
+    tasks.push_back(task);
+    task->thread = std::thread([task, function, arg]()
+                               {
+                                   currentTask = task;
+                                   try
+                                   {
+                                       function(arg);
+                                   }
+                                   catch (const TaskExit &)
+                                   {
+                                   } });
+    return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks)
+{
+    MockTask *task = currentTask;
+    if (isStoppingTasks)
+    {
+        throw TaskExit();
+    }
+    std::unique_lock<std::mutex> lock(task->mutex);
+    task->condition.wait_for(lock, std::chrono::milliseconds(ticks), [task]()
+                             { return task->notificationCount > 0 || isStoppingTasks; });
+    uint32_t count = task->notificationCount;
+    if (count > 0)
+    {
+        task->notificationCount = clear ? 0 : count - 1;
+    }
+    return count;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    std::lock_guard<std::mutex> lock(task->mutex);
+    task->notificationCount++;
+    task->condition.notify_one();
+    return pdPASS;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex()
+{
+    return new MockSemaphore();
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks)
+{
+    if (ticks == portMAX_DELAY)
+    {
+        semaphore->mutex.lock();
+        return pdTRUE;
+    }
+    return semaphore->mutex.try_lock() ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore)
+{
+    semaphore->mutex.unlock();
+    return pdTRUE;
+}
+
+// RTC memory, the section is delimited by the linker
+extern "C" uint8_t __start_rtc_data[] __attribute__((weak));
+extern "C" uint8_t __stop_rtc_data[] __attribute__((weak));
+
+namespace mock
+{
+    void setManualClock(bool manual)
+    {
+        manualTime = millis();
+        isManualClock = manual;
+    }
+
+    void advance(unsigned long ms)
+    {
+        manualTime += ms;
+    }
+
+    uint64_t hostMicros()
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - START_TIME).count();
+    }
+
+    uint32_t getRestartCount()
+    {
+        return restartCount;
+    }
+
+    void setSerialQuiet(bool quiet)
+    {
+        isSerialQuiet = quiet;
+    }
+
+    void stopTasks()
+    {
+        std::vector<MockTask *> stopped;
+        {
+            std::lock_guard<std::mutex> lock(taskMutex);
+            stopped.swap(tasks);
+        }
+        isStoppingTasks = true;
+        for (MockTask *task : stopped)
+        {
+            {
+                std::lock_guard<std::mutex> lock(task->mutex);
+                task->condition.notify_one();
+            }
+            task->thread.join();
+            delete task;
+        }
+        isStoppingTasks = false;
+    }
+
+    bool saveRtcMemory(const char *path)
+    {
+        FILE *file = fopen(path, "wb");
+        if (!file)
+        {
+            return false;
+        }
+        size_t size = __stop_rtc_data - __start_rtc_data;
+        bool ret = fwrite(__start_rtc_data, 1, size, file) == size;
+        return fclose(file) == 0 && ret;
+    }
+
+    bool loadRtcMemory(const char *path)
+    {
+        FILE *file = fopen(path, "rb");
+        if (!file)
+        {
+            return false;
+        }
+        size_t size = __stop_rtc_data - __start_rtc_data;
+        bool ret = fread(__start_rtc_data, 1, size, file) == size;
+        fclose(file);
+        return ret;
+    }
+}
@@ -0,0 +1,211 @@
+#pragma once
+
+// Host stand-in for the parts of the ESP32 Arduino core used by AsyncWiFiManager. The library is built as for ESP32.
+// The behavior of the mocks is controlled from the tests through Mock.h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <algorithm>
+#include <functional>
+#include <string>
+
+#if !defined(__GLIBC__) || __GLIBC__ < 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ < 38)
+inline size_t strlcpy(char *dest, const char *src, size_t size)
+{
+    size_t length = strlen(src);
+    if (size > 0)
+    {
+        size_t count = length < size - 1 ? length : size - 1;
+        memcpy(dest, src, count);
+        dest[count] = '\0';
+    }
+    return length;
+}
+#endif
+
+#define PROGMEM
+#define PGM_P const char *
+#define PSTR(s) (s)
+class __FlashStringHelper;
+#define F(s) ((const __FlashStringHelper *)(s))
+#define FPSTR(p) ((const __FlashStringHelper *)(p))
+#define pgm_read_byte(p) (*(const uint8_t *)(p))
+#define memcpy_P memcpy
+#define strlen_P strlen
+#define strncpy_P strncpy
+#define strcmp_P strcmp
+#define snprintf_P snprintf
+#define vsnprintf_P vsnprintf
+
+using std::max;
+using std::min;
+
+class String
+{
+public:
+    String(const char *str = "") : mValue(str ? str : "") {}
+    String(const __FlashStringHelper *str) : mValue((const char *)str) {}
+    String(const std::string &str) : mValue(str) {}
+    explicit String(int value) : mValue(std::to_string(value)) {}
+    explicit String(unsigned int value) : mValue(std::to_string(value)) {}
+    explicit String(long value) : mValue(std::to_string(value)) {}
+    explicit String(unsigned long value) : mValue(std::to_string(value)) {}
+
+    const char *c_str() const { return mValue.c_str(); }
+    unsigned int length() const { return mValue.size(); }
+    bool isEmpty() const { return mValue.empty(); }
+    void reserve(unsigned int size) { mValue.reserve(size); }
+    int toInt() const { return atoi(mValue.c_str()); }
+    char operator[](unsigned int index) const { return index < mValue.size() ? mValue[index] : '\0'; }
+    int indexOf(char c) const
+    {
+        size_t pos = mValue.find(c);
+        return pos == std::string::npos ? -1 : (int)pos;
+    }
+    String substring(unsigned int begin, unsigned int end = UINT32_MAX) const
+    {
+        if (begin >= mValue.size())
+        {
+            return String();
+        }
+        return String(mValue.substr(begin, end == UINT32_MAX ? std::string::npos : end - begin));
+    }
+
+    String &operator+=(const String &str)
+    {
+        mValue += str.mValue;
+        return *this;
+    }
+    String &operator+=(const char *str)
+    {
+        mValue += str;
+        return *this;
+    }
+    String &operator+=(char c)
+    {
+        mValue += c;
+        return *this;
+    }
+    String &operator+=(int value)
+    {
+        mValue += std::to_string(value);
+        return *this;
+    }
+    friend String operator+(const String &a, const String &b) { return String(a.mValue + b.mValue); }
+    bool operator==(const String &str) const { return mValue == str.mValue; }
+    bool operator==(const char *str) const { return mValue == str; }
+    bool operator!=(const String &str) const { return mValue != str.mValue; }
+
+private:
+    std::string mValue;
+};
+
+class Print
+{
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) { return write(&c, 1); }
+    virtual size_t write(const uint8_t *buffer, size_t size) = 0;
+    size_t write(const char *buffer, size_t size) { return write((const uint8_t *)buffer, size); }
+    size_t print(const char *str) { return write(str, strlen(str)); }
+    size_t print(const __FlashStringHelper *str) { return print((const char *)str); }
+    size_t print(const String &str) { return write(str.c_str(), str.length()); }
+    size_t print(long value)
+    {
+        char number[24];
+        return write(number, snprintf(number, sizeof(number), "%ld", value));
+    }
+    size_t println(const char *str = "") { return print(str) + print("\r\n"); }
+    size_t println(const String &str) { return println(str.c_str()); }
+};
+
+class Stream : public Print
+{
+public:
+    virtual int available() { return 0; }
+    virtual int read() { return -1; }
+};
+
+// Written to stdout, unless quiet
+class HardwareSerial : public Stream
+{
+public:
+    void begin(unsigned long baud) {}
+    size_t write(const uint8_t *buffer, size_t size) override;
+    using Print::write;
+};
+
+extern HardwareSerial Serial;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void yield();
+long random(long max);
+long random(long min, long max);
+void randomSeed(unsigned long seed);
+long map(long value, long fromLow, long fromHigh, long toLow, long toHigh);
+
+class IPAddress
+{
+public:
+    IPAddress() : mAddress(0) {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : mAddress(a | b << 8 | c << 16 | (uint32_t)d << 24) {}
+    // In network byte order, like the addresses of lwIP
+    IPAddress(uint32_t address) : mAddress(address) {}
+    operator uint32_t() const { return mAddress; }
+    uint8_t operator[](int index) const { return mAddress >> (index * 8); }
+    bool operator==(const IPAddress &address) const { return mAddress == address.mAddress; }
+    String toString() const
+    {
+        char text[16];
+        snprintf(text, sizeof(text), "%u.%u.%u.%u", (*this)[0], (*this)[1], (*this)[2], (*this)[3]);
+        return String(text);
+    }
+
+private:
+    uint32_t mAddress;
+};
+
+// Variables kept across a restart of a test process, see mock::saveRtcMemory()
+#define RTC_DATA_ATTR __attribute__((section("rtc_data")))
+
+class EspClass
+{
+public:
+    void restart();
+    uint32_t getFreeHeap();
+    uint32_t getMaxAllocHeap();
+    uint32_t getFreeSketchSpace() { return 0x1E0000; }
+};
+
+extern EspClass ESP;
+
+// FreeRTOS, tasks are threads and a tick is a millisecond
+typedef struct MockTask *TaskHandle_t;
+typedef struct MockSemaphore *SemaphoreHandle_t;
+typedef void (*TaskFunction_t)(void *);
+typedef unsigned int UBaseType_t;
+typedef int BaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdPASS 1
+#define pdFAIL 0
+#define pdTRUE 1
+#define pdFALSE 0
+#define portMAX_DELAY 0xFFFFFFFFUL
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define ARDUINO_RUNNING_CORE 1
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char *name, uint32_t stackSize, void *arg,
+                                   UBaseType_t priority, TaskHandle_t *handle, BaseType_t core);
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks);
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+SemaphoreHandle_t xSemaphoreCreateMutex();
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore);
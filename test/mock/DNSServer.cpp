@@ -0,0 +1,115 @@
+#include <DNSServer.h>
+#include "Mock.h"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define DNS_HEADER_SIZE 12
+#define DNS_PACKET_SIZE 512
+#define DNS_TYPE_A 1
+#define DNS_TYPE_ANY 255
+
+static uint16_t dnsPort = 0;
+
+DNSServer::~DNSServer()
+{
+    stop();
+}
+
+// The port of the device is privileged on the host, a free one is used instead
+bool DNSServer::start(uint16_t port, const String &domainName, const IPAddress &resolvedIP)
+{
+    stop();
+    mSocket = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(address);
+    if (mSocket < 0 || bind(mSocket, (sockaddr *)&address, sizeof(address)) != 0 ||
+        getsockname(mSocket, (sockaddr *)&address, &length) != 0)
+    {
+        stop();
+        return false;
+    }
+    fcntl(mSocket, F_SETFL, O_NONBLOCK);
+    dnsPort = ntohs(address.sin_port);
+    mDomainName = domainName;
+    mResolvedIP = (uint32_t)resolvedIP;
+    return true;
+}
+
+void DNSServer::stop()
+{
+    if (mSocket >= 0)
+    {
+        close(mSocket);
+        mSocket = -1;
+        dnsPort = 0;
+    }
+}
+
+void DNSServer::setErrorReplyCode(const DNSReplyCode &replyCode)
+{
+    mErrorReplyCode = replyCode;
+}
+
+void DNSServer::setTTL(const uint32_t &ttl)
+{
+    mTTL = ttl;
+}
+
+// Answer one query, without allocation. Only the wildcard domain is resolved, like the captive portal uses it
+void DNSServer::processNextRequest()
+{
+    if (mSocket < 0)
+    {
+        return;
+    }
+    uint8_t packet[DNS_PACKET_SIZE];
+    sockaddr_in client;
+    socklen_t clientLength = sizeof(client);
+    ssize_t length = recvfrom(mSocket, packet, sizeof(packet), 0, (sockaddr *)&client, &clientLength);
+    // A query with its header and a single question
+    if (length < DNS_HEADER_SIZE || (packet[2] & 0x80) || packet[4] != 0 || packet[5] != 1)
+    {
+        return;
+    }
+    // The question is kept in the answer, its end is found after the labels
+    ssize_t pos = DNS_HEADER_SIZE;
+    while (pos < length && packet[pos] != 0)
+    {
+        pos += packet[pos] + 1;
+    }
+    pos += 5;
+    if (pos > length || pos + 16 > DNS_PACKET_SIZE)
+    {
+        return;
+    }
+    uint16_t type = packet[pos - 4] << 8 | packet[pos - 3];
+    bool isAnswered = (type == DNS_TYPE_A || type == DNS_TYPE_ANY) && mDomainName == "*" && (packet[2] & 0x78) == 0;
+
+    packet[2] = 0x80 | (packet[2] & 0x79) | 0x04; // Response, authoritative, recursion desired as asked
+    packet[3] = 0x80 | (isAnswered ? 0 : (uint8_t)mErrorReplyCode);
+    memset(packet + 6, 0, 6);
+    if (isAnswered)
+    {
+        packet[7] = 1;
+        const uint8_t answer[] = {0xC0, DNS_HEADER_SIZE, 0, DNS_TYPE_A, 0, 1,
+                                  (uint8_t)(mTTL >> 24), (uint8_t)(mTTL >> 16), (uint8_t)(mTTL >> 8), (uint8_t)mTTL, 0, 4};
+        memcpy(packet + pos, answer, sizeof(answer));
+        memcpy(packet + pos + sizeof(answer), &mResolvedIP, 4);
+        pos += sizeof(answer) + 4;
+    }
+    sendto(mSocket, packet, pos, 0, (sockaddr *)&client, clientLength);
+}
+
+namespace mock
+{
+    uint16_t getDnsPort()
+    {
+        return dnsPort;
+    }
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+// Host stand-in for DNSServer. The server answers on 127.0.0.1, at the port of mock::getDnsPort()
+
+#include <Arduino.h>
+
+enum class DNSReplyCode
+{
+    NoError = 0,
+    FormError = 1,
+    ServerFailure = 2,
+    NonExistentDomain = 3,
+    NotImplemented = 4,
+    Refused = 5
+};
+
+class DNSServer
+{
+public:
+    ~DNSServer();
+
+    bool start(uint16_t port, const String &domainName, const IPAddress &resolvedIP);
+    void stop();
+    void processNextRequest();
+    void setErrorReplyCode(const DNSReplyCode &replyCode);
+    void setTTL(const uint32_t &ttl);
+
+private:
+    int mSocket = -1;
+    String mDomainName;
+    uint32_t mResolvedIP = 0;
+    uint32_t mTTL = 60;
+    DNSReplyCode mErrorReplyCode = DNSReplyCode::NonExistentDomain;
+};
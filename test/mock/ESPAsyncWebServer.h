@@ -0,0 +1,77 @@
+#pragma once
+
+// Host stand-in for ESPAsyncWebServer, declarations only: it is compiled for the size table, not linked
+
+#include <Arduino.h>
+
+typedef enum
+{
+    HTTP_GET = 0b00000001,
+    HTTP_POST = 0b00000010,
+    HTTP_DELETE = 0b00000100,
+    HTTP_PUT = 0b00001000,
+    HTTP_PATCH = 0b00010000,
+    HTTP_HEAD = 0b00100000,
+    HTTP_OPTIONS = 0b01000000,
+    HTTP_ANY = 0b01111111
+} WebRequestMethod;
+typedef uint8_t WebRequestMethodComposite;
+
+class AsyncWebHeader
+{
+public:
+    const String &value() const;
+};
+
+class AsyncWebServerResponse
+{
+public:
+    virtual ~AsyncWebServerResponse() {}
+    void addHeader(const String &name, const String &value);
+};
+
+class AsyncResponseStream : public AsyncWebServerResponse, public Print
+{
+public:
+    size_t write(const uint8_t *data, size_t length) override;
+    using Print::write;
+};
+
+class AsyncWebServerRequest
+{
+public:
+    String url() const;
+    WebRequestMethodComposite method() const;
+    size_t contentLength() const;
+    size_t args() const;
+    const String &arg(size_t i) const;
+    const String &argName(size_t i) const;
+    const String &arg(const char *name) const;
+    bool hasArg(const char *name) const;
+    AsyncWebHeader *getHeader(const char *name) const;
+    bool authenticate(const char *username, const char *password);
+    void requestAuthentication(const char *realm = nullptr, bool isDigest = true);
+
+    void send(int code, const String &contentType = String(), const String &content = String());
+    void send(AsyncWebServerResponse *response);
+    void redirect(const String &url);
+    AsyncResponseStream *beginResponseStream(const String &contentType, size_t bufferSize = 1460);
+    AsyncWebServerResponse *beginResponse_P(int code, const String &contentType, const uint8_t *content, size_t length);
+};
+
+typedef std::function<void(AsyncWebServerRequest *request)> ArRequestHandlerFunction;
+typedef std::function<void(AsyncWebServerRequest *request, const String &filename, size_t index, uint8_t *data, size_t length,
+                           bool final)>
+    ArUploadHandlerFunction;
+
+class AsyncWebServer
+{
+public:
+    AsyncWebServer(uint16_t port);
+    ~AsyncWebServer();
+    void begin();
+    void end();
+    void on(const char *uri, WebRequestMethodComposite method, ArRequestHandlerFunction onRequest);
+    void on(const char *uri, WebRequestMethodComposite method, ArRequestHandlerFunction onRequest, ArUploadHandlerFunction onUpload);
+    void onNotFound(ArRequestHandlerFunction onRequest);
+};
@@ -0,0 +1,15 @@
+#pragma once
+
+// Host stand-in for ESPmDNS, nothing is announced
+
+#include <Arduino.h>
+
+class MDNSResponder
+{
+public:
+    bool begin(const char *hostName) { return hostName && hostName[0] != '\0'; }
+    void end() {}
+    bool addService(const char *service, const char *protocol, uint16_t port) { return true; }
+};
+
+extern MDNSResponder MDNS;
@@ -0,0 +1,158 @@
+#include <LittleFS.h>
+#include "Mock.h"
+
+#include <fcntl.h>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+
+fs::FS LittleFS;
+
+static std::string rootPath = ".";
+static bool isMounted = false;
+static mock::FileSystemStats stats = {};
+
+static std::string getPath(const char *path)
+{
+    return rootPath + (path[0] == '/' ? "" : "/") + path;
+}
+
+namespace fs
+{
+    struct File::Handle
+    {
+        int fd;
+        ~Handle() { ::close(fd); }
+    };
+
+    File::File(int fd) : mFile(std::make_shared<Handle>())
+    {
+        mFile->fd = fd;
+    }
+
+    bool File::isDirectory()
+    {
+        struct stat status;
+        return mFile && fstat(mFile->fd, &status) == 0 && S_ISDIR(status.st_mode);
+    }
+
+    size_t File::size()
+    {
+        struct stat status;
+        return mFile && fstat(mFile->fd, &status) == 0 ? status.st_size : 0;
+    }
+
+    bool File::seek(uint32_t pos)
+    {
+        return mFile && lseek(mFile->fd, pos, SEEK_SET) == (off_t)pos;
+    }
+
+    int File::available()
+    {
+        if (!mFile)
+        {
+            return 0;
+        }
+        off_t pos = lseek(mFile->fd, 0, SEEK_CUR);
+        return pos < 0 ? 0 : (int)(size() - pos);
+    }
+
+    int File::read()
+    {
+        uint8_t byte;
+        return read(&byte, 1) == 1 ? byte : -1;
+    }
+
+    size_t File::read(uint8_t *buffer, size_t size)
+    {
+        if (!mFile)
+        {
+            return 0;
+        }
+        ssize_t length = ::read(mFile->fd, buffer, size);
+        if (length <= 0)
+        {
+            return 0;
+        }
+        stats.readBytes += length;
+        return length;
+    }
+
+    size_t File::write(const uint8_t *buffer, size_t size)
+    {
+        if (!mFile)
+        {
+            return 0;
+        }
+        ssize_t length = ::write(mFile->fd, buffer, size);
+        if (length <= 0)
+        {
+            return 0;
+        }
+        stats.writtenBytes += length;
+        return length;
+    }
+
+    void File::close()
+    {
+        mFile.reset();
+    }
+
+    bool FS::begin(bool formatOnFail)
+    {
+        stats.mountCount++;
+        struct stat status;
+        isMounted = stat(rootPath.c_str(), &status) == 0 && S_ISDIR(status.st_mode);
+        if (!isMounted && formatOnFail)
+        {
+            isMounted = format();
+        }
+        return isMounted;
+    }
+
+    bool FS::format()
+    {
+        return mkdir(rootPath.c_str(), 0755) == 0;
+    }
+
+    File FS::open(const char *path, const char *mode)
+    {
+        if (!isMounted)
+        {
+            return File();
+        }
+        stats.openCount++;
+        int flags = mode[0] == 'w' ? O_WRONLY | O_CREAT | O_TRUNC : mode[0] == 'a' ? O_WRONLY | O_CREAT | O_APPEND : O_RDONLY;
+        int fd = ::open(getPath(path).c_str(), flags, 0644);
+        return fd < 0 ? File() : File(fd);
+    }
+
+    bool FS::exists(const char *path)
+    {
+        return isMounted && access(getPath(path).c_str(), F_OK) == 0;
+    }
+
+    bool FS::remove(const char *path)
+    {
+        return isMounted && unlink(getPath(path).c_str()) == 0;
+    }
+
+    bool FS::rename(const char *from, const char *to)
+    {
+        return isMounted && ::rename(getPath(from).c_str(), getPath(to).c_str()) == 0;
+    }
+}
+
+namespace mock
+{
+    void setFileSystemRoot(const char *path)
+    {
+        rootPath = path;
+        isMounted = false;
+    }
+
+    FileSystemStats getFileSystemStats()
+    {
+        return stats;
+    }
+}
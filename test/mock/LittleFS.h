@@ -0,0 +1,45 @@
+#pragma once
+
+// Host stand-in for LittleFS, the files are kept in a directory set with mock::setFileSystemRoot()
+
+#include <Arduino.h>
+#include <memory>
+
+namespace fs
+{
+    class File : public Stream
+    {
+    public:
+        File() {}
+        explicit File(int fd);
+
+        operator bool() const { return mFile != nullptr; }
+        bool isDirectory();
+        size_t size();
+        bool seek(uint32_t pos);
+        int available() override;
+        int read() override;
+        size_t read(uint8_t *buffer, size_t size);
+        size_t write(const uint8_t *buffer, size_t size) override;
+        using Print::write;
+        void close();
+
+    private:
+        struct Handle;
+        std::shared_ptr<Handle> mFile;
+    };
+
+    class FS
+    {
+    public:
+        bool begin(bool formatOnFail = false);
+        void end() {}
+        bool format();
+        File open(const char *path, const char *mode = "r");
+        bool exists(const char *path);
+        bool remove(const char *path);
+        bool rename(const char *from, const char *to);
+    };
+}
+
+extern fs::FS LittleFS;
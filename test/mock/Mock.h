@@ -0,0 +1,81 @@
+#pragma once
+
+// Control of the host mocks from the tests
+
+#include <Arduino.h>
+#include <WiFi.h>
+
+namespace mock
+{
+    // Clock. The real clock starts at 0 with the process, a manual clock only moves with advance() and delay()
+    void setManualClock(bool manual);
+    void advance(unsigned long ms);
+    // (us) Real time since the process started, whatever the clock of millis()
+    uint64_t hostMicros();
+
+    // Access points seen by scans and joined by WiFi.begin()
+    struct AccessPoint
+    {
+        const char *ssid;
+        const char *password;
+        uint8_t bssid[6];
+        uint8_t channel;
+        int8_t rssi;
+        wifi_auth_mode_t auth;
+        bool dhcp; // false leaves the station associated without an IP address
+    };
+    void addAccessPoint(const AccessPoint &accessPoint);
+    void removeAccessPoints();
+    void setRssi(const uint8_t *bssid, int8_t rssi);
+    // Time between WiFi.begin() and the association, then the IP address (ms of millis())
+    void setConnectDelay(unsigned long associate, unsigned long dhcp);
+    void setScanDelay(unsigned long ms);
+    void setGateway(IPAddress address);
+    // Drop the connection like the access point would, the driver reports the reason
+    void disconnect(uint8_t reason);
+    // Report an event at once from the calling thread, like the event task of the driver
+    void fireEvent(arduino_event_id_t event, uint8_t reason = 0);
+    // Report the events that are due, call before each loop() of the library
+    void deliverEvents();
+    // WiFi.localIP() gives up the CPU, so that other threads run in the middle of the work of its caller
+    void setDriverYield(bool yield);
+
+    struct WiFiStats
+    {
+        uint32_t beginCount;
+        uint64_t firstBeginTime; // (us) Since the process started, 0 before the first WiFi.begin()
+        uint32_t scanCount;
+        uint32_t softAPCount;    // softAP() calls, each (re)starts the AP
+        uint32_t apPullCount;    // Associations that pulled the AP to the channel of the station, dropping its clients
+        unsigned long splitChannelTime; // (ms) Time the radio was shared between the AP and a station on another channel
+        uint8_t apChannel;
+        uint8_t staChannel;      // Channel of the current attempt or connection, 0 if none
+    };
+    WiFiStats getWiFiStats();
+
+    // File system, backed by a directory so that it survives a restart of the test process
+    void setFileSystemRoot(const char *path);
+    struct FileSystemStats
+    {
+        uint32_t mountCount;
+        uint32_t openCount;
+        uint32_t readBytes;
+        uint32_t writtenBytes;
+    };
+    FileSystemStats getFileSystemStats();
+
+    // RTC memory, the variables declared with RTC_DATA_ATTR
+    bool saveRtcMemory(const char *path);
+    bool loadRtcMemory(const char *path);
+
+    // ESP.restart() only counts, the process keeps running
+    uint32_t getRestartCount();
+    void setSerialQuiet(bool quiet);
+
+    // Ports bound by the servers, the privileged ports of the device are mapped to free ones
+    uint16_t getHttpPort();
+    uint16_t getDnsPort();
+
+    // Tasks end at their next ulTaskNotifyTake(), then are joined
+    void stopTasks();
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+// Host stand-in for the Update class of ESP32, declarations only: it is compiled for the size table, not linked
+
+#include <Arduino.h>
+
+#define UPDATE_SIZE_UNKNOWN 0xFFFFFFFF
+
+class UpdateClass
+{
+public:
+    bool begin(size_t size);
+    size_t write(uint8_t *data, size_t length);
+    bool end(bool evenIfRemaining = false);
+    bool isRunning();
+    bool hasError();
+    uint8_t getError();
+    bool setMD5(const char *expectedMD5);
+    void runAsync(bool async);
+};
+
+extern UpdateClass Update;
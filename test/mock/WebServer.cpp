@@ -0,0 +1,506 @@
+#include <WebServer.h>
+#include "Mock.h"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define REQUEST_TIMEOUT 2000 // (ms)
+
+static uint16_t httpPort = 0;
+
+static const char *getStatusText(int code)
+{
+    switch (code)
+    {
+    case 200:
+        return "OK";
+    case 302:
+        return "Found";
+    case 304:
+        return "Not Modified";
+    case 400:
+        return "Bad Request";
+    case 401:
+        return "Unauthorized";
+    case 404:
+        return "Not Found";
+    default:
+        return code < 500 ? "Error" : "Internal Server Error";
+    }
+}
+
+static std::string urlDecode(const std::string &text)
+{
+    std::string decoded;
+    for (size_t i = 0; i < text.size(); i++)
+    {
+        if (text[i] == '+')
+        {
+            decoded += ' ';
+        }
+        else if (text[i] == '%' && i + 2 < text.size() && isxdigit(text[i + 1]) && isxdigit(text[i + 2]))
+        {
+            decoded += (char)strtol(text.substr(i + 1, 2).c_str(), nullptr, 16);
+            i += 2;
+        }
+        else
+        {
+            decoded += text[i];
+        }
+    }
+    return decoded;
+}
+
+static std::string base64Encode(const std::string &text)
+{
+    static const char ALPHABET[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string encoded;
+    for (size_t i = 0; i < text.size(); i += 3)
+    {
+        uint32_t value = (uint8_t)text[i] << 16;
+        value |= i + 1 < text.size() ? (uint8_t)text[i + 1] << 8 : 0;
+        value |= i + 2 < text.size() ? (uint8_t)text[i + 2] : 0;
+        encoded += ALPHABET[value >> 18 & 0x3F];
+        encoded += ALPHABET[value >> 12 & 0x3F];
+        encoded += i + 1 < text.size() ? ALPHABET[value >> 6 & 0x3F] : '=';
+        encoded += i + 2 < text.size() ? ALPHABET[value & 0x3F] : '=';
+    }
+    return encoded;
+}
+
+WebServer::WebServer(int port)
+{
+}
+
+WebServer::~WebServer()
+{
+    stop();
+}
+
+// The port of the device is privileged on the host, a free one is used instead
+void WebServer::begin()
+{
+    stop();
+    mListenSocket = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(address);
+    if (mListenSocket < 0 || bind(mListenSocket, (sockaddr *)&address, sizeof(address)) != 0 || listen(mListenSocket, 16) != 0 ||
+        getsockname(mListenSocket, (sockaddr *)&address, &length) != 0)
+    {
+        stop();
+        return;
+    }
+    fcntl(mListenSocket, F_SETFL, O_NONBLOCK);
+    httpPort = ntohs(address.sin_port);
+}
+
+void WebServer::stop()
+{
+    if (mListenSocket >= 0)
+    {
+        ::close(mListenSocket);
+        mListenSocket = -1;
+        httpPort = 0;
+    }
+}
+
+void WebServer::on(const String &uri, THandlerFunction handler)
+{
+    on(uri, HTTP_ANY, handler);
+}
+
+void WebServer::on(const String &uri, HTTPMethod method, THandlerFunction handler)
+{
+    on(uri, method, handler, nullptr);
+}
+
+void WebServer::on(const String &uri, HTTPMethod method, THandlerFunction handler, THandlerFunction uploadHandler)
+{
+    mRoutes.push_back({uri, method, handler, uploadHandler});
+}
+
+void WebServer::onNotFound(THandlerFunction handler)
+{
+    mNotFoundHandler = handler;
+}
+
+void WebServer::collectHeaders(const char *headerKeys[], const size_t headerKeysCount)
+{
+    mHeaderKeys.assign(headerKeys, headerKeys + headerKeysCount);
+}
+
+// Nothing is allocated while no client is waiting
+void WebServer::handleClient()
+{
+    if (mListenSocket < 0)
+    {
+        return;
+    }
+    mClient = accept(mListenSocket, nullptr, nullptr);
+    if (mClient < 0)
+    {
+        return;
+    }
+    int flag = 1;
+    setsockopt(mClient, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+    timeval timeout = {REQUEST_TIMEOUT / 1000, REQUEST_TIMEOUT % 1000 * 1000};
+    setsockopt(mClient, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    mResponseHeaders = String();
+    mResponseLength = CONTENT_LENGTH_NOT_SET;
+    mIsChunked = false;
+    mIsResponseSent = false;
+    if (!readRequest())
+    {
+        send(400, "text/plain", "Bad Request");
+    }
+    else if (!mIsResponseSent)
+    {
+        send(500, "text/plain", "No response");
+    }
+    ::close(mClient);
+    mClient = -1;
+}
+
+bool WebServer::readRequest()
+{
+    std::string request;
+    size_t headerEnd;
+    char buffer[1024];
+    while ((headerEnd = request.find("\r\n\r\n")) == std::string::npos)
+    {
+        ssize_t length = recv(mClient, buffer, sizeof(buffer), 0);
+        if (length <= 0)
+        {
+            return false;
+        }
+        request.append(buffer, length);
+    }
+
+    // Request line
+    size_t lineEnd = request.find("\r\n");
+    std::string line = request.substr(0, lineEnd);
+    size_t methodEnd = line.find(' ');
+    size_t uriEnd = line.find(' ', methodEnd + 1);
+    if (methodEnd == std::string::npos || uriEnd == std::string::npos)
+    {
+        return false;
+    }
+    std::string method = line.substr(0, methodEnd);
+    mMethod = method == "GET"    ? HTTP_GET
+              : method == "POST" ? HTTP_POST
+              : method == "HEAD" ? HTTP_HEAD
+                                 : HTTP_OPTIONS;
+    std::string uri = line.substr(methodEnd + 1, uriEnd - methodEnd - 1);
+    size_t queryStart = uri.find('?');
+    mUri = String(uri.substr(0, queryStart));
+    mArgs.clear();
+    if (queryStart != std::string::npos)
+    {
+        parseArguments(uri.substr(queryStart + 1));
+    }
+
+    // Headers, only the collected ones are kept
+    mHeaders.clear();
+    mAuthorization.clear();
+    mContentType.clear();
+    mContentLength = 0;
+    size_t pos = lineEnd + 2;
+    while (pos < headerEnd)
+    {
+        lineEnd = request.find("\r\n", pos);
+        line = request.substr(pos, lineEnd - pos);
+        pos = lineEnd + 2;
+        size_t colon = line.find(':');
+        if (colon == std::string::npos)
+        {
+            continue;
+        }
+        std::string name = line.substr(0, colon);
+        size_t valueStart = line.find_first_not_of(' ', colon + 1);
+        std::string value = valueStart == std::string::npos ? std::string() : line.substr(valueStart);
+        if (strcasecmp(name.c_str(), "Content-Length") == 0)
+        {
+            mContentLength = strtoul(value.c_str(), nullptr, 10);
+        }
+        else if (strcasecmp(name.c_str(), "Content-Type") == 0)
+        {
+            mContentType = value;
+        }
+        else if (strcasecmp(name.c_str(), "Authorization") == 0)
+        {
+            mAuthorization = value;
+        }
+        for (const String &key : mHeaderKeys)
+        {
+            if (strcasecmp(key.c_str(), name.c_str()) == 0)
+            {
+                mHeaders.push_back(Pair(String(name), String(value)));
+            }
+        }
+    }
+
+    std::string body = request.substr(headerEnd + 4);
+    while (body.size() < mContentLength)
+    {
+        ssize_t length = recv(mClient, buffer, sizeof(buffer), 0);
+        if (length <= 0)
+        {
+            return false;
+        }
+        body.append(buffer, length);
+    }
+    if (mContentType.find("application/x-www-form-urlencoded") == 0)
+    {
+        parseArguments(body);
+    }
+
+    for (const Route &route : mRoutes)
+    {
+        if (route.uri == mUri && (route.method == HTTP_ANY || route.method == mMethod))
+        {
+            if (route.uploadHandler && mContentType.find("multipart/form-data") == 0)
+            {
+                handleUpload(route, body);
+            }
+            route.handler();
+            return true;
+        }
+    }
+    if (mNotFoundHandler)
+    {
+        mNotFoundHandler();
+    }
+    else
+    {
+        send(404, "text/plain", "Not Found");
+    }
+    return true;
+}
+
+void WebServer::parseArguments(const std::string &query)
+{
+    size_t pos = 0;
+    while (pos <= query.size())
+    {
+        size_t end = query.find('&', pos);
+        if (end == std::string::npos)
+        {
+            end = query.size();
+        }
+        std::string pair = query.substr(pos, end - pos);
+        size_t equal = pair.find('=');
+        if (!pair.empty())
+        {
+            mArgs.push_back(Pair(String(urlDecode(pair.substr(0, equal))),
+                                 String(equal == std::string::npos ? std::string() : urlDecode(pair.substr(equal + 1)))));
+        }
+        pos = end + 1;
+    }
+}
+
+// The first file of a multipart body is passed to the upload handler in buffers, like the device does
+void WebServer::handleUpload(const Route &route, const std::string &body)
+{
+    size_t boundaryPos = mContentType.find("boundary=");
+    if (boundaryPos == std::string::npos)
+    {
+        return;
+    }
+    std::string boundary = "--" + mContentType.substr(boundaryPos + 9);
+    size_t start = body.find("\r\n\r\n", body.find(boundary));
+    size_t end = body.find("\r\n" + boundary, start);
+    if (start == std::string::npos || end == std::string::npos)
+    {
+        return;
+    }
+    start += 4;
+    mUpload.status = UPLOAD_FILE_START;
+    mUpload.totalSize = 0;
+    mUpload.currentSize = 0;
+    route.uploadHandler();
+    while (start < end)
+    {
+        mUpload.status = UPLOAD_FILE_WRITE;
+        mUpload.currentSize = std::min((size_t)HTTP_UPLOAD_BUFLEN, end - start);
+        memcpy(mUpload.buf, body.data() + start, mUpload.currentSize);
+        mUpload.totalSize += mUpload.currentSize;
+        start += mUpload.currentSize;
+        route.uploadHandler();
+    }
+    mUpload.status = UPLOAD_FILE_END;
+    mUpload.currentSize = 0;
+    route.uploadHandler();
+}
+
+String WebServer::arg(const String &name) const
+{
+    for (const Pair &pair : mArgs)
+    {
+        if (pair.first == name)
+        {
+            return pair.second;
+        }
+    }
+    return String();
+}
+
+String WebServer::arg(int i) const
+{
+    return i < (int)mArgs.size() ? mArgs[i].second : String();
+}
+
+String WebServer::argName(int i) const
+{
+    return i < (int)mArgs.size() ? mArgs[i].first : String();
+}
+
+bool WebServer::hasArg(const String &name) const
+{
+    for (const Pair &pair : mArgs)
+    {
+        if (pair.first == name)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+String WebServer::header(const String &name) const
+{
+    for (const Pair &pair : mHeaders)
+    {
+        if (strcasecmp(pair.first.c_str(), name.c_str()) == 0)
+        {
+            return pair.second;
+        }
+    }
+    return String();
+}
+
+bool WebServer::authenticate(const char *username, const char *password)
+{
+    std::string credentials = std::string(username) + ":" + password;
+    return mAuthorization == "Basic " + base64Encode(credentials);
+}
+
+void WebServer::requestAuthentication()
+{
+    sendHeader("WWW-Authenticate", "Basic realm=\"Login Required\"");
+    send(401, "text/html", "Unauthorized");
+}
+
+void WebServer::sendHeader(const String &name, const String &value, bool first)
+{
+    String header = name;
+    header += ": ";
+    header += value;
+    header += "\r\n";
+    mResponseHeaders = first ? header + mResponseHeaders : mResponseHeaders + header;
+}
+
+void WebServer::sendHeaders(int code, const char *contentType, size_t contentLength)
+{
+    char line[64];
+    snprintf(line, sizeof(line), "HTTP/1.1 %d %s\r\n", code, getStatusText(code));
+    String headers = line;
+    if (contentType)
+    {
+        headers += "Content-Type: ";
+        headers += contentType;
+        headers += "\r\n";
+    }
+    if (mResponseLength == CONTENT_LENGTH_UNKNOWN)
+    {
+        mIsChunked = true;
+        headers += "Transfer-Encoding: chunked\r\n";
+    }
+    else
+    {
+        headers += "Content-Length: ";
+        headers += String((unsigned long)(mResponseLength == CONTENT_LENGTH_NOT_SET ? contentLength : mResponseLength));
+        headers += "\r\n";
+    }
+    headers += mResponseHeaders;
+    headers += "Connection: close\r\n\r\n";
+    write(headers.c_str(), headers.length());
+    mResponseHeaders = String();
+    mIsResponseSent = true;
+}
+
+void WebServer::send(int code, const char *contentType, const String &content)
+{
+    send_P(code, contentType, content.c_str(), content.length());
+}
+
+void WebServer::send_P(int code, PGM_P contentType, PGM_P content, size_t contentLength)
+{
+    sendHeaders(code, contentType, contentLength);
+    if (!mIsChunked)
+    {
+        write(content, contentLength);
+    }
+    else if (contentLength > 0)
+    {
+        sendContent(content, contentLength);
+    }
+}
+
+void WebServer::sendContent(const String &content)
+{
+    sendContent(content.c_str(), content.length());
+}
+
+// With an unknown length the content is sent in chunks, an empty one ends the response
+void WebServer::sendContent(const char *content, size_t contentLength)
+{
+    if (!mIsChunked)
+    {
+        write(content, contentLength);
+        return;
+    }
+    char size[16];
+    int length = snprintf(size, sizeof(size), "%zx\r\n", contentLength);
+    write(size, length);
+    write(content, contentLength);
+    write("\r\n", 2);
+    if (contentLength == 0)
+    {
+        mIsChunked = false;
+    }
+}
+
+void WebServer::sendContent_P(PGM_P content)
+{
+    sendContent(content, strlen(content));
+}
+
+void WebServer::write(const char *data, size_t length)
+{
+    while (mClient >= 0 && length > 0)
+    {
+        ssize_t sent = ::send(mClient, data, length, MSG_NOSIGNAL);
+        if (sent <= 0)
+        {
+            return;
+        }
+        data += sent;
+        length -= sent;
+    }
+}
+
+namespace mock
+{
+    uint16_t getHttpPort()
+    {
+        return httpPort;
+    }
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+// Host stand-in for the WebServer of ESP32, backed by a real socket on 127.0.0.1 at the port of mock::getHttpPort().
+// handleClient() serves one request per call and closes the connection
+
+#include <Arduino.h>
+#include <vector>
+
+#define CONTENT_LENGTH_UNKNOWN ((size_t)-1)
+#define CONTENT_LENGTH_NOT_SET ((size_t)-2)
+#define HTTP_UPLOAD_BUFLEN 1436
+
+enum HTTPMethod
+{
+    HTTP_ANY,
+    HTTP_GET,
+    HTTP_HEAD,
+    HTTP_POST,
+    HTTP_PUT,
+    HTTP_PATCH,
+    HTTP_DELETE,
+    HTTP_OPTIONS
+};
+
+enum HTTPUploadStatus
+{
+    UPLOAD_FILE_START,
+    UPLOAD_FILE_WRITE,
+    UPLOAD_FILE_END,
+    UPLOAD_FILE_ABORTED
+};
+
+typedef struct
+{
+    HTTPUploadStatus status;
+    String filename;
+    String name;
+    String type;
+    size_t totalSize;
+    size_t currentSize;
+    uint8_t buf[HTTP_UPLOAD_BUFLEN];
+} HTTPUpload;
+
+class WebServer
+{
+public:
+    typedef std::function<void(void)> THandlerFunction;
+
+    WebServer(int port = 80);
+    ~WebServer();
+
+    void begin();
+    void stop();
+    void close() { stop(); }
+    void handleClient();
+
+    void on(const String &uri, THandlerFunction handler);
+    void on(const String &uri, HTTPMethod method, THandlerFunction handler);
+    void on(const String &uri, HTTPMethod method, THandlerFunction handler, THandlerFunction uploadHandler);
+    void onNotFound(THandlerFunction handler);
+    void collectHeaders(const char *headerKeys[], const size_t headerKeysCount);
+
+    String uri() { return mUri; }
+    HTTPMethod method() { return mMethod; }
+    String arg(const String &name) const;
+    String arg(int i) const;
+    String argName(int i) const;
+    int args() const { return mArgs.size(); }
+    bool hasArg(const String &name) const;
+    String header(const String &name) const;
+    size_t clientContentLength() const { return mContentLength; }
+    HTTPUpload &upload() { return mUpload; }
+
+    bool authenticate(const char *username, const char *password);
+    void requestAuthentication();
+
+    void sendHeader(const String &name, const String &value, bool first = false);
+    void setContentLength(const size_t contentLength) { mResponseLength = contentLength; }
+    void send(int code, const char *contentType = nullptr, const String &content = String(""));
+    void send_P(int code, PGM_P contentType, PGM_P content, size_t contentLength);
+    void sendContent(const String &content);
+    void sendContent(const char *content, size_t contentLength);
+    void sendContent_P(PGM_P content);
+
+private:
+    struct Route
+    {
+        String uri;
+        HTTPMethod method;
+        THandlerFunction handler;
+        THandlerFunction uploadHandler;
+    };
+    typedef std::pair<String, String> Pair;
+
+    bool readRequest();
+    void parseArguments(const std::string &query);
+    void handleUpload(const Route &route, const std::string &body);
+    void sendHeaders(int code, const char *contentType, size_t contentLength);
+    void write(const char *data, size_t length);
+
+    int mListenSocket = -1;
+    int mClient = -1;
+    std::vector<Route> mRoutes;
+    THandlerFunction mNotFoundHandler;
+    std::vector<String> mHeaderKeys;
+
+    String mUri;
+    HTTPMethod mMethod = HTTP_ANY;
+    std::vector<Pair> mArgs;
+    std::vector<Pair> mHeaders;
+    std::string mAuthorization;
+    std::string mContentType;
+    size_t mContentLength = 0;
+    HTTPUpload mUpload;
+
+    String mResponseHeaders;
+    size_t mResponseLength = CONTENT_LENGTH_NOT_SET;
+    bool mIsChunked = false;
+    bool mIsResponseSent = false;
+};
@@ -0,0 +1,512 @@
+#include <WiFi.h>
+#include "Mock.h"
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+WiFiClass WiFi;
+
+namespace
+{
+    struct AccessPointData
+    {
+        std::string ssid;
+        std::string password;
+        uint8_t bssid[6];
+        uint8_t channel;
+        int8_t rssi;
+        wifi_auth_mode_t auth;
+        bool dhcp;
+    };
+
+    struct PendingEvent
+    {
+        unsigned long time;
+        uint32_t attempt; // Events of an older connection attempt are dropped, 0 for scans
+        arduino_event_id_t event;
+        uint8_t reason;
+    };
+
+    enum ScanState
+    {
+        SCAN_NONE,
+        SCAN_RUNNING,
+        SCAN_DONE
+    };
+
+    std::recursive_mutex mutex;
+    std::vector<AccessPointData> accessPoints;
+    std::vector<PendingEvent> pendingEvents;
+    std::vector<WiFiEventFuncCb> callbacks;
+
+    wifi_mode_t wifiMode = WIFI_OFF;
+    bool isAPRunning = false;
+    uint8_t apChannel = 1;
+
+    uint32_t attempt = 0;
+    bool isAttemptActive = false; // From WiFi.begin() until the attempt fails or the connection is lost
+    bool isAssociated = false;
+    wl_status_t staStatus = WL_IDLE_STATUS;
+    uint8_t staChannel = 0;
+    AccessPointData current;
+
+    ScanState scanState = SCAN_NONE;
+    std::vector<AccessPointData> scanResults;
+
+    unsigned long associateDelay = 0;
+    unsigned long dhcpDelay = 0;
+    unsigned long scanDelay = 0;
+    IPAddress gateway(192, 168, 1, 1);
+    const IPAddress LOCAL_IP(192, 168, 1, 50);
+
+    mock::WiFiStats stats = {};
+    std::atomic<bool> isYieldEnabled(false);
+    unsigned long splitChannelUpdateTime = 0;
+
+    // Called before each change of the radio state
+    void updateSplitChannelTime()
+    {
+        unsigned long now = millis();
+        if (isAPRunning && (wifiMode & WIFI_STA) && staChannel != 0 && staChannel != apChannel)
+        {
+            stats.splitChannelTime += now - splitChannelUpdateTime;
+        }
+        splitChannelUpdateTime = now;
+    }
+
+    void queueEvent(unsigned long delay, uint32_t eventAttempt, arduino_event_id_t event, uint8_t reason = 0)
+    {
+        PendingEvent pending = {millis() + delay, eventAttempt, event, reason};
+        auto pos = pendingEvents.end();
+        while (pos != pendingEvents.begin() && (long)((pos - 1)->time - pending.time) > 0)
+        {
+            --pos;
+        }
+        pendingEvents.insert(pos, pending);
+    }
+
+    // The station leaves the network, like WiFi.disconnect() on the device
+    void leave()
+    {
+        if (isAttemptActive)
+        {
+            queueEvent(0, 0, ARDUINO_EVENT_WIFI_STA_DISCONNECTED, WIFI_REASON_ASSOC_LEAVE);
+        }
+        attempt++;
+        isAttemptActive = false;
+        isAssociated = false;
+        staChannel = 0;
+        staStatus = WL_DISCONNECTED;
+    }
+
+    // Applied when the event is reported, so the state matches the events seen by the library
+    bool applyEvent(const PendingEvent &pending)
+    {
+        if (pending.attempt != 0 && pending.attempt != attempt)
+        {
+            return false;
+        }
+        switch (pending.event)
+        {
+        case ARDUINO_EVENT_WIFI_STA_CONNECTED:
+            isAssociated = true;
+            if (isAPRunning && apChannel != current.channel)
+            {
+                // The radio has a single channel, the AP follows the station
+                stats.apPullCount++;
+                apChannel = current.channel;
+            }
+            break;
+        case ARDUINO_EVENT_WIFI_STA_GOT_IP:
+            staStatus = WL_CONNECTED;
+            break;
+        case ARDUINO_EVENT_WIFI_STA_DISCONNECTED:
+            if (pending.attempt != 0)
+            {
+                isAttemptActive = false;
+                isAssociated = false;
+                staChannel = 0;
+                staStatus = pending.reason == WIFI_REASON_NO_AP_FOUND ? WL_NO_SSID_AVAIL : WL_DISCONNECTED;
+            }
+            break;
+        case ARDUINO_EVENT_WIFI_SCAN_DONE:
+            if (scanState != SCAN_RUNNING)
+            {
+                return false;
+            }
+            scanState = SCAN_DONE;
+            break;
+        default:
+            break;
+        }
+        return true;
+    }
+
+    void reportEvent(arduino_event_id_t event, uint8_t reason)
+    {
+        arduino_event_info_t info;
+        memset(&info, 0, sizeof(info));
+        if (event == ARDUINO_EVENT_WIFI_STA_DISCONNECTED)
+        {
+            info.wifi_sta_disconnected.reason = reason;
+        }
+        std::vector<WiFiEventFuncCb> registered;
+        {
+            std::lock_guard<std::recursive_mutex> lock(mutex);
+            registered = callbacks;
+        }
+        for (const WiFiEventFuncCb &callback : registered)
+        {
+            callback(event, info);
+        }
+    }
+}
+
+bool WiFiClass::mode(wifi_mode_t mode)
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    updateSplitChannelTime();
+    if (!(mode & WIFI_STA) && (wifiMode & WIFI_STA))
+    {
+        leave();
+    }
+    if (!(mode & WIFI_AP))
+    {
+        isAPRunning = false;
+    }
+    wifiMode = mode;
+    return true;
+}
+
+wifi_mode_t WiFiClass::getMode()
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    return wifiMode;
+}
+
+bool WiFiClass::softAP(const char *ssid, const char *password, int channel, int hidden, int maxConnection)
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    if (!ssid || ssid[0] == '\0' || (password && password[0] != '\0' && strlen(password) < 8))
+    {
+        return false;
+    }
+    updateSplitChannelTime();
+    wifiMode = (wifi_mode_t)(wifiMode | WIFI_AP);
+    isAPRunning = true;
+    // The AP cannot leave the channel of an associated station
+    apChannel = isAssociated ? current.channel : channel;
+    stats.softAPCount++;
+    return true;
+}
+
+bool WiFiClass::softAPConfig(IPAddress localIP, IPAddress gateway, IPAddress subnet)
+{
+    return true;
+}
+
+bool WiFiClass::softAPdisconnect(bool wifiOff)
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    updateSplitChannelTime();
+    isAPRunning = false;
+    wifiMode = (wifi_mode_t)(wifiMode & ~WIFI_AP);
+    return true;
+}
+
+wl_status_t WiFiClass::begin(const char *ssid, const char *password, int32_t channel, const uint8_t *bssid, bool connect)
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    updateSplitChannelTime();
+    if (isAttemptActive)
+    {
+        leave();
+    }
+    wifiMode = (wifi_mode_t)(wifiMode | WIFI_STA);
+    stats.beginCount++;
+    if (stats.firstBeginTime == 0)
+    {
+        stats.firstBeginTime = mock::hostMicros();
+    }
+
+    // The strongest access point of the network, on the given channel and BSSID if any
+    const AccessPointData *target = nullptr;
+    for (const AccessPointData &accessPoint : accessPoints)
+    {
+        if (accessPoint.ssid == ssid && (channel == 0 || accessPoint.channel == channel) &&
+            (!bssid || memcmp(accessPoint.bssid, bssid, 6) == 0) && (!target || accessPoint.rssi > target->rssi))
+        {
+            target = &accessPoint;
+        }
+    }
+    uint32_t id = ++attempt;
+    isAttemptActive = true;
+    isAssociated = false;
+    staStatus = WL_DISCONNECTED;
+    if (!target)
+    {
+        staChannel = channel;
+        queueEvent(associateDelay, id, ARDUINO_EVENT_WIFI_STA_DISCONNECTED, WIFI_REASON_NO_AP_FOUND);
+        return staStatus;
+    }
+    current = *target;
+    staChannel = target->channel;
+    if (target->auth != WIFI_AUTH_OPEN && target->password != (password ? password : ""))
+    {
+        queueEvent(associateDelay, id, ARDUINO_EVENT_WIFI_STA_DISCONNECTED, WIFI_REASON_AUTH_FAIL);
+        return staStatus;
+    }
+    queueEvent(associateDelay, id, ARDUINO_EVENT_WIFI_STA_CONNECTED);
+    if (target->dhcp)
+    {
+        queueEvent(associateDelay + dhcpDelay, id, ARDUINO_EVENT_WIFI_STA_GOT_IP);
+    }
+    return staStatus;
+}
+
+bool WiFiClass::disconnect(bool wifiOff, bool eraseAP)
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    updateSplitChannelTime();
+    leave();
+    if (wifiOff)
+    {
+        wifiMode = (wifi_mode_t)(wifiMode & ~WIFI_STA);
+    }
+    return true;
+}
+
+bool WiFiClass::setAutoReconnect(bool autoReconnect)
+{
+    return true;
+}
+
+wl_status_t WiFiClass::status()
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    return staStatus;
+}
+
+bool WiFiClass::isConnected()
+{
+    return status() == WL_CONNECTED;
+}
+
+uint8_t *WiFiClass::BSSID()
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    return isAssociated ? current.bssid : nullptr;
+}
+
+int32_t WiFiClass::channel()
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    return isAssociated ? current.channel : apChannel;
+}
+
+int8_t WiFiClass::RSSI()
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    return isAssociated ? current.rssi : 0;
+}
+
+IPAddress WiFiClass::localIP()
+{
+    if (isYieldEnabled)
+    {
+        std::this_thread::yield();
+    }
+    return isConnected() ? LOCAL_IP : IPAddress();
+}
+
+IPAddress WiFiClass::gatewayIP()
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    return staStatus == WL_CONNECTED ? gateway : IPAddress();
+}
+
+int16_t WiFiClass::scanNetworks(bool async, bool showHidden, bool passive, uint32_t maxMsPerChannel, uint8_t channel,
+                                const char *ssid, const uint8_t *bssid)
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    if (scanState == SCAN_RUNNING)
+    {
+        return WIFI_SCAN_RUNNING;
+    }
+    stats.scanCount++;
+    scanResults.clear();
+    for (const AccessPointData &accessPoint : accessPoints)
+    {
+        if ((channel == 0 || accessPoint.channel == channel) && (!ssid || accessPoint.ssid == ssid))
+        {
+            scanResults.push_back(accessPoint);
+        }
+    }
+    if (!async)
+    {
+        scanState = SCAN_DONE;
+        return scanResults.size();
+    }
+    scanState = SCAN_RUNNING;
+    queueEvent(scanDelay, 0, ARDUINO_EVENT_WIFI_SCAN_DONE);
+    return WIFI_SCAN_RUNNING;
+}
+
+int16_t WiFiClass::scanComplete()
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    switch (scanState)
+    {
+    case SCAN_RUNNING:
+        return WIFI_SCAN_RUNNING;
+    case SCAN_DONE:
+        return scanResults.size();
+    default:
+        return WIFI_SCAN_FAILED;
+    }
+}
+
+void WiFiClass::scanDelete()
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    scanResults.clear();
+    scanState = SCAN_NONE;
+}
+
+bool WiFiClass::getNetworkInfo(uint8_t index, String &ssid, uint8_t &encType, int32_t &rssi, uint8_t *&bssid, int32_t &channel)
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    if (scanState != SCAN_DONE || index >= scanResults.size())
+    {
+        return false;
+    }
+    AccessPointData &accessPoint = scanResults[index];
+    ssid = accessPoint.ssid.c_str();
+    encType = accessPoint.auth;
+    rssi = accessPoint.rssi;
+    bssid = accessPoint.bssid;
+    channel = accessPoint.channel;
+    return true;
+}
+
+wifi_event_id_t WiFiClass::onEvent(WiFiEventFuncCb callback, arduino_event_id_t event)
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    callbacks.push_back(callback);
+    return callbacks.size();
+}
+
+namespace mock
+{
+    void addAccessPoint(const AccessPoint &accessPoint)
+    {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+        AccessPointData data;
+        data.ssid = accessPoint.ssid;
+        data.password = accessPoint.password ? accessPoint.password : "";
+        memcpy(data.bssid, accessPoint.bssid, sizeof(data.bssid));
+        data.channel = accessPoint.channel;
+        data.rssi = accessPoint.rssi;
+        data.auth = accessPoint.auth;
+        data.dhcp = accessPoint.dhcp;
+        accessPoints.push_back(data);
+    }
+
+    void removeAccessPoints()
+    {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+        accessPoints.clear();
+    }
+
+    void setRssi(const uint8_t *bssid, int8_t rssi)
+    {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+        for (AccessPointData &accessPoint : accessPoints)
+        {
+            if (memcmp(accessPoint.bssid, bssid, 6) == 0)
+            {
+                accessPoint.rssi = rssi;
+            }
+        }
+        if (memcmp(current.bssid, bssid, 6) == 0)
+        {
+            current.rssi = rssi;
+        }
+    }
+
+    void setConnectDelay(unsigned long associate, unsigned long dhcp)
+    {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+        associateDelay = associate;
+        dhcpDelay = dhcp;
+    }
+
+    void setScanDelay(unsigned long ms)
+    {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+        scanDelay = ms;
+    }
+
+    void setGateway(IPAddress address)
+    {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+        gateway = address;
+    }
+
+    void disconnect(uint8_t reason)
+    {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+        if (!isAttemptActive)
+        {
+            return;
+        }
+        updateSplitChannelTime();
+        queueEvent(0, attempt, ARDUINO_EVENT_WIFI_STA_DISCONNECTED, reason);
+    }
+
+    void setDriverYield(bool yield)
+    {
+        isYieldEnabled = yield;
+    }
+
+    void fireEvent(arduino_event_id_t event, uint8_t reason)
+    {
+        reportEvent(event, reason);
+    }
+
+    void deliverEvents()
+    {
+        for (;;)
+        {
+            PendingEvent pending;
+            {
+                std::lock_guard<std::recursive_mutex> lock(mutex);
+                if (pendingEvents.empty() || (long)(millis() - pendingEvents.front().time) < 0)
+                {
+                    return;
+                }
+                pending = pendingEvents.front();
+                pendingEvents.erase(pendingEvents.begin());
+                updateSplitChannelTime();
+                if (!applyEvent(pending))
+                {
+                    continue;
+                }
+            }
+            reportEvent(pending.event, pending.reason);
+        }
+    }
+
+    WiFiStats getWiFiStats()
+    {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+        updateSplitChannelTime();
+        WiFiStats result = stats;
+        result.apChannel = isAPRunning ? apChannel : 0;
+        result.staChannel = staChannel;
+        return result;
+    }
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+// Host stand-in for the WiFi class of ESP32. Scans and connections are scripted with the access points of Mock.h,
+// their events are reported by mock::deliverEvents()
+
+#include <Arduino.h>
+
+typedef enum
+{
+    WIFI_OFF = 0,
+    WIFI_STA = 1,
+    WIFI_AP = 2,
+    WIFI_AP_STA = 3
+} wifi_mode_t;
+
+typedef enum
+{
+    WIFI_AUTH_OPEN = 0,
+    WIFI_AUTH_WEP,
+    WIFI_AUTH_WPA_PSK,
+    WIFI_AUTH_WPA2_PSK,
+    WIFI_AUTH_WPA_WPA2_PSK,
+    WIFI_AUTH_WPA2_ENTERPRISE,
+    WIFI_AUTH_WPA3_PSK,
+    WIFI_AUTH_WPA2_WPA3_PSK,
+    WIFI_AUTH_WAPI_PSK
+} wifi_auth_mode_t;
+
+typedef enum
+{
+    WL_IDLE_STATUS = 0,
+    WL_NO_SSID_AVAIL = 1,
+    WL_SCAN_COMPLETED = 2,
+    WL_CONNECTED = 3,
+    WL_CONNECT_FAILED = 4,
+    WL_CONNECTION_LOST = 5,
+    WL_DISCONNECTED = 6
+} wl_status_t;
+
+#define WIFI_SCAN_RUNNING (-1)
+#define WIFI_SCAN_FAILED (-2)
+
+typedef enum
+{
+    ARDUINO_EVENT_WIFI_READY = 0,
+    ARDUINO_EVENT_WIFI_SCAN_DONE,
+    ARDUINO_EVENT_WIFI_STA_START,
+    ARDUINO_EVENT_WIFI_STA_STOP,
+    ARDUINO_EVENT_WIFI_STA_CONNECTED,
+    ARDUINO_EVENT_WIFI_STA_DISCONNECTED,
+    ARDUINO_EVENT_WIFI_STA_AUTHMODE_CHANGE,
+    ARDUINO_EVENT_WIFI_STA_GOT_IP,
+    ARDUINO_EVENT_WIFI_STA_GOT_IP6,
+    ARDUINO_EVENT_WIFI_STA_LOST_IP
+} arduino_event_id_t;
+
+typedef enum
+{
+    WIFI_REASON_UNSPECIFIED = 1,
+    WIFI_REASON_AUTH_EXPIRE = 2,
+    WIFI_REASON_AUTH_LEAVE = 3,
+    WIFI_REASON_ASSOC_EXPIRE = 4,
+    WIFI_REASON_ASSOC_LEAVE = 8,
+    WIFI_REASON_4WAY_HANDSHAKE_TIMEOUT = 15,
+    WIFI_REASON_BEACON_TIMEOUT = 200,
+    WIFI_REASON_NO_AP_FOUND = 201,
+    WIFI_REASON_AUTH_FAIL = 202,
+    WIFI_REASON_ASSOC_FAIL = 203,
+    WIFI_REASON_HANDSHAKE_TIMEOUT = 204,
+    WIFI_REASON_CONNECTION_FAIL = 205
+} wifi_err_reason_t;
+
+typedef struct
+{
+    uint8_t ssid[32];
+    uint8_t ssid_len;
+    uint8_t bssid[6];
+    uint8_t reason;
+} wifi_event_sta_disconnected_t;
+
+typedef struct
+{
+    uint8_t ssid[32];
+    uint8_t ssid_len;
+    uint8_t bssid[6];
+    uint8_t channel;
+    wifi_auth_mode_t authmode;
+} wifi_event_sta_connected_t;
+
+typedef union
+{
+    wifi_event_sta_connected_t wifi_sta_connected;
+    wifi_event_sta_disconnected_t wifi_sta_disconnected;
+} arduino_event_info_t;
+
+typedef std::function<void(arduino_event_id_t event, arduino_event_info_t info)> WiFiEventFuncCb;
+typedef int wifi_event_id_t;
+
+class WiFiClass
+{
+public:
+    bool mode(wifi_mode_t mode);
+    wifi_mode_t getMode();
+    bool softAP(const char *ssid, const char *password = nullptr, int channel = 1, int hidden = 0, int maxConnection = 4);
+    bool softAPConfig(IPAddress localIP, IPAddress gateway, IPAddress subnet);
+    bool softAPdisconnect(bool wifiOff = false);
+
+    wl_status_t begin(const char *ssid, const char *password = nullptr, int32_t channel = 0, const uint8_t *bssid = nullptr,
+                      bool connect = true);
+    bool disconnect(bool wifiOff = false, bool eraseAP = false);
+    bool setAutoReconnect(bool autoReconnect);
+    wl_status_t status();
+    bool isConnected();
+    uint8_t *BSSID();
+    int32_t channel();
+    int8_t RSSI();
+    IPAddress localIP();
+    IPAddress gatewayIP();
+
+    int16_t scanNetworks(bool async = false, bool showHidden = false, bool passive = false, uint32_t maxMsPerChannel = 300,
+                         uint8_t channel = 0, const char *ssid = nullptr, const uint8_t *bssid = nullptr);
+    int16_t scanComplete();
+    void scanDelete();
+    bool getNetworkInfo(uint8_t index, String &ssid, uint8_t &encType, int32_t &rssi, uint8_t *&bssid, int32_t &channel);
+
+    wifi_event_id_t onEvent(WiFiEventFuncCb callback, arduino_event_id_t event = ARDUINO_EVENT_WIFI_READY);
+};
+
+extern WiFiClass WiFi;
@@ -0,0 +1,375 @@
+#include <lwip/dns.h>
+#include <lwip/tcp.h>
+#include <lwip/tcpip.h>
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <functional>
+#include <mutex>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#define TCP_MSS 1460
+#define TCPIP_MBOX_SIZE 32 // Messages waiting for the tcpip thread, like the mailbox of lwIP
+
+// Like lwIP, the functions abort when they are called outside the tcpip thread
+#define CHECK_TCPIP_THREAD()                                                         \
+    if (std::this_thread::get_id() != tcpipThreadId)                                 \
+    {                                                                                \
+        fprintf(stderr, "%s() called outside the tcpip thread\n", __func__);         \
+        abort();                                                                     \
+    }
+
+struct tcp_pcb
+{
+    int fd = -1;
+    void *arg = nullptr;
+    tcp_err_fn errf = nullptr;
+    tcp_recv_fn recv = nullptr;
+    tcp_connected_fn connected = nullptr;
+    bool isConnecting = false;
+    bool isFreed = false;
+    err_t pendingError = ERR_OK; // Reported by the next poll, lwIP never calls back from tcp_connect()
+};
+
+static std::once_flag startFlag;
+static std::thread::id tcpipThreadId;
+static std::mutex jobMutex;
+static std::vector<std::function<void()>> jobs; // Resolutions of dns_gethostbyname()
+// Messages of tcpip_callback(), a fixed ring so that posting them does not allocate, like the message pool of lwIP
+static struct
+{
+    tcpip_callback_fn function;
+    void *ctx;
+} mbox[TCPIP_MBOX_SIZE];
+static size_t mboxHead = 0;
+static size_t mboxCount = 0;
+static std::vector<tcp_pcb *> pcbs; // Only used in the tcpip thread
+
+static void freePcb(tcp_pcb *pcb, bool reset)
+{
+    if (pcb->fd >= 0)
+    {
+        if (reset)
+        {
+            linger option = {1, 0};
+            setsockopt(pcb->fd, SOL_SOCKET, SO_LINGER, &option, sizeof(option));
+        }
+        close(pcb->fd);
+        pcb->fd = -1;
+    }
+    pcb->isFreed = true;
+}
+
+// The connection is freed before its error callback, like lwIP does
+static void reportError(tcp_pcb *pcb, err_t err)
+{
+    tcp_err_fn errf = pcb->errf;
+    void *arg = pcb->arg;
+    freePcb(pcb, false);
+    if (errf)
+    {
+        errf(arg, err);
+    }
+}
+
+static void poll(tcp_pcb *pcb)
+{
+    if (pcb->isConnecting)
+    {
+        int error = 0;
+        socklen_t length = sizeof(error);
+        getsockopt(pcb->fd, SOL_SOCKET, SO_ERROR, &error, &length);
+        pcb->isConnecting = false;
+        if (error != 0)
+        {
+            reportError(pcb, error == ECONNREFUSED ? ERR_RST : ERR_ABRT);
+        }
+        else if (pcb->connected)
+        {
+            pcb->connected(pcb->arg, pcb, ERR_OK);
+        }
+        return;
+    }
+
+    uint8_t buffer[TCP_MSS];
+    ssize_t length = ::recv(pcb->fd, buffer, sizeof(buffer), 0);
+    if (length < 0)
+    {
+        if (errno != EAGAIN && errno != EWOULDBLOCK)
+        {
+            reportError(pcb, ERR_RST);
+        }
+        return;
+    }
+    pbuf *p = nullptr;
+    if (length > 0)
+    {
+        p = new pbuf();
+        p->payload = malloc(length);
+        memcpy(p->payload, buffer, length);
+        p->tot_len = p->len = length;
+    }
+    if (pcb->recv)
+    {
+        pcb->recv(pcb->arg, pcb, p, ERR_OK);
+    }
+    else
+    {
+        // Default of lwIP: the data is dropped and the connection closed
+        if (p)
+        {
+            pbuf_free(p);
+        }
+        tcp_close(pcb);
+    }
+}
+
+static void run()
+{
+    tcpipThreadId = std::this_thread::get_id();
+    std::vector<pollfd> fds;
+    std::vector<tcp_pcb *> polled;
+    while (true)
+    {
+        while (true)
+        {
+            tcpip_callback_fn function;
+            void *ctx;
+            {
+                std::lock_guard<std::mutex> lock(jobMutex);
+                if (mboxCount == 0)
+                {
+                    break;
+                }
+                function = mbox[mboxHead].function;
+                ctx = mbox[mboxHead].ctx;
+                mboxHead = (mboxHead + 1) % TCPIP_MBOX_SIZE;
+                mboxCount--;
+            }
+            function(ctx);
+        }
+        std::vector<std::function<void()>> pending;
+        {
+            std::lock_guard<std::mutex> lock(jobMutex);
+            pending.swap(jobs);
+        }
+        for (const std::function<void()> &job : pending)
+        {
+            job();
+        }
+
+        fds.clear();
+        polled.clear();
+        for (tcp_pcb *pcb : pcbs)
+        {
+            if (pcb->isFreed || pcb->fd < 0)
+            {
+                continue;
+            }
+            if (pcb->pendingError != ERR_OK)
+            {
+                err_t err = pcb->pendingError;
+                pcb->pendingError = ERR_OK;
+                reportError(pcb, err);
+                continue;
+            }
+            fds.push_back({pcb->fd, (short)(pcb->isConnecting ? POLLOUT : POLLIN), 0});
+            polled.push_back(pcb);
+        }
+        ::poll(fds.data(), fds.size(), 1);
+        for (size_t i = 0; i < fds.size(); i++)
+        {
+            // A callback can free a connection polled after it
+            if (fds[i].revents != 0 && !polled[i]->isFreed)
+            {
+                poll(polled[i]);
+            }
+        }
+
+        for (size_t i = 0; i < pcbs.size();)
+        {
+            if (pcbs[i]->isFreed)
+            {
+                delete pcbs[i];
+                pcbs.erase(pcbs.begin() + i);
+            }
+            else
+            {
+                i++;
+            }
+        }
+    }
+}
+
+err_t tcpip_callback(tcpip_callback_fn function, void *ctx)
+{
+    std::call_once(startFlag, []()
+                   { std::thread(run).detach(); });
+    std::lock_guard<std::mutex> lock(jobMutex);
+    if (mboxCount == TCPIP_MBOX_SIZE)
+    {
+        return ERR_MEM;
+    }
+    mbox[(mboxHead + mboxCount) % TCPIP_MBOX_SIZE] = {function, ctx};
+    mboxCount++;
+    return ERR_OK;
+}
+
+struct tcp_pcb *tcp_new(void)
+{
+    CHECK_TCPIP_THREAD();
+    tcp_pcb *pcb = new tcp_pcb();
+    pcbs.push_back(pcb);
+    return pcb;
+}
+
+void tcp_arg(struct tcp_pcb *pcb, void *arg)
+{
+    CHECK_TCPIP_THREAD();
+    pcb->arg = arg;
+}
+
+void tcp_err(struct tcp_pcb *pcb, tcp_err_fn err)
+{
+    CHECK_TCPIP_THREAD();
+    pcb->errf = err;
+}
+
+void tcp_recv(struct tcp_pcb *pcb, tcp_recv_fn recv)
+{
+    CHECK_TCPIP_THREAD();
+    pcb->recv = recv;
+}
+
+err_t tcp_connect(struct tcp_pcb *pcb, const ip_addr_t *ipaddr, uint16_t port, tcp_connected_fn connected)
+{
+    CHECK_TCPIP_THREAD();
+    pcb->fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (pcb->fd < 0)
+    {
+        return ERR_MEM;
+    }
+    fcntl(pcb->fd, F_SETFL, O_NONBLOCK);
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = ipaddr->addr;
+    address.sin_port = htons(port);
+    pcb->connected = connected;
+    pcb->isConnecting = true;
+    if (::connect(pcb->fd, (sockaddr *)&address, sizeof(address)) != 0 && errno != EINPROGRESS)
+    {
+        pcb->pendingError = errno == ECONNREFUSED ? ERR_RST : ERR_ABRT;
+    }
+    return ERR_OK;
+}
+
+err_t tcp_write(struct tcp_pcb *pcb, const void *dataptr, uint16_t len, uint8_t apiflags)
+{
+    CHECK_TCPIP_THREAD();
+    if (pcb->fd < 0 || pcb->isConnecting)
+    {
+        return ERR_CONN;
+    }
+    return ::send(pcb->fd, dataptr, len, MSG_NOSIGNAL) == len ? ERR_OK : ERR_MEM;
+}
+
+err_t tcp_output(struct tcp_pcb *pcb)
+{
+    CHECK_TCPIP_THREAD();
+    return ERR_OK;
+}
+
+void tcp_recved(struct tcp_pcb *pcb, uint16_t len)
+{
+    CHECK_TCPIP_THREAD();
+}
+
+err_t tcp_close(struct tcp_pcb *pcb)
+{
+    CHECK_TCPIP_THREAD();
+    freePcb(pcb, false);
+    return ERR_OK;
+}
+
+void tcp_abort(struct tcp_pcb *pcb)
+{
+    CHECK_TCPIP_THREAD();
+    tcp_err_fn errf = pcb->errf;
+    void *arg = pcb->arg;
+    freePcb(pcb, true);
+    if (errf)
+    {
+        errf(arg, ERR_ABRT);
+    }
+}
+
+uint16_t pbuf_copy_partial(const struct pbuf *p, void *dataptr, uint16_t len, uint16_t offset)
+{
+    uint16_t copied = 0;
+    for (; p && copied < len; p = p->next)
+    {
+        if (offset >= p->len)
+        {
+            offset -= p->len;
+            continue;
+        }
+        uint16_t length = p->len - offset < len - copied ? p->len - offset : len - copied;
+        memcpy((uint8_t *)dataptr + copied, (const uint8_t *)p->payload + offset, length);
+        copied += length;
+        offset = 0;
+    }
+    return copied;
+}
+
+uint8_t pbuf_free(struct pbuf *p)
+{
+    uint8_t count = 0;
+    while (p)
+    {
+        pbuf *next = p->next;
+        free(p->payload);
+        delete p;
+        p = next;
+        count++;
+    }
+    return count;
+}
+
+err_t dns_gethostbyname(const char *hostname, ip_addr_t *addr, dns_found_callback found, void *callback_arg)
+{
+    CHECK_TCPIP_THREAD();
+    in_addr address;
+    if (inet_pton(AF_INET, hostname, &address) == 1)
+    {
+        addr->addr = address.s_addr;
+        return ERR_OK;
+    }
+    std::string name = hostname;
+    std::lock_guard<std::mutex> lock(jobMutex);
+    jobs.push_back([name, found, callback_arg]()
+                   {
+                       addrinfo hints = {};
+                       hints.ai_family = AF_INET;
+                       addrinfo *result = nullptr;
+                       if (getaddrinfo(name.c_str(), nullptr, &hints, &result) != 0 || !result)
+                       {
+                           found(name.c_str(), nullptr, callback_arg);
+                           return;
+                       }
+                       ip_addr_t resolved = {((sockaddr_in *)result->ai_addr)->sin_addr.s_addr};
+                       freeaddrinfo(result);
+                       found(name.c_str(), &resolved, callback_arg);
+                   });
+    return ERR_INPROGRESS;
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <lwip/err.h>
+#include <lwip/ip_addr.h>
+
+typedef void (*dns_found_callback)(const char *name, const ip_addr_t *ipaddr, void *callback_arg);
+
+// An IP address is answered at once, a name is resolved by the host and reported to found from the tcpip thread
+err_t dns_gethostbyname(const char *hostname, ip_addr_t *addr, dns_found_callback found, void *callback_arg);
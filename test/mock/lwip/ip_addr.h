@@ -0,0 +1,11 @@
+#pragma once
+
+#include <stdint.h>
+
+// IPv4 only, the address is in network byte order like IPAddress keeps it
+typedef struct
+{
+    uint32_t addr;
+} ip_addr_t;
+
+#define IPADDR4_INIT(u32val) {u32val}
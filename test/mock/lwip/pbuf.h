@@ -0,0 +1,14 @@
+#pragma once
+
+#include <lwip/err.h>
+
+struct pbuf
+{
+    struct pbuf *next;
+    void *payload;
+    uint16_t tot_len;
+    uint16_t len;
+};
+
+uint16_t pbuf_copy_partial(const struct pbuf *p, void *dataptr, uint16_t len, uint16_t offset);
+uint8_t pbuf_free(struct pbuf *p);
@@ -0,0 +1,28 @@
+#pragma once
+
+// Host stand-in for the raw TCP API of lwIP. The connections are sockets polled by the tcpip thread of tcpip.h,
+// every function must be called from that thread
+
+#include <lwip/err.h>
+#include <lwip/ip_addr.h>
+#include <lwip/pbuf.h>
+
+#define TCP_WRITE_FLAG_COPY 0x01
+#define TCP_WRITE_FLAG_MORE 0x02
+
+struct tcp_pcb;
+
+typedef err_t (*tcp_connected_fn)(void *arg, struct tcp_pcb *tpcb, err_t err);
+typedef err_t (*tcp_recv_fn)(void *arg, struct tcp_pcb *tpcb, struct pbuf *p, err_t err);
+typedef void (*tcp_err_fn)(void *arg, err_t err);
+
+struct tcp_pcb *tcp_new(void);
+void tcp_arg(struct tcp_pcb *pcb, void *arg);
+void tcp_err(struct tcp_pcb *pcb, tcp_err_fn err);
+void tcp_recv(struct tcp_pcb *pcb, tcp_recv_fn recv);
+err_t tcp_connect(struct tcp_pcb *pcb, const ip_addr_t *ipaddr, uint16_t port, tcp_connected_fn connected);
+err_t tcp_write(struct tcp_pcb *pcb, const void *dataptr, uint16_t len, uint8_t apiflags);
+err_t tcp_output(struct tcp_pcb *pcb);
+void tcp_recved(struct tcp_pcb *pcb, uint16_t len);
+err_t tcp_close(struct tcp_pcb *pcb);
+void tcp_abort(struct tcp_pcb *pcb);
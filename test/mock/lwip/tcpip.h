@@ -0,0 +1,8 @@
+#pragma once
+
+#include <lwip/err.h>
+
+typedef void (*tcpip_callback_fn)(void *ctx);
+
+// Run function in the tcpip thread, it is started by the first call
+err_t tcpip_callback(tcpip_callback_fn function, void *ctx);
@@ -0,0 +1,25 @@
+# cmake -DSIZE=<size tool> -DCONFIGURATIONS="<name>=<object>;..." -P size_table.cmake
+# Prints the flash (text + data) and RAM (data + bss) of the library object in each configuration as a Markdown table
+set(baseline "")
+message("| Configuration | Flash | RAM | Flash vs default | RAM vs default |")
+message("|---|---|---|---|---|")
+foreach(configuration ${CONFIGURATIONS})
+    string(REPLACE "=" ";" configuration "${configuration}")
+    list(GET configuration 0 name)
+    list(GET configuration 1 object)
+    execute_process(COMMAND ${SIZE} ${object} OUTPUT_VARIABLE output RESULT_VARIABLE result)
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "${SIZE} failed for ${object}")
+    endif()
+    # Second line of the Berkeley format: text data bss dec hex filename
+    string(REGEX MATCH "\n *([0-9]+)[ \t]+([0-9]+)[ \t]+([0-9]+)" line "${output}")
+    math(EXPR flash "${CMAKE_MATCH_1} + ${CMAKE_MATCH_2}")
+    math(EXPR ram "${CMAKE_MATCH_2} + ${CMAKE_MATCH_3}")
+    if(baseline STREQUAL "")
+        set(baseline ${flash})
+        set(baselineRam ${ram})
+    endif()
+    math(EXPR flashDelta "${flash} - ${baseline}")
+    math(EXPR ramDelta "${ram} - ${baselineRam}")
+    message("| ${name} | ${flash} | ${ram} | ${flashDelta} | ${ramDelta} |")
+endforeach()
@@ -0,0 +1,85 @@
+#pragma once
+
+// Test framework of the host build. Each test runs in its own process, so it starts with the static state of a fresh boot
+
+#include <AsyncWiFiManager.h>
+#include "Mock.h"
+
+#include <stdio.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+struct TestCase
+{
+    TestCase(const char *name, void (*function)());
+};
+
+#define TEST(name)                                  \
+    static void name();                             \
+    static TestCase name##TestCase(#name, name);    \
+    static void name()
+
+#define CHECK(condition)                                                                \
+    do                                                                                  \
+    {                                                                                   \
+        if (!(condition))                                                               \
+        {                                                                               \
+            testFailed(__FILE__, __LINE__, "CHECK(" #condition ")", nullptr, nullptr); \
+        }                                                                               \
+    } while (0)
+
+#define CHECK_EQ(actual, expected)                                                                      \
+    do                                                                                                  \
+    {                                                                                                   \
+        long long actualValue = (long long)(actual);                                                    \
+        long long expectedValue = (long long)(expected);                                                \
+        if (actualValue != expectedValue)                                                               \
+        {                                                                                               \
+            testFailed(__FILE__, __LINE__, "CHECK_EQ(" #actual ", " #expected ")",                      \
+                       std::to_string(actualValue).c_str(), std::to_string(expectedValue).c_str());    \
+        }                                                                                               \
+    } while (0)
+
+#define CHECK_STR(actual, expected)                                                                     \
+    do                                                                                                  \
+    {                                                                                                   \
+        const char *actualValue = (actual);                                                             \
+        const char *expectedValue = (expected);                                                         \
+        if (strcmp(actualValue, expectedValue) != 0)                                                    \
+        {                                                                                               \
+            testFailed(__FILE__, __LINE__, "CHECK_STR(" #actual ", " #expected ")", actualValue, expectedValue); \
+        }                                                                                               \
+    } while (0)
+
+[[noreturn]] void testFailed(const char *file, int line, const char *check, const char *actual, const char *expected);
+
+// Directory of the running test, removed when it ends. The file system of the library is kept in its "fs" subdirectory
+const char *getTestDirectory();
+
+// Call loop() like the sketch would, with the events of the WiFi mock delivered before each call.
+// With the manual clock the time moves by step (ms) after each call
+void runFor(unsigned long ms, unsigned long step = 10);
+// Same until condition is true, returns false on timeout
+template <typename Condition>
+bool runUntil(Condition condition, unsigned long timeout, unsigned long step = 10)
+{
+    unsigned long start = millis();
+    while (!condition())
+    {
+        if ((unsigned long)(millis() - start) >= timeout)
+        {
+            return false;
+        }
+        runFor(step, step);
+    }
+    return true;
+}
+
+// Send a request to the config portal and call loop() until the answer is complete. Returns the status code, -1 on error.
+// body receives the content of the answer, without the chunked encoding
+int httpRequest(const char *method, const char *path, const char *content = nullptr, std::string *body = nullptr,
+                const char *headers = "");
+
+// Value below which percent % of the samples are, the samples are sorted
+unsigned long getPercentile(std::vector<unsigned long> &samples, int percent);
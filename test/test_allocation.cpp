@@ -0,0 +1,144 @@
+#include "test.h"
+
+#include <atomic>
+#include <new>
+
+// Once connected, or with the config portal idle, loop() must not allocate: the heap of long running devices would
+// fragment. Allocations are counted in the calls of loop() only, the mocks driving the test may allocate
+
+static thread_local bool isCounting = false;
+static std::atomic<unsigned long> allocationCount(0);
+
+void *operator new(size_t size)
+{
+    if (isCounting)
+    {
+        allocationCount++;
+    }
+    void *p = malloc(size ? size : 1);
+    if (!p)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void *p, size_t size) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void *p, size_t size) noexcept
+{
+    free(p);
+}
+
+struct AsyncWiFiManagerTest
+{
+    static uint8_t getScanResultCount()
+    {
+        return AsyncWiFiManager::mScanResultCount;
+    }
+
+    static unsigned long getLastScanTime()
+    {
+        return AsyncWiFiManager::mLastScanTime;
+    }
+};
+
+static const mock::AccessPoint HOME = {"home", "password1", {0x02, 0, 0, 0, 0, 1}, 6, -50, WIFI_AUTH_WPA2_PSK, true};
+
+// Count the allocations of loop() for duration (ms), returns the number of calls. With the manual clock the time
+// moves by step (ms) after each call
+static unsigned long countAllocations(unsigned long duration, unsigned long step = 1)
+{
+    unsigned long loopCount = 0;
+    unsigned long start = millis();
+    allocationCount = 0;
+    while ((unsigned long)(millis() - start) < duration)
+    {
+        mock::deliverEvents();
+        isCounting = true;
+        AsyncWiFiManager::loop();
+        isCounting = false;
+        loopCount++;
+        mock::advance(step);
+    }
+    return loopCount;
+}
+
+static void sink(uint8_t level, const char *message)
+{
+}
+
+TEST(countsAllocations)
+{
+    isCounting = true;
+    String text("longer than the small string buffer of the library");
+    isCounting = false;
+    CHECK(allocationCount > 0);
+}
+
+TEST(connectedLoopDoesNotAllocate)
+{
+    AsyncWiFiManager::setLogSink(sink);
+    mock::addAccessPoint(HOME);
+    // The health probes get a reset from a closed port of the host
+    mock::setGateway(IPAddress(127, 0, 0, 1));
+    AsyncWiFiManager::setHealthMonitorEnable(true);
+    AsyncWiFiHealthPolicy policy = AsyncWiFiManager::getHealthPolicy();
+    policy.probeInterval = 100;
+    policy.gatewayPort = 9;
+    AsyncWiFiManager::setHealthPolicy(policy);
+    AsyncWiFiManager::setWifiInformation("home", "password1");
+    AsyncWiFiManager::begin();
+    CHECK(runUntil([]()
+                   { return AsyncWiFiManager::getState() == ASYNC_WIFI_STATE_CONNECTED; },
+                   10000, 1));
+    runFor(500, 1);
+
+    uint32_t probeCount = AsyncWiFiManager::getHealthStats().probeCount;
+    unsigned long loopCount = countAllocations(2000);
+    printf("Connected: %lu loop() calls, %lu health probes, %lu allocations\n", loopCount,
+           (unsigned long)(AsyncWiFiManager::getHealthStats().probeCount - probeCount), allocationCount.load());
+    CHECK_EQ(allocationCount, 0);
+    CHECK(AsyncWiFiManager::getHealthStats().probeCount - probeCount >= 10);
+    CHECK_EQ(AsyncWiFiManager::getState(), ASYNC_WIFI_STATE_CONNECTED);
+}
+
+// With the default scan interval, so that the background rescans refill the scan cache in place
+TEST(idlePortalLoopDoesNotAllocate)
+{
+    mock::setManualClock(true);
+    mock::addAccessPoint(HOME);
+    AsyncWiFiManager::setLogSink(sink);
+    AsyncWiFiManager::begin();
+    // The first scan of the portal fills the scan cache
+    runFor(5000, 1);
+    CHECK_EQ(AsyncWiFiManager::getState(), ASYNC_WIFI_STATE_CONFIG_PORTAL);
+
+    unsigned long scanTime = AsyncWiFiManagerTest::getLastScanTime();
+    uint32_t scanCount = mock::getWiFiStats().scanCount;
+    unsigned long loopCount = countAllocations(70000, 10);
+    printf("Config portal: %lu loop() calls, %lu scan slices, %lu allocations\n", loopCount,
+           (unsigned long)(mock::getWiFiStats().scanCount - scanCount), allocationCount.load());
+    CHECK_EQ(allocationCount, 0);
+    // Two rescans, 30 s apart
+    CHECK(AsyncWiFiManagerTest::getLastScanTime() - scanTime >= 60000);
+    CHECK_EQ(AsyncWiFiManagerTest::getScanResultCount(), 1);
+}
@@ -0,0 +1,153 @@
+#include "test.h"
+
+#include <limits.h>
+
+// Failed connections are classified, then retried after a per class exponential backoff with jitter
+
+struct AsyncWiFiManagerTest
+{
+    static unsigned long getReconnectDelay(uint8_t failure)
+    {
+        return AsyncWiFiManager::getReconnectDelay(failure);
+    }
+};
+
+static const mock::AccessPoint HOME = {"home", "password1", {0x02, 0, 0, 0, 0, 1}, 6, -50, WIFI_AUTH_WPA2_PSK, true};
+
+static void setPolicy(uint8_t jitterPercent)
+{
+    AsyncWiFiReconnectPolicy policy = AsyncWiFiManager::getReconnectPolicy();
+    for (uint8_t i = 0; i < ASYNC_WIFI_FAILURE_COUNT; i++)
+    {
+        policy.baseDelay[i] = 1000 * (i + 1);
+    }
+    policy.maxDelay = 10000;
+    policy.jitterPercent = jitterPercent;
+    AsyncWiFiManager::setReconnectPolicy(policy);
+}
+
+static AsyncWiFiReconnectAttempt getLastAttempt()
+{
+    AsyncWiFiReconnectAttempt attempts[RECONNECT_HISTORY_SIZE];
+    uint8_t count = AsyncWiFiManager::getReconnectHistory(attempts, RECONNECT_HISTORY_SIZE);
+    CHECK(count > 0);
+    return attempts[count - 1];
+}
+
+static bool hasFailed(uint8_t count)
+{
+    AsyncWiFiReconnectAttempt attempts[RECONNECT_HISTORY_SIZE];
+    return AsyncWiFiManager::getReconnectHistory(attempts, RECONNECT_HISTORY_SIZE) >= count;
+}
+
+TEST(doublesDelayUpToMaximum)
+{
+    setPolicy(0);
+    const unsigned long expected[] = {1000, 2000, 4000, 8000, 10000, 10000};
+    for (unsigned long delay : expected)
+    {
+        CHECK_EQ(AsyncWiFiManagerTest::getReconnectDelay(ASYNC_WIFI_FAILURE_WRONG_PASSWORD), delay);
+    }
+    // Each class has its own count
+    CHECK_EQ(AsyncWiFiManagerTest::getReconnectDelay(ASYNC_WIFI_FAILURE_AP_NOT_FOUND), 2000);
+    CHECK_EQ(AsyncWiFiManagerTest::getReconnectDelay(ASYNC_WIFI_FAILURE_AP_NOT_FOUND), 4000);
+}
+
+TEST(spreadsDelaysWithJitter)
+{
+    setPolicy(50);
+    srandom(1);
+    unsigned long minDelay = ULONG_MAX;
+    unsigned long maxDelay = 0;
+    // From the third failure, the delay is at the maximum
+    AsyncWiFiManagerTest::getReconnectDelay(ASYNC_WIFI_FAILURE_DHCP_TIMEOUT);
+    AsyncWiFiManagerTest::getReconnectDelay(ASYNC_WIFI_FAILURE_DHCP_TIMEOUT);
+    for (int i = 0; i < 1000; i++)
+    {
+        unsigned long delay = AsyncWiFiManagerTest::getReconnectDelay(ASYNC_WIFI_FAILURE_DHCP_TIMEOUT);
+        CHECK(delay >= 5000 && delay <= 10000);
+        minDelay = min(minDelay, delay);
+        maxDelay = max(maxDelay, delay);
+    }
+    CHECK(minDelay < 5500);
+    CHECK(maxDelay > 9500);
+}
+
+TEST(classifiesWrongPassword)
+{
+    mock::setManualClock(true);
+    mock::addAccessPoint(HOME);
+    setPolicy(0);
+    AsyncWiFiManager::setWifiInformation("home", "password2");
+    AsyncWiFiManager::begin();
+    CHECK(runUntil([]()
+                   { return hasFailed(3); },
+                   60000));
+    AsyncWiFiReconnectAttempt attempts[3];
+    CHECK_EQ(AsyncWiFiManager::getReconnectHistory(attempts, 3), 3);
+    for (uint8_t i = 0; i < 3; i++)
+    {
+        CHECK_EQ(attempts[i].failure, ASYNC_WIFI_FAILURE_WRONG_PASSWORD);
+        CHECK_EQ(attempts[i].reason, WIFI_REASON_AUTH_FAIL);
+    }
+    // Retried after the scheduled delay
+    CHECK_EQ(attempts[1].delay, 2 * attempts[0].delay);
+    CHECK(attempts[1].time - attempts[0].time >= attempts[0].delay);
+    CHECK(attempts[1].time - attempts[0].time < attempts[0].delay + 500);
+}
+
+TEST(classifiesMissingAccessPoint)
+{
+    mock::setManualClock(true);
+    setPolicy(0);
+    AsyncWiFiManager::setWifiInformation("home", "password1");
+    AsyncWiFiManager::begin();
+    CHECK(runUntil([]()
+                   { return hasFailed(1); },
+                   60000));
+    CHECK_EQ(getLastAttempt().failure, ASYNC_WIFI_FAILURE_AP_NOT_FOUND);
+
+    // Found once it is back
+    mock::addAccessPoint(HOME);
+    CHECK(runUntil([]()
+                   { return AsyncWiFiManager::getState() == ASYNC_WIFI_STATE_CONNECTED; },
+                   60000));
+}
+
+TEST(classifiesDhcpTimeout)
+{
+    mock::setManualClock(true);
+    mock::AccessPoint home = HOME;
+    home.dhcp = false;
+    mock::addAccessPoint(home);
+    setPolicy(0);
+    AsyncWiFiManager::setWifiInformation("home", "password1");
+    AsyncWiFiManager::begin();
+    unsigned long start = millis();
+    CHECK(runUntil([]()
+                   { return hasFailed(1); },
+                   60000));
+    CHECK_EQ(getLastAttempt().failure, ASYNC_WIFI_FAILURE_DHCP_TIMEOUT);
+    CHECK(millis() - start >= AsyncWiFiManager::getReconnectPolicy().dhcpTimeout);
+}
+
+TEST(classifiesLostConnection)
+{
+    mock::setManualClock(true);
+    mock::addAccessPoint(HOME);
+    setPolicy(0);
+    AsyncWiFiManager::setWifiInformation("home", "password1");
+    AsyncWiFiManager::begin();
+    CHECK(runUntil([]()
+                   { return AsyncWiFiManager::getState() == ASYNC_WIFI_STATE_CONNECTED; },
+                   60000));
+    mock::disconnect(WIFI_REASON_BEACON_TIMEOUT);
+    CHECK(runUntil([]()
+                   { return hasFailed(1); },
+                   60000));
+    CHECK_EQ(getLastAttempt().failure, ASYNC_WIFI_FAILURE_CONNECTION_LOST);
+    CHECK_EQ(getLastAttempt().reason, WIFI_REASON_BEACON_TIMEOUT);
+    CHECK(runUntil([]()
+                   { return AsyncWiFiManager::getState() == ASYNC_WIFI_STATE_CONNECTED; },
+                   60000));
+}
@@ -0,0 +1,118 @@
+#include "test.h"
+
+// Smoke tests of the host build: a connection to a saved network and the config portal over a real socket
+
+static const mock::AccessPoint HOME = {"home", "password1", {0x02, 0, 0, 0, 0, 1}, 6, -50, WIFI_AUTH_WPA2_PSK, true};
+
+TEST(connectsToSavedNetwork)
+{
+    mock::setManualClock(true);
+    mock::addAccessPoint(HOME);
+    AsyncWiFiManager::setWifiInformation("home", "password1");
+    AsyncWiFiManager::begin();
+    CHECK(runUntil([]()
+                   { return AsyncWiFiManager::getState() == ASYNC_WIFI_STATE_CONNECTED; },
+                   60000));
+    AsyncWiFiSnapshot snapshot = AsyncWiFiManager::getSnapshot();
+    CHECK_STR(snapshot.ssid, "home");
+    CHECK_EQ(mock::getWiFiStats().staChannel, 6);
+}
+
+TEST(startsConfigPortalWithoutSavedNetwork)
+{
+    mock::setManualClock(true);
+    AsyncWiFiManager::begin();
+    runFor(100);
+    CHECK_EQ(AsyncWiFiManager::getState(), ASYNC_WIFI_STATE_CONFIG_PORTAL);
+    std::string body;
+    CHECK_EQ(httpRequest("GET", "/", nullptr, &body), 200);
+    CHECK(body.find("<form") != std::string::npos);
+    CHECK_EQ(httpRequest("GET", "/missing"), 404);
+}
+
+TEST(connectsWithSettingsSavedInPortal)
+{
+    mock::setManualClock(true);
+    mock::addAccessPoint(HOME);
+    AsyncWiFiManager::setHotApplyEnable(true);
+    AsyncWiFiManager::begin();
+    runFor(100);
+    CHECK_EQ(httpRequest("POST", "/save", "s=home&p=password1"), 200);
+    CHECK(runUntil([]()
+                   { return AsyncWiFiManager::getState() == ASYNC_WIFI_STATE_CONNECTED; },
+                   60000));
+    CHECK_EQ(AsyncWiFiManager::getSavedNetworkCount(), 1);
+    CHECK_EQ(mock::getRestartCount(), 0);
+}
+
+// The status of a hot apply names the submitted network, even one whose escaped SSID is 6 times longer
+TEST(reportsLongestSsidInStatus)
+{
+    mock::setManualClock(true);
+    AsyncWiFiManager::setHotApplyEnable(true);
+    AsyncWiFiManager::begin();
+    runFor(100);
+    std::string form = "s=";
+    std::string escaped;
+    for (int i = 0; i < 32; i++)
+    {
+        form += "%1F";
+        escaped += "\\u001f";
+    }
+    form += "&p=password1";
+    CHECK_EQ(httpRequest("POST", "/save", form.c_str()), 200);
+    std::string body;
+    CHECK_EQ(httpRequest("GET", "/status.json", nullptr, &body), 200);
+    CHECK_EQ(body.compare(0, 9, "{\"s\":\"con"), 0);
+    CHECK(body.find("\"n\":\"" + escaped + "\",\"i\":\"\",\"e\":\"\",\"m\":\"apply\"}") != std::string::npos);
+}
+
+// The success page only promises a reboot when saving the settings restarts the device
+TEST(reportsSaveModeInStatus)
+{
+    mock::setManualClock(true);
+    AsyncWiFiManager::begin();
+    runFor(100);
+    std::string body;
+    CHECK_EQ(httpRequest("GET", "/status.json", nullptr, &body), 200);
+    CHECK(body.find("\"m\":\"restart\"") != std::string::npos);
+    AsyncWiFiManager::setHotApplyEnable(true);
+    CHECK_EQ(httpRequest("GET", "/status.json", nullptr, &body), 200);
+    CHECK(body.find("\"m\":\"apply\"") != std::string::npos);
+    AsyncWiFiManager::setOnWiFiInformationChanged([]() {});
+    CHECK_EQ(httpRequest("GET", "/status.json", nullptr, &body), 200);
+    CHECK(body.find("\"m\":\"save\"") != std::string::npos);
+}
+
+static std::vector<AsyncWiFiState> states;
+
+// Events the queue has no room for are merged, the disconnection pushed behind a burst of scans is still handled
+TEST(mergesEventsOfFullQueue)
+{
+    mock::setManualClock(true);
+    mock::addAccessPoint(HOME);
+    AsyncWiFiManager::setOnStateChanged([](AsyncWiFiState state)
+                                        { states.push_back(state); });
+    AsyncWiFiManager::setWifiInformation("home", "password1");
+    AsyncWiFiManager::begin();
+    CHECK(runUntil([]()
+                   { return AsyncWiFiManager::getState() == ASYNC_WIFI_STATE_CONNECTED; },
+                   60000));
+    states.clear();
+    for (int i = 0; i < 20; i++)
+    {
+        mock::fireEvent(ARDUINO_EVENT_WIFI_SCAN_DONE);
+    }
+    for (int i = 0; i < 5; i++)
+    {
+        mock::fireEvent(ARDUINO_EVENT_WIFI_STA_DISCONNECTED, 200);
+    }
+    // The queue keeps one slot free
+    CHECK_EQ(AsyncWiFiManager::getEventDropCount(), 18);
+    runFor(10);
+    CHECK(!states.empty());
+    CHECK_EQ(states[0], ASYNC_WIFI_STATE_CONNECTING);
+    CHECK(runUntil([]()
+                   { return AsyncWiFiManager::getState() == ASYNC_WIFI_STATE_CONNECTED; },
+                   60000));
+}
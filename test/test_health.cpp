@@ -0,0 +1,216 @@
+#include "test.h"
+
+#include <arpa/inet.h>
+#include <atomic>
+#include <mutex>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <thread>
+
+// The health monitor probes the gateway with a TCP connection and the endpoint with an HTTP request, through the lwIP
+// stand-in over real sockets. The endpoint is a local HTTP server with a status code set by the test. Real clock
+
+static const mock::AccessPoint HOME = {"home", "password1", {0x02, 0, 0, 0, 0, 1}, 6, -50, WIFI_AUTH_WPA2_PSK, true};
+
+// Answers every request with status, on 127.0.0.1 at port
+struct HttpServer
+{
+    uint16_t port = 0;
+    std::atomic<int> status{200};
+    std::atomic<int> requestCount{0};
+    std::mutex mutex;
+    std::string lastRequest;
+
+    HttpServer()
+    {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t length = sizeof(address);
+        CHECK(fd >= 0 && bind(fd, (sockaddr *)&address, sizeof(address)) == 0 && listen(fd, 8) == 0 &&
+              getsockname(fd, (sockaddr *)&address, &length) == 0);
+        port = ntohs(address.sin_port);
+        // Ends with the test process
+        std::thread([this, fd]()
+                    { serve(fd); })
+            .detach();
+    }
+
+    void serve(int fd)
+    {
+        while (true)
+        {
+            int client = accept(fd, nullptr, nullptr);
+            if (client < 0)
+            {
+                continue;
+            }
+            std::string request;
+            char buffer[512];
+            ssize_t length;
+            while (request.find("\r\n\r\n") == std::string::npos && (length = recv(client, buffer, sizeof(buffer), 0)) > 0)
+            {
+                request.append(buffer, length);
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                lastRequest = request;
+            }
+            std::string response = "HTTP/1.1 " + std::to_string(status.load()) + " Status\r\nContent-Length: 0\r\n" +
+                                   "Connection: close\r\n\r\n";
+            send(client, response.data(), response.size(), MSG_NOSIGNAL);
+            close(client);
+            requestCount++;
+        }
+    }
+
+    std::string getLastRequest()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return lastRequest;
+    }
+};
+
+static std::vector<AsyncWiFiState> states;
+
+// Connected with probes every 50 ms. The gateway is the host, whose closed port answers with a reset
+static void startConnected(uint8_t degradedFailures = 2, uint8_t reconnectFailures = 0)
+{
+    mock::setSerialQuiet(true);
+    mock::addAccessPoint(HOME);
+    mock::setGateway(IPAddress(127, 0, 0, 1));
+    AsyncWiFiManager::setHealthMonitorEnable(true);
+    AsyncWiFiHealthPolicy policy = AsyncWiFiManager::getHealthPolicy();
+    policy.probeInterval = 50;
+    policy.probeTimeout = 500;
+    policy.gatewayPort = 9;
+    policy.degradedFailures = degradedFailures;
+    policy.reconnectFailures = reconnectFailures;
+    AsyncWiFiManager::setHealthPolicy(policy);
+    AsyncWiFiManager::setOnStateChanged([](AsyncWiFiState state)
+                                        { states.push_back(state); });
+    AsyncWiFiManager::setWifiInformation("home", "password1");
+    AsyncWiFiManager::begin();
+    CHECK(runUntil([]()
+                   { return AsyncWiFiManager::getState() == ASYNC_WIFI_STATE_CONNECTED; },
+                   10000, 1));
+}
+
+static bool waitForProbes(uint32_t count)
+{
+    uint32_t target = AsyncWiFiManager::getHealthStats().probeCount + count;
+    return runUntil([=]()
+                    { return AsyncWiFiManager::getHealthStats().probeCount >= target; },
+                    10000, 1);
+}
+
+TEST(countsRefusedGatewayConnectionAsReachable)
+{
+    startConnected();
+    CHECK(waitForProbes(10));
+    const AsyncWiFiHealthStats &stats = AsyncWiFiManager::getHealthStats();
+    CHECK_EQ(stats.failureCount, 0);
+    CHECK_EQ(stats.loss, 0);
+    CHECK(!stats.internet);
+    CHECK_EQ(AsyncWiFiManager::getState(), ASYNC_WIFI_STATE_CONNECTED);
+}
+
+// The gateway does not answer: its listen queue is full, so the connection requests are dropped and time out
+TEST(failsSilentGateway)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(address);
+    CHECK(fd >= 0 && bind(fd, (sockaddr *)&address, sizeof(address)) == 0 && listen(fd, 0) == 0 &&
+          getsockname(fd, (sockaddr *)&address, &length) == 0);
+    for (int i = 0; i < 4; i++)
+    {
+        int client = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        connect(client, (sockaddr *)&address, sizeof(address));
+    }
+
+    startConnected();
+    AsyncWiFiHealthPolicy policy = AsyncWiFiManager::getHealthPolicy();
+    policy.gatewayPort = ntohs(address.sin_port);
+    AsyncWiFiManager::setHealthPolicy(policy);
+    CHECK(runUntil([]()
+                   { return AsyncWiFiManager::getState() == ASYNC_WIFI_STATE_DEGRADED; },
+                   10000, 1));
+    CHECK(AsyncWiFiManager::getHealthStats().failureCount >= 2);
+    CHECK(AsyncWiFiManager::getHealthStats().loss > 0);
+}
+
+TEST(probesEndpointWithHttpRequest)
+{
+    HttpServer server;
+    server.status = 204;
+    AsyncWiFiManager::setHealthEndpoint("127.0.0.1", server.port, "/generate_204");
+    startConnected();
+    CHECK(waitForProbes(5));
+    CHECK(server.requestCount >= 5);
+    CHECK_EQ(server.getLastRequest().compare(0, 23, "GET /generate_204 HTTP/"), 0);
+    CHECK(AsyncWiFiManager::getHealthStats().internet);
+    CHECK_EQ(AsyncWiFiManager::getHealthStats().failureCount, 0);
+}
+
+TEST(resolvesEndpointName)
+{
+    HttpServer server;
+    AsyncWiFiManager::setHealthEndpoint("localhost", server.port, "/");
+    startConnected();
+    CHECK(waitForProbes(3));
+    CHECK(server.requestCount >= 3);
+    CHECK(AsyncWiFiManager::getHealthStats().internet);
+}
+
+TEST(degradesAndRecoversWithEndpointStatus)
+{
+    HttpServer server;
+    AsyncWiFiManager::setHealthEndpoint("127.0.0.1", server.port, "/");
+    startConnected();
+    CHECK(waitForProbes(2));
+    CHECK(AsyncWiFiManager::getHealthStats().internet);
+
+    server.status = 500;
+    CHECK(runUntil([]()
+                   { return AsyncWiFiManager::getState() == ASYNC_WIFI_STATE_DEGRADED; },
+                   10000, 1));
+    CHECK(!AsyncWiFiManager::getHealthStats().internet);
+    CHECK(AsyncWiFiManager::getHealthStats().loss > 0);
+
+    server.status = 200;
+    CHECK(runUntil([]()
+                   { return AsyncWiFiManager::getState() == ASYNC_WIFI_STATE_CONNECTED; },
+                   10000, 1));
+    CHECK(AsyncWiFiManager::getHealthStats().internet);
+    CHECK_EQ(states.back(), ASYNC_WIFI_STATE_CONNECTED);
+    CHECK_EQ(states[states.size() - 2], ASYNC_WIFI_STATE_DEGRADED);
+    CHECK_EQ(AsyncWiFiManager::getHealthStats().reconnectCount, 0);
+}
+
+// After reconnectFailures failed probes the connection is dropped and joined again
+TEST(reconnectsAfterFailedProbes)
+{
+    HttpServer server;
+    server.status = 500;
+    AsyncWiFiManager::setHealthEndpoint("127.0.0.1", server.port, "/");
+    startConnected(2, 4);
+    CHECK(runUntil([]()
+                   { return AsyncWiFiManager::getHealthStats().reconnectCount == 1; },
+                   10000, 1));
+    server.status = 200;
+    CHECK(runUntil([]()
+                   { return AsyncWiFiManager::getState() == ASYNC_WIFI_STATE_CONNECTED && AsyncWiFiManager::getHealthStats().internet; },
+                   30000, 1));
+    CHECK_EQ(mock::getWiFiStats().beginCount, 2);
+    bool isDegraded = false;
+    for (AsyncWiFiState state : states)
+    {
+        isDegraded |= state == ASYNC_WIFI_STATE_DEGRADED;
+    }
+    CHECK(isDegraded);
+}
@@ -0,0 +1,148 @@
+#include "test.h"
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+// Messages are formatted into a lock-free ring and written to the sink by flushLog(), in order, full rings drop and count
+
+struct AsyncWiFiManagerTest
+{
+    template <typename... Args>
+    static void log(uint8_t level, const char *format, Args... args)
+    {
+        AsyncWiFiManager::logMessage(level, format, args...);
+    }
+};
+
+struct Message
+{
+    uint8_t level;
+    std::string text;
+};
+
+static std::mutex sinkMutex;
+static std::vector<Message> messages;
+
+static void sink(uint8_t level, const char *message)
+{
+    std::lock_guard<std::mutex> lock(sinkMutex);
+    messages.push_back({level, message});
+}
+
+#if ASYNC_WIFI_LOG_LEVEL >= ASYNC_WIFI_LOG_LEVEL_INFO
+TEST(writesMessagesInOrder)
+{
+    AsyncWiFiManager::setLogSink(sink);
+    AsyncWiFiManagerTest::log(ASYNC_WIFI_LOG_LEVEL_INFO, "first %d", 1);
+    AsyncWiFiManagerTest::log(ASYNC_WIFI_LOG_LEVEL_ERROR, "second %s", "message");
+    AsyncWiFiManagerTest::log(ASYNC_WIFI_LOG_LEVEL_DEBUG, "third");
+    CHECK(messages.empty());
+    AsyncWiFiManager::flushLog();
+    CHECK_EQ(messages.size(), 3);
+    CHECK_STR(messages[0].text.c_str(), "first 1");
+    CHECK_EQ(messages[0].level, ASYNC_WIFI_LOG_LEVEL_INFO);
+    CHECK_STR(messages[1].text.c_str(), "second message");
+    CHECK_EQ(messages[1].level, ASYNC_WIFI_LOG_LEVEL_ERROR);
+    CHECK_STR(messages[2].text.c_str(), "third");
+}
+
+TEST(truncatesLongMessages)
+{
+    AsyncWiFiManager::setLogSink(sink);
+    std::string text(200, 'x');
+    AsyncWiFiManagerTest::log(ASYNC_WIFI_LOG_LEVEL_INFO, "%s", text.c_str());
+    AsyncWiFiManager::flushLog();
+    CHECK_EQ(messages.size(), 1);
+    CHECK_EQ(messages[0].text.size(), LOG_MESSAGE_SIZE - 1);
+}
+
+TEST(dropsAndReportsWhenFull)
+{
+    AsyncWiFiManager::setLogSink(sink);
+    // One slot of the ring is kept free
+    for (int i = 0; i < LOG_QUEUE_SIZE + 4; i++)
+    {
+        AsyncWiFiManagerTest::log(ASYNC_WIFI_LOG_LEVEL_INFO, "message %d", i);
+    }
+    CHECK_EQ(AsyncWiFiManager::getLogDroppedCount(), 5);
+    AsyncWiFiManager::flushLog();
+    CHECK_EQ(messages.size(), LOG_QUEUE_SIZE);
+    CHECK_STR(messages[LOG_QUEUE_SIZE - 2].text.c_str(), "message 14");
+    CHECK_STR(messages[LOG_QUEUE_SIZE - 1].text.c_str(), "5 log messages dropped");
+    CHECK_EQ(messages[LOG_QUEUE_SIZE - 1].level, ASYNC_WIFI_LOG_LEVEL_ERROR);
+
+    // Reported once
+    AsyncWiFiManagerTest::log(ASYNC_WIFI_LOG_LEVEL_INFO, "after");
+    AsyncWiFiManager::flushLog();
+    CHECK_EQ(messages.size(), LOG_QUEUE_SIZE + 1);
+    CHECK_STR(messages.back().text.c_str(), "after");
+}
+
+// Producers on several threads while the consumer flushes: each message arrives whole, once, in the order of its thread
+TEST(keepsMessagesWholeWithConcurrentProducers)
+{
+    const int THREAD_COUNT = 4;
+    const int MESSAGE_COUNT = 20000;
+    AsyncWiFiManager::setLogSink(sink);
+    std::atomic<int> runningCount(THREAD_COUNT);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < THREAD_COUNT; t++)
+    {
+        threads.emplace_back([t, &runningCount]()
+                             {
+                                 for (int i = 0; i < MESSAGE_COUNT; i++)
+                                 {
+                                     AsyncWiFiManagerTest::log(ASYNC_WIFI_LOG_LEVEL_INFO, "thread %d message %d end", t, i);
+                                 }
+                                 runningCount--;
+                             });
+    }
+    while (runningCount > 0)
+    {
+        AsyncWiFiManager::flushLog();
+    }
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+    AsyncWiFiManager::flushLog();
+
+    int last[THREAD_COUNT] = {-1, -1, -1, -1};
+    size_t count = 0;
+    for (const Message &message : messages)
+    {
+        int t;
+        int i;
+        if (message.level == ASYNC_WIFI_LOG_LEVEL_ERROR)
+        {
+            continue; // Drop report
+        }
+        CHECK_EQ(sscanf(message.text.c_str(), "thread %d message %d end", &t, &i), 2);
+        CHECK(t >= 0 && t < THREAD_COUNT);
+        CHECK(i > last[t]);
+        last[t] = i;
+        count++;
+    }
+    printf("%zu messages written, %u dropped\n", count, AsyncWiFiManager::getLogDroppedCount());
+    CHECK_EQ(count + AsyncWiFiManager::getLogDroppedCount(), THREAD_COUNT * MESSAGE_COUNT);
+}
+#endif
+
+// Levels above ASYNC_WIFI_LOG_LEVEL are compiled out
+TEST(writesOnlyEnabledLevels)
+{
+    AsyncWiFiManager::setLogSink(sink);
+    mock::setManualClock(true);
+    AsyncWiFiManager::setWifiInformation("home", "password1");
+    AsyncWiFiManager::begin();
+    runFor(60000);
+    bool hasInfo = false;
+    for (const Message &message : messages)
+    {
+        CHECK(message.level <= ASYNC_WIFI_LOG_LEVEL);
+        hasInfo |= message.level == ASYNC_WIFI_LOG_LEVEL_INFO;
+    }
+    CHECK_EQ(hasInfo, ASYNC_WIFI_LOG_LEVEL >= ASYNC_WIFI_LOG_LEVEL_INFO);
+    CHECK(!messages.empty());
+}
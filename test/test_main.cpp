@@ -0,0 +1,196 @@
+#include "test.h"
+
+#include <arpa/inet.h>
+#include <ftw.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <vector>
+
+struct TestEntry
+{
+    const char *name;
+    void (*function)();
+};
+
+static std::vector<TestEntry> &getTests()
+{
+    static std::vector<TestEntry> tests;
+    return tests;
+}
+
+static char testDirectory[64];
+
+TestCase::TestCase(const char *name, void (*function)())
+{
+    getTests().push_back({name, function});
+}
+
+void testFailed(const char *file, int line, const char *check, const char *actual, const char *expected)
+{
+    fflush(stdout);
+    fprintf(stderr, "%s:%d: %s failed", file, line, check);
+    if (actual && expected)
+    {
+        fprintf(stderr, ": \"%s\" != \"%s\"", actual, expected);
+    }
+    fprintf(stderr, "\n");
+    _exit(1);
+}
+
+const char *getTestDirectory()
+{
+    return testDirectory;
+}
+
+void runFor(unsigned long ms, unsigned long step)
+{
+    unsigned long start = millis();
+    do
+    {
+        mock::deliverEvents();
+        AsyncWiFiManager::loop();
+        delay(step);
+    } while ((unsigned long)(millis() - start) < ms);
+}
+
+static std::string decodeChunked(const std::string &content)
+{
+    std::string decoded;
+    size_t pos = 0;
+    while (pos < content.size())
+    {
+        size_t lineEnd = content.find("\r\n", pos);
+        if (lineEnd == std::string::npos)
+        {
+            break;
+        }
+        size_t size = strtoul(content.c_str() + pos, nullptr, 16);
+        if (size == 0)
+        {
+            break;
+        }
+        decoded += content.substr(lineEnd + 2, size);
+        pos = lineEnd + 2 + size + 2;
+    }
+    return decoded;
+}
+
+int httpRequest(const char *method, const char *path, const char *content, std::string *body, const char *headers)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(mock::getHttpPort());
+    if (fd < 0 || mock::getHttpPort() == 0 || connect(fd, (sockaddr *)&address, sizeof(address)) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    std::string request = std::string(method) + " " + path + " HTTP/1.1\r\nHost: 192.168.4.1\r\n" + headers;
+    if (content)
+    {
+        request += "Content-Type: application/x-www-form-urlencoded\r\nContent-Length: " + std::to_string(strlen(content)) +
+                   "\r\n\r\n" + content;
+    }
+    else
+    {
+        request += "\r\n";
+    }
+    send(fd, request.data(), request.size(), MSG_NOSIGNAL);
+
+    // The server closes the connection after the answer
+    std::string response;
+    unsigned long start = millis();
+    while ((unsigned long)(millis() - start) < 10000)
+    {
+        pollfd readable = {fd, POLLIN, 0};
+        if (poll(&readable, 1, 0) <= 0)
+        {
+            runFor(1, 1);
+            continue;
+        }
+        char buffer[1024];
+        ssize_t length = recv(fd, buffer, sizeof(buffer), 0);
+        if (length <= 0)
+        {
+            break;
+        }
+        response.append(buffer, length);
+    }
+    close(fd);
+
+    size_t headerEnd = response.find("\r\n\r\n");
+    if (response.compare(0, 9, "HTTP/1.1 ") != 0 || headerEnd == std::string::npos)
+    {
+        return -1;
+    }
+    if (body)
+    {
+        *body = response.substr(headerEnd + 4);
+        if (response.find("Transfer-Encoding: chunked") < headerEnd)
+        {
+            *body = decodeChunked(*body);
+        }
+    }
+    return atoi(response.c_str() + 9);
+}
+
+unsigned long getPercentile(std::vector<unsigned long> &samples, int percent)
+{
+    if (samples.empty())
+    {
+        return 0;
+    }
+    std::sort(samples.begin(), samples.end());
+    return samples[min(samples.size() - 1, samples.size() * percent / 100)];
+}
+
+static int removeEntry(const char *path, const struct stat *status, int flag, struct FTW *ftw)
+{
+    return remove(path);
+}
+
+// Run the tests whose name contains the first argument, all without argument
+int main(int argc, char **argv)
+{
+    int failedCount = 0;
+    for (const TestEntry &test : getTests())
+    {
+        if (argc > 1 && !strstr(test.name, argv[1]))
+        {
+            continue;
+        }
+        strcpy(testDirectory, "/tmp/async-wifi-test-XXXXXX");
+        if (!mkdtemp(testDirectory))
+        {
+            perror("mkdtemp");
+            return 1;
+        }
+        fflush(stdout);
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            std::string fsRoot = std::string(testDirectory) + "/fs";
+            mock::setFileSystemRoot(fsRoot.c_str());
+            test.function();
+            fflush(stdout);
+            _exit(0);
+        }
+        int status = 0;
+        waitpid(pid, &status, 0);
+        bool isPassed = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+        if (!isPassed)
+        {
+            failedCount++;
+        }
+        printf("[%s] %s\n", isPassed ? "PASS" : "FAIL", test.name);
+        nftw(testDirectory, removeEntry, 16, FTW_DEPTH | FTW_PHYS);
+    }
+    printf("%d failed\n", failedCount);
+    return failedCount ? 1 : 0;
+}
@@ -0,0 +1,123 @@
+#include "test.h"
+
+#include <sys/stat.h>
+
+// Custom parameters are rendered into the portal form, checked as a whole on /save and kept in /params.dat,
+// written once per change
+
+struct AsyncWiFiManagerTest
+{
+    // Read the parameters file again like after a restart
+    static void reload()
+    {
+        AsyncWiFiManager::mSavedParametersCrc = 0;
+        AsyncWiFiManager::loadParameters();
+    }
+};
+
+static char host[33] = "<none>";
+static int32_t port = 1883;
+static bool isTls = true;
+static int changedCount = 0;
+
+static void startPortal()
+{
+    mock::setManualClock(true);
+    mock::setSerialQuiet(true);
+    CHECK(AsyncWiFiManager::addParameter("host", "MQTT host", host, sizeof(host) - 1));
+    CHECK(AsyncWiFiManager::addParameter("port", "MQTT port", &port, 1, 65535));
+    CHECK(AsyncWiFiManager::addParameter("tls", "TLS", &isTls));
+    AsyncWiFiManager::setOnParametersChanged([]()
+                                             { changedCount++; });
+    // Applied in place, ESP.restart() does not stop the test
+    AsyncWiFiManager::setOnWiFiInformationChanged([]() {});
+    AsyncWiFiManager::begin();
+    runFor(100);
+    CHECK_EQ(AsyncWiFiManager::getState(), ASYNC_WIFI_STATE_CONFIG_PORTAL);
+}
+
+static bool isFileSaved()
+{
+    struct stat status;
+    return stat((std::string(getTestDirectory()) + "/fs/params.dat").c_str(), &status) == 0;
+}
+
+TEST(rendersParametersInForm)
+{
+    startPortal();
+    std::string body;
+    CHECK_EQ(httpRequest("GET", "/", nullptr, &body), 200);
+    CHECK(body.find("name='host' maxlength='32' value='&#60;none&#62;'") != std::string::npos);
+    CHECK(body.find("name='port' type='number' min='1' max='65535' value='1883'") != std::string::npos);
+    CHECK(body.find("name='tls' type='checkbox' value='1' checked>") != std::string::npos);
+}
+
+TEST(savesSubmittedValues)
+{
+    startPortal();
+    CHECK_EQ(httpRequest("POST", "/save", "s=home&p=password1&host=broker.local&port=8883"), 200);
+    runFor(100);
+    CHECK_STR(host, "broker.local");
+    CHECK_EQ(port, 8883);
+    CHECK(!isTls); // Not submitted: unchecked
+    CHECK_EQ(changedCount, 1);
+    CHECK(isFileSaved());
+
+    strcpy(host, "");
+    port = 1;
+    isTls = true;
+    AsyncWiFiManagerTest::reload();
+    CHECK_STR(host, "broker.local");
+    CHECK_EQ(port, 8883);
+    CHECK(!isTls);
+}
+
+TEST(rejectsInvalidValues)
+{
+    startPortal();
+    const char *const FORMS[] = {"s=home&p=password1&host=broker&port=70000", "s=home&p=password1&host=broker&port=12ab",
+                                 "s=home&p=password1&port=1&host=123456789012345678901234567890123"};
+    for (const char *form : FORMS)
+    {
+        std::string body;
+        CHECK_EQ(httpRequest("POST", "/save", form, &body), 200);
+        CHECK(body.find("Parameters are invalid") != std::string::npos);
+        runFor(100);
+        // None of the values is set
+        CHECK_STR(host, "<none>");
+        CHECK_EQ(port, 1883);
+        CHECK(isTls);
+    }
+    CHECK_EQ(changedCount, 0);
+    CHECK(!isFileSaved());
+}
+
+TEST(skipsUnchangedSave)
+{
+    startPortal();
+    CHECK_EQ(httpRequest("POST", "/save", "s=home&p=password1&host=broker&port=8883&tls=1"), 200);
+    runFor(100);
+    uint32_t writtenBytes = mock::getFileSystemStats().writtenBytes;
+    CHECK_EQ(httpRequest("POST", "/save", "s=home&p=password1&host=broker&port=8883&tls=1"), 200);
+    runFor(100);
+    CHECK_EQ(changedCount, 2);
+    CHECK_EQ(mock::getFileSystemStats().writtenBytes, writtenBytes);
+}
+
+TEST(ignoresCorruptFile)
+{
+    startPortal();
+    CHECK_EQ(httpRequest("POST", "/save", "s=home&p=password1&host=broker&port=8883"), 200);
+    runFor(100);
+    FILE *file = fopen((std::string(getTestDirectory()) + "/fs/params.dat").c_str(), "r+b");
+    CHECK(file);
+    fseek(file, -1, SEEK_END);
+    fputc('X', file);
+    fclose(file);
+
+    strcpy(host, "default");
+    port = 1;
+    AsyncWiFiManagerTest::reload();
+    CHECK_STR(host, "default");
+    CHECK_EQ(port, 1);
+}
@@ -0,0 +1,61 @@
+#include "test.h"
+
+// Roaming to a stronger access point of the network, which the application does not see as a lost connection
+
+static const mock::AccessPoint NEAR = {"home", "password1", {0x02, 0, 0, 0, 0, 1}, 6, -50, WIFI_AUTH_WPA2_PSK, true};
+static const mock::AccessPoint FAR = {"home", "password1", {0x02, 0, 0, 0, 0, 2}, 11, -80, WIFI_AUTH_WPA2_PSK, true};
+
+static std::vector<AsyncWiFiState> states;
+
+static void startConnected()
+{
+    mock::setManualClock(true);
+    mock::addAccessPoint(NEAR);
+    mock::addAccessPoint(FAR);
+    AsyncWiFiRoamingPolicy policy = AsyncWiFiManager::getRoamingPolicy();
+    policy.scanInterval = 1000;
+    policy.roamInterval = 1000;
+    AsyncWiFiManager::setRoamingPolicy(policy);
+    AsyncWiFiManager::setRoamingEnable(true);
+    AsyncWiFiManager::setOnStateChanged([](AsyncWiFiState state)
+                                        { states.push_back(state); });
+    AsyncWiFiManager::setWifiInformation("home", "password1");
+    AsyncWiFiManager::begin();
+    CHECK(runUntil([]()
+                   { return AsyncWiFiManager::getState() == ASYNC_WIFI_STATE_CONNECTED; },
+                   60000));
+    CHECK_EQ(mock::getWiFiStats().staChannel, 6);
+    states.clear();
+}
+
+TEST(roamsWithoutStateChange)
+{
+    startConnected();
+    mock::setRssi(NEAR.bssid, -85);
+    mock::setRssi(FAR.bssid, -45);
+    CHECK(runUntil([]()
+                   { return AsyncWiFiManager::getRoamingStats().roamCount == 1 && mock::getWiFiStats().staChannel == 11 &&
+                            WiFi.isConnected(); },
+                   60000));
+    runFor(1000);
+    CHECK_EQ(AsyncWiFiManager::getState(), ASYNC_WIFI_STATE_CONNECTED);
+    CHECK_EQ(states.size(), 0);
+    CHECK_EQ(WiFi.BSSID()[5], 2);
+}
+
+// The stronger access point is gone when it is joined, the connection is then reported as lost
+TEST(reportsFailedRoam)
+{
+    startConnected();
+    mock::setRssi(NEAR.bssid, -85);
+    mock::setRssi(FAR.bssid, -45);
+    CHECK(runUntil([]()
+                   { return AsyncWiFiManager::getRoamingStats().roamCount == 1; },
+                   60000));
+    mock::removeAccessPoints();
+    CHECK(runUntil([]()
+                   { return !states.empty(); },
+                   60000));
+    CHECK_EQ(states[0], ASYNC_WIFI_STATE_CONNECTING);
+    CHECK_EQ(AsyncWiFiManager::getState(), ASYNC_WIFI_STATE_CONNECTING);
+}
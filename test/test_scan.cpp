@@ -0,0 +1,137 @@
+#include "test.h"
+
+// The scan cache keeps the strongest access point of each SSID, sorted by signal, and drops hidden networks
+
+struct AsyncWiFiManagerTest
+{
+    static uint8_t getResultCount()
+    {
+        return AsyncWiFiManager::mScanResultCount;
+    }
+
+    static const AsyncWiFiScanResult &getResult(uint8_t index)
+    {
+        return AsyncWiFiManager::mScanResults[index];
+    }
+
+    static bool isScanning()
+    {
+        return AsyncWiFiManager::mIsScanning || AsyncWiFiManager::mIsScanSlicePending;
+    }
+
+    static void updateScanResults(int count)
+    {
+        AsyncWiFiManager::updateScanResults(count);
+    }
+};
+
+static mock::AccessPoint makeAccessPoint(const char *ssid, uint8_t id, uint8_t channel, int8_t rssi)
+{
+    return {ssid, "password1", {0x02, 0, 0, 0, 0, id}, channel, rssi, WIFI_AUTH_WPA2_PSK, true};
+}
+
+static void waitForScan()
+{
+    CHECK(runUntil([]()
+                   { return AsyncWiFiManagerTest::getResultCount() > 0 && !AsyncWiFiManagerTest::isScanning(); },
+                   60000));
+}
+
+TEST(keepsStrongestAccessPointOfEachNetwork)
+{
+    mock::setManualClock(true);
+    mock::addAccessPoint(makeAccessPoint("office", 1, 1, -70));
+    mock::addAccessPoint(makeAccessPoint("office", 2, 6, -40));
+    mock::addAccessPoint(makeAccessPoint("cafe", 3, 11, -60));
+    mock::addAccessPoint(makeAccessPoint("office", 4, 11, -80));
+    mock::addAccessPoint(makeAccessPoint("", 5, 3, -30));
+    AsyncWiFiManager::begin();
+    waitForScan();
+
+    CHECK_EQ(AsyncWiFiManagerTest::getResultCount(), 2);
+    const AsyncWiFiScanResult &office = AsyncWiFiManagerTest::getResult(0);
+    CHECK_STR(office.ssid, "office");
+    CHECK_EQ(office.rssi, -40);
+    CHECK_EQ(office.channel, 6);
+    CHECK_EQ(office.bssid[5], 2);
+    CHECK_STR(AsyncWiFiManagerTest::getResult(1).ssid, "cafe");
+
+    std::string body;
+    CHECK_EQ(httpRequest("GET", "/scan.json", nullptr, &body), 200);
+    size_t officePos = body.find("\"office\"");
+    CHECK(officePos != std::string::npos);
+    CHECK(body.find("\"office\"", officePos + 1) == std::string::npos);
+    CHECK(officePos < body.find("\"cafe\""));
+}
+
+TEST(dropsNetworksMissingFromNextScan)
+{
+    mock::setManualClock(true);
+    mock::addAccessPoint(makeAccessPoint("office", 1, 1, -70));
+    mock::addAccessPoint(makeAccessPoint("cafe", 2, 11, -60));
+    AsyncWiFiManager::setScanInterval(5000);
+    AsyncWiFiManager::begin();
+    waitForScan();
+    CHECK_EQ(AsyncWiFiManagerTest::getResultCount(), 2);
+
+    mock::removeAccessPoints();
+    mock::addAccessPoint(makeAccessPoint("cafe", 2, 11, -50));
+    uint32_t scanCount = mock::getWiFiStats().scanCount;
+    CHECK(runUntil([scanCount]()
+                   { return mock::getWiFiStats().scanCount > scanCount && !AsyncWiFiManagerTest::isScanning(); },
+                   60000));
+    CHECK_EQ(AsyncWiFiManagerTest::getResultCount(), 1);
+    CHECK_STR(AsyncWiFiManagerTest::getResult(0).ssid, "cafe");
+    CHECK_EQ(AsyncWiFiManagerTest::getResult(0).rssi, -50);
+}
+
+// Like an office with many access points: the cache keeps the strongest WIFI_SCAN_CACHE_SIZE networks
+TEST(keepsStrongestNetworksWhenFull)
+{
+    static char ssids[80][8];
+    for (int i = 0; i < 80; i++)
+    {
+        snprintf(ssids[i], sizeof(ssids[i]), "ap%02d", i);
+        // Each network has a weaker second access point
+        mock::addAccessPoint(makeAccessPoint(ssids[i], i, 1 + i % 13, -90 + (i * 37) % 60));
+        mock::addAccessPoint(makeAccessPoint(ssids[i], 100 + i, 1 + i % 13, -91 + (i * 37) % 60));
+    }
+    WiFi.mode(WIFI_STA);
+    int count = WiFi.scanNetworks();
+    CHECK_EQ(count, 160);
+    AsyncWiFiManagerTest::updateScanResults(count);
+
+    CHECK_EQ(AsyncWiFiManagerTest::getResultCount(), WIFI_SCAN_CACHE_SIZE);
+    CHECK_EQ(AsyncWiFiManagerTest::getResult(0).rssi, -31);
+    for (uint8_t i = 1; i < WIFI_SCAN_CACHE_SIZE; i++)
+    {
+        CHECK(AsyncWiFiManagerTest::getResult(i - 1).rssi >= AsyncWiFiManagerTest::getResult(i).rssi);
+        CHECK(strcmp(AsyncWiFiManagerTest::getResult(i - 1).ssid, AsyncWiFiManagerTest::getResult(i).ssid) != 0);
+        CHECK(AsyncWiFiManagerTest::getResult(i).bssid[5] < 100);
+    }
+}
+
+// A 32 byte SSID that grows the most once escaped still gives one complete record
+TEST(escapesLongestSsidInJson)
+{
+    mock::setManualClock(true);
+    std::string ssid(31, '\x1f');
+    ssid += '"';
+    mock::addAccessPoint(makeAccessPoint(ssid.c_str(), 1, 6, -40));
+    mock::addAccessPoint(makeAccessPoint("cafe", 2, 11, -60));
+    AsyncWiFiManager::begin();
+    waitForScan();
+
+    std::string body;
+    CHECK_EQ(httpRequest("GET", "/scan.json", nullptr, &body), 200);
+    std::string escaped;
+    for (int i = 0; i < 31; i++)
+    {
+        escaped += "\\u001f";
+    }
+    escaped += "\\\"";
+    std::string record = "[{\"s\":\"" + escaped + "\",\"r\":-40,";
+    CHECK_EQ(body.compare(0, record.size(), record), 0);
+    CHECK(body.find("{\"s\":\"cafe\",\"r\":-60,") != std::string::npos);
+    CHECK_EQ(body.compare(body.size() - 2, 2, "}]"), 0);
+}
@@ -0,0 +1,177 @@
+#include "test.h"
+
+#include <sys/stat.h>
+#include <vector>
+
+// The saved networks are a single CRC protected record, replaced atomically and only when it changes
+
+struct AsyncWiFiManagerTest
+{
+    typedef AsyncWiFiManager::SettingsHeader SettingsHeader;
+    typedef AsyncWiFiManager::SettingsData SettingsData;
+    typedef AsyncWiFiManager::SavedNetwork SavedNetwork;
+
+    // Read the settings again like after a restart
+    static void reload()
+    {
+        AsyncWiFiManager::mIsSettingsLoaded = false;
+        AsyncWiFiManager::mSavedSettingsCrc = 0;
+        AsyncWiFiManager::loadSettings();
+    }
+
+    static uint8_t getNetworkCount()
+    {
+        return AsyncWiFiManager::mNetworkCount;
+    }
+
+    static const SavedNetwork &getNetwork(uint8_t index)
+    {
+        return AsyncWiFiManager::mNetworks[index];
+    }
+};
+
+typedef AsyncWiFiManagerTest::SettingsHeader SettingsHeader;
+
+// CRC-32 of zlib, computed independently of the library
+static uint32_t crc32(const void *data, size_t length)
+{
+    const uint8_t *bytes = (const uint8_t *)data;
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < length; i++)
+    {
+        crc ^= bytes[i];
+        for (int bit = 0; bit < 8; bit++)
+        {
+            crc = crc & 1 ? (crc >> 1) ^ 0xEDB88320 : crc >> 1;
+        }
+    }
+    return ~crc;
+}
+
+static std::string getPath(const char *name)
+{
+    return std::string(getTestDirectory()) + "/fs/" + name;
+}
+
+static std::vector<uint8_t> readFile(const char *name)
+{
+    std::vector<uint8_t> content;
+    FILE *file = fopen(getPath(name).c_str(), "rb");
+    if (file)
+    {
+        int c;
+        while ((c = fgetc(file)) != EOF)
+        {
+            content.push_back(c);
+        }
+        fclose(file);
+    }
+    return content;
+}
+
+static void writeFile(const char *name, const void *content, size_t length)
+{
+    mkdir(getPath("").c_str(), 0755);
+    FILE *file = fopen(getPath(name).c_str(), "wb");
+    CHECK(file);
+    CHECK_EQ(fwrite(content, 1, length, file), length);
+    fclose(file);
+}
+
+static bool exists(const char *name)
+{
+    return access(getPath(name).c_str(), F_OK) == 0;
+}
+
+TEST(writesSingleRecordWithCrc)
+{
+    AsyncWiFiManager::addWifiInformation("home", "password1");
+    AsyncWiFiManager::addWifiInformation("office", "password2");
+
+    std::vector<uint8_t> content = readFile("wifi.dat");
+    CHECK_EQ(content.size(), sizeof(SettingsHeader) + 2 * sizeof(AsyncWiFiManagerTest::SavedNetwork));
+    SettingsHeader header;
+    memcpy(&header, content.data(), sizeof(header));
+    CHECK_EQ(header.magic, 0x49464957);
+    CHECK_EQ(header.version, 3);
+    CHECK_EQ(header.size, content.size() - sizeof(header));
+    CHECK_EQ(header.crc, crc32(content.data() + sizeof(header), header.size));
+    CHECK(!exists("wifi.tmp"));
+
+    AsyncWiFiManagerTest::reload();
+    CHECK_EQ(AsyncWiFiManagerTest::getNetworkCount(), 2);
+    CHECK_STR(AsyncWiFiManagerTest::getNetwork(1).ssid, "office");
+    CHECK_STR(AsyncWiFiManagerTest::getNetwork(1).password, "password2");
+}
+
+TEST(readsRecordWithSingleOpen)
+{
+    AsyncWiFiManager::addWifiInformation("home", "password1");
+    uint32_t openCount = mock::getFileSystemStats().openCount;
+    AsyncWiFiManagerTest::reload();
+    CHECK_EQ(mock::getFileSystemStats().openCount - openCount, 1);
+    CHECK_EQ(AsyncWiFiManagerTest::getNetworkCount(), 1);
+}
+
+TEST(skipsUnchangedWrite)
+{
+    AsyncWiFiManager::addWifiInformation("home", "password1");
+    mock::FileSystemStats stats = mock::getFileSystemStats();
+    AsyncWiFiManager::addWifiInformation("home", "password1");
+    AsyncWiFiManagerTest::reload();
+    AsyncWiFiManager::addWifiInformation("home", "password1");
+    CHECK_EQ(mock::getFileSystemStats().writtenBytes, stats.writtenBytes);
+
+    AsyncWiFiManager::addWifiInformation("home", "password2");
+    CHECK(mock::getFileSystemStats().writtenBytes > stats.writtenBytes);
+}
+
+TEST(rejectsCorruptRecord)
+{
+    AsyncWiFiManager::addWifiInformation("home", "password1");
+    std::vector<uint8_t> content = readFile("wifi.dat");
+    content[sizeof(SettingsHeader) + 1] ^= 0x01;
+    writeFile("wifi.dat", content.data(), content.size());
+    AsyncWiFiManagerTest::reload();
+    CHECK_EQ(AsyncWiFiManagerTest::getNetworkCount(), 0);
+
+    // Truncated, like a write cut by a power loss without the temporary file
+    writeFile("wifi.dat", content.data(), content.size() - 8);
+    AsyncWiFiManagerTest::reload();
+    CHECK_EQ(AsyncWiFiManagerTest::getNetworkCount(), 0);
+}
+
+TEST(readsVersion2Record)
+{
+    AsyncWiFiManagerTest::SettingsData data;
+    memset(&data, 0, sizeof(data));
+    strcpy(data.ssid, "home");
+    strcpy(data.password, "password1");
+    data.channel = 6;
+    SettingsHeader header = {0x49464957, 2, sizeof(data), crc32(&data, sizeof(data))};
+    uint8_t content[sizeof(header) + sizeof(data)];
+    memcpy(content, &header, sizeof(header));
+    memcpy(content + sizeof(header), &data, sizeof(data));
+    writeFile("wifi.dat", content, sizeof(content));
+
+    CHECK_EQ(AsyncWiFiManager::getSavedNetworkCount(), 1);
+    CHECK_STR(AsyncWiFiManagerTest::getNetwork(0).ssid, "home");
+    CHECK_STR(AsyncWiFiManagerTest::getNetwork(0).password, "password1");
+    CHECK_EQ(AsyncWiFiManagerTest::getNetwork(0).channel, 6);
+}
+
+TEST(migratesLegacyTextFiles)
+{
+    writeFile("ssid.txt", "home", 4);
+    writeFile("pass.txt", "password1", 9);
+
+    CHECK_EQ(AsyncWiFiManager::getSavedNetworkCount(), 1);
+    CHECK_STR(AsyncWiFiManagerTest::getNetwork(0).ssid, "home");
+    CHECK_STR(AsyncWiFiManagerTest::getNetwork(0).password, "password1");
+    CHECK(exists("wifi.dat"));
+    CHECK(!exists("ssid.txt"));
+    CHECK(!exists("pass.txt"));
+
+    AsyncWiFiManagerTest::reload();
+    CHECK_EQ(AsyncWiFiManagerTest::getNetworkCount(), 1);
+}
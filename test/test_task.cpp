@@ -0,0 +1,188 @@
+#include "test.h"
+
+#include <atomic>
+#include <thread>
+
+// Task mode with std::thread for the FreeRTOS task: the manager runs in its own thread, the WiFi events come from a
+// driver thread and the callbacks reach the application only through loop(). Built with ASYNC_WIFI_ENABLE_TASK
+
+static const mock::AccessPoint HOME = {"home", "password1", {0x02, 0, 0, 0, 0, 1}, 6, -50, WIFI_AUTH_WPA2_PSK, true};
+
+static std::thread::id mainThreadId;
+static std::atomic<bool> isCallbackOnOtherThread(false);
+static std::vector<AsyncWiFiState> states;
+
+// Like the event task of the driver: delivers the WiFi events and drops the connection every interval (ms)
+struct DriverThread
+{
+    std::atomic<bool> isRunning{true};
+    std::atomic<uint32_t> dropCount{0};
+    std::thread thread;
+
+    explicit DriverThread(unsigned long interval)
+    {
+        thread = std::thread([this, interval]()
+                             {
+                                 unsigned long dropTime = millis();
+                                 while (isRunning)
+                                 {
+                                     mock::deliverEvents();
+                                     if (interval && WiFi.isConnected() && (unsigned long)(millis() - dropTime) >= interval)
+                                     {
+                                         mock::disconnect(WIFI_REASON_BEACON_TIMEOUT);
+                                         dropTime = millis();
+                                         dropCount++;
+                                     }
+                                     delay(1);
+                                 }
+                             });
+    }
+
+    ~DriverThread()
+    {
+        isRunning = false;
+        thread.join();
+    }
+};
+
+// Reconnects at once so the state changes as often as possible
+static void startTask()
+{
+    mock::setSerialQuiet(true);
+    mock::addAccessPoint(HOME);
+    AsyncWiFiReconnectPolicy policy = AsyncWiFiManager::getReconnectPolicy();
+    for (unsigned long &delay : policy.baseDelay)
+    {
+        delay = 1;
+    }
+    policy.maxDelay = 1;
+    policy.jitterPercent = 0;
+    AsyncWiFiManager::setReconnectPolicy(policy);
+    mainThreadId = std::this_thread::get_id();
+    AsyncWiFiManager::setOnStateChanged([](AsyncWiFiState state)
+                                        {
+                                            isCallbackOnOtherThread = isCallbackOnOtherThread || std::this_thread::get_id() != mainThreadId;
+                                            states.push_back(state);
+                                        });
+    AsyncWiFiManager::setWifiInformation("home", "password1");
+    AsyncWiFiManager::begin();
+    CHECK(AsyncWiFiManager::startTask());
+}
+
+static bool isConnectedState(AsyncWiFiState state)
+{
+    return state == ASYNC_WIFI_STATE_CONNECTED || state == ASYNC_WIFI_STATE_DEGRADED;
+}
+
+TEST(connectsInTaskAndCallsBackFromLoop)
+{
+    startTask();
+    {
+        DriverThread driver(0);
+        unsigned long start = millis();
+        while (!isConnectedState(AsyncWiFiManager::getSnapshot().state) && millis() - start < 5000)
+        {
+            delay(1);
+        }
+        // Nothing is called back until loop()
+        CHECK(states.empty() || states.back() != ASYNC_WIFI_STATE_CONNECTED);
+        AsyncWiFiManager::loop();
+    }
+    mock::stopTasks();
+    CHECK(!states.empty());
+    CHECK_EQ(states.back(), ASYNC_WIFI_STATE_CONNECTED);
+    CHECK(!isCallbackOnOtherThread);
+    AsyncWiFiSnapshot snapshot = AsyncWiFiManager::getSnapshot();
+    CHECK_STR(snapshot.ssid, "home");
+    CHECK_EQ(snapshot.localIP, (uint32_t)IPAddress(192, 168, 1, 50));
+    CHECK_EQ(snapshot.notificationDropCount, 0);
+}
+
+// Readers on several threads copy the snapshot while the task rewrites it: each copy must be one written state
+TEST(stressSnapshotReaders)
+{
+    const int READER_COUNT = 3;
+    startTask();
+    // The snapshot is written around WiFi.localIP(), the readers then also run while it is half written
+    mock::setDriverYield(true);
+    std::atomic<bool> isReading(true);
+    std::atomic<uint32_t> readCount(0);
+    std::atomic<uint32_t> tornCount(0);
+    std::atomic<uint32_t> connectedReadCount(0);
+    std::vector<std::thread> readers;
+    for (int i = 0; i < READER_COUNT; i++)
+    {
+        readers.emplace_back([&]()
+                             {
+                                 const uint32_t LOCAL_IP = IPAddress(192, 168, 1, 50);
+                                 unsigned long lastStateTime = 0;
+                                 while (isReading)
+                                 {
+                                     AsyncWiFiSnapshot snapshot = AsyncWiFiManager::getSnapshot();
+                                     bool isConnected = isConnectedState(snapshot.state);
+                                     // The address is read from the driver, which can have dropped the connection already
+                                     bool isValid = (isConnected ? strcmp(snapshot.ssid, "home") == 0 : snapshot.ssid[0] == '\0') &&
+                                                    (snapshot.localIP == 0 || (isConnected && snapshot.localIP == LOCAL_IP)) &&
+                                                    (long)(snapshot.stateTime - lastStateTime) >= 0;
+                                     tornCount += !isValid;
+                                     connectedReadCount += isConnected;
+                                     lastStateTime = snapshot.stateTime;
+                                     readCount++;
+                                 }
+                             });
+    }
+    uint32_t dropCount;
+    {
+        DriverThread driver(2);
+        unsigned long start = millis();
+        while (millis() - start < 2000)
+        {
+            AsyncWiFiManager::loop();
+            delay(1);
+        }
+        dropCount = driver.dropCount;
+    }
+    isReading = false;
+    for (std::thread &reader : readers)
+    {
+        reader.join();
+    }
+    mock::stopTasks();
+    AsyncWiFiManager::loop();
+
+    uint32_t notificationDropCount = AsyncWiFiManager::getSnapshot().notificationDropCount;
+    printf("%u snapshot reads (%u connected), %u connections dropped, %zu callbacks, %u callbacks dropped\n",
+           readCount.load(), connectedReadCount.load(), dropCount, states.size(), notificationDropCount);
+    CHECK_EQ(tornCount, 0);
+    CHECK(dropCount >= 50);
+    CHECK(connectedReadCount > 0 && connectedReadCount < readCount);
+    CHECK(!isCallbackOnOtherThread);
+    // Each dropped connection changes the state at least twice
+    CHECK(states.size() + notificationDropCount >= 2 * dropCount);
+}
+
+// While the application does not call loop(), the queue fills up: the oldest callbacks are kept, the others counted
+TEST(countsDroppedCallbacks)
+{
+    startTask();
+    size_t initialCount = states.size();
+    uint32_t dropCount;
+    {
+        DriverThread driver(2);
+        unsigned long start = millis();
+        while (millis() - start < 500)
+        {
+            delay(1);
+        }
+        dropCount = driver.dropCount;
+    }
+    mock::stopTasks();
+    AsyncWiFiSnapshot snapshot = AsyncWiFiManager::getSnapshot();
+    CHECK(dropCount >= 20);
+    CHECK(snapshot.notificationDropCount > 0);
+
+    AsyncWiFiManager::loop();
+    CHECK_EQ(states.size() - initialCount, NOTIFICATION_QUEUE_SIZE - 1);
+    // The last state is still available
+    CHECK(AsyncWiFiManager::getSnapshot().state == snapshot.state);
+}